@@ -24,7 +24,7 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), layout_(NCHW) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -50,6 +50,7 @@ class Blob {
    */
   void Reshape(const vector<int>& shape);
   void Reshape(const BlobShape& shape);
+  /// @brief Takes the shape and the layout of other.
   void ReshapeLike(const Blob& other);
   inline string shape_string() const {
     ostringstream stream;
@@ -73,6 +74,13 @@ class Blob {
   }
   inline int num_axes() const { return shape_.size(); }
   inline int count() const { return count_; }
+  /**
+   * @brief The order of the values in memory. The shape stays
+   *        N x C x H x W either way; with NHWC the channels of each position
+   *        are contiguous instead, and offset() and data_at() do not apply.
+   */
+  inline BlobLayout layout() const { return layout_; }
+  inline void set_layout(BlobLayout layout) { layout_ = layout; }
 
   /**
    * @brief Compute the volume of a slice; i.e., the product of dimensions
@@ -262,6 +270,13 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to a SyncedMemory of at least count()
+   *        elements, such as a buffer several Blob%s use in turn.
+   *
+   * Growing the Blob past its current count allocates new memory again.
+   */
+  void ShareDataMemory(const shared_ptr<SyncedMemory>& memory);
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -272,6 +287,7 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  BlobLayout layout_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
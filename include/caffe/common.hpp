@@ -99,6 +99,9 @@ void GlobalInit(int* pargc, char*** pargv);
 
 // A singleton class to hold common caffe stuff, such as the handler that
 // caffe is going to use for cublas, curand, etc.
+class HostAllocator;
+class ThreadPool;
+
 class Caffe {
  public:
   ~Caffe();
@@ -163,6 +166,21 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // The pool running the CPU layer kernels. Unlike the rest of the context
+  // it is shared by all threads of the process.
+  static ThreadPool& thread_pool();
+  // Number of threads used by the CPU kernels, including the calling one.
+  // Defaults to $CAFFE_NUM_THREADS, or to the number of cores.
+  static int cpu_threads();
+  // Also gives the BLAS library the same number of threads: layers call
+  // either BLAS or the pool, so the two take turns on the same cores.
+  // Not to be called while a net is running.
+  static void set_cpu_threads(const int num_threads);
+  // The allocator of the host memory of blobs, shared by all threads of the
+  // process like the pool. Defaults to a caching HostAllocator.
+  static shared_ptr<HostAllocator> host_allocator();
+  // Memory already allocated is freed by the allocator it came from.
+  static void set_host_allocator(const shared_ptr<HostAllocator>& allocator);
 
  protected:
 #ifndef CPU_ONLY
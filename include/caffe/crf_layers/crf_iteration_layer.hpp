@@ -52,6 +52,10 @@ public:
     virtual inline const char* type() const {
         return "CRFIteration";
     }
+    // Alias the intermediate blobs (softmax, message passing, compatibility)
+    // to those of another iteration. Only one iteration's intermediates are
+    // then valid at a time, so Forward has to be re-run before Backward.
+    void ShareInternalBlobs(const CRFIterationLayer<Dtype>& other);
     virtual inline int ExactNumBottomBlobs() const { return 5; }
     virtual inline int ExactNumTopBlobs() const { return 1; }
 protected:
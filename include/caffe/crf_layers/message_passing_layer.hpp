@@ -51,6 +51,14 @@ private:
     virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                               const vector<bool>& propagate_down,
                               const vector<Blob<Dtype>*>& bottom);
+    // The cpu passes split the image rows over the Caffe thread pool.
+    void ForwardRange(const Dtype* input_data, const Dtype* kernel_data,
+                      const Dtype* mask_data, Dtype* output_data, int begin, int end);
+    void BackwardDataRange(const Dtype* top_diff, const Dtype* kernel_data,
+                           const Dtype* mask_data, Dtype* bottom_diff, int begin, int end);
+    void BackwardKernelRange(const Dtype* top_diff, const Dtype* bottom_data,
+                             const Dtype* mask_data, Dtype* kernel_diff, int begin, int end);
+    int RowGrain(int channels) const;
 
     int count_;
     int num_;
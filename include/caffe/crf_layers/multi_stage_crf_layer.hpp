@@ -65,6 +65,8 @@ class MultiStageCRFLayer : public Layer<Dtype> {
   int width_;
   int num_pixels_;
   bool user_interaction_constrain_;
+  // iterations share their intermediate blobs and are recomputed in Backward
+  bool checkpoint_iterations_;
 
 
   int num_iterations_;
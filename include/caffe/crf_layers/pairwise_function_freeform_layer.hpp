@@ -50,10 +50,22 @@ public:
     virtual inline int ExactNumBottomBlobs() const { return 1; }
     virtual inline int ExactNumTopBlobs() const { return 1; }
 private:
-    bool LoadParamFromFile(shared_ptr<vector<vector<Dtype> > > matrix,
-                         int H, int W, std::string filename);
-    bool CopyParamToBlob(shared_ptr<vector<vector<Dtype> > > matrix,
-                         shared_ptr<Blob<Dtype> > blob);
+    // Load a parameter blob from param_dir. <name>.binaryproto (a BlobProto,
+    // e.g. written by caffe.io.array_to_blobproto) is preferred over the
+    // whitespace separated <name>.txt.
+    bool LoadParam(const std::string& param_dir, const std::string& name,
+                   shared_ptr<Blob<Dtype> > blob);
+    bool LoadParamFromBinaryFile(const std::string& filename,
+                                 shared_ptr<Blob<Dtype> > blob);
+    bool LoadParamFromFile(const std::string& filename,
+                           shared_ptr<Blob<Dtype> > blob);
+    // Fused inference path: evaluates the whole MLP for a tile of pairs at
+    // a time, so hidden activations stay in a small per-thread buffer
+    // instead of the conv_out_blobs_/relu_out_blobs_ stack.
+    void PackWeights();
+    void FusedForward_cpu(const Blob<Dtype>* bottom, Blob<Dtype>* top);
+    void FusedForwardRange(const Dtype* bottom_data, Dtype* top_data,
+                           int spatial_dim, int begin, int end);
     int count_;
     int num_;
     int channels_;
@@ -62,6 +74,12 @@ private:
 
     vector<int> inner_layer_size_;
     int layerN_;
+    Dtype negative_slope_;
+    // the fused path is used when no backward pass needs the hidden blobs
+    bool use_fused_;
+    // per layer: output x input weights followed by the output biases
+    vector<Dtype> packed_params_;
+    vector<int> packed_offsets_;
     
     vector<shared_ptr<Blob<Dtype> > > conv_out_blobs_;
     vector<shared_ptr<Blob<Dtype> > > relu_out_blobs_;
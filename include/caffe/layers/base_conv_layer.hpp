@@ -1,12 +1,15 @@
 #ifndef CAFFE_BASE_CONVOLUTION_LAYER_HPP_
 #define CAFFE_BASE_CONVOLUTION_LAYER_HPP_
 
+#include <stdint.h>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/sparse.hpp"
+#include "caffe/util/workspace.hpp"
 
 namespace caffe {
 
@@ -18,7 +21,8 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), weight_storage_(FULL_PRECISION),
+        sparse_min_sparsity_(0), sparse_threshold_(0), sparse_checked_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -28,6 +32,43 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
 
+  /**
+   * @brief Take the im2col scratch from a workspace instead of col_buffer_.
+   *
+   * Layers that never run at the same time (e.g. the convolutions of a net
+   * or of a composite layer) can share one workspace; Reshape reserves what
+   * this layer needs. Call before SetUp.
+   */
+  void set_workspace(const shared_ptr<Workspace<Dtype> >& workspace) {
+    workspace_ = workspace;
+  }
+
+  /**
+   * @brief Multiply with a 16-bit copy of the weights in the CPU forward GEMM.
+   *
+   * The copy is made from the weights of the first forward GEMM and is not
+   * refreshed when they change, so this is for inference only.
+   */
+  void set_weight_storage(StoragePrecision precision) {
+    weight_storage_ = precision;
+    half_weights_.clear();
+  }
+
+  /**
+   * @brief Multiply with a sparse copy of the weights in the CPU forward GEMM
+   *        if at least min_sparsity of them are zeros; 0 never does.
+   *
+   * Weights of magnitude at most threshold count as zeros. The copy is made
+   * and the sparsity checked at the first forward GEMM, as for
+   * set_weight_storage, and the sparse copy takes precedence.
+   */
+  void set_sparse_weights(float min_sparsity, float threshold) {
+    sparse_min_sparsity_ = min_sparsity;
+    sparse_threshold_ = threshold;
+    sparse_checked_ = false;
+    sparse_weights_.clear();
+  }
+
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
@@ -40,6 +81,14 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // The same over num consecutive images unrolled together, for at most
+  // col_batch_size_ images.
+  void forward_cpu_gemm_batch(const Dtype* input, const Dtype* weights,
+      Dtype* output, int num);
+  void backward_cpu_gemm_batch(const Dtype* output, const Dtype* weights,
+      Dtype* input, int num);
+  void weight_cpu_gemm_batch(const Dtype* input, const Dtype* output,
+      Dtype* weights, int num);
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -92,8 +141,21 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief The images unrolled at once by the batched helpers; 1 when the
+  ///        per-image helpers should run.
+  int col_batch_size_;
 
  private:
+  // The weights in weight_storage_, converted from weights on first use.
+  const uint16_t* half_weights(const Dtype* weights);
+  // The weights of each group in sparse form, or NULL if they are to stay
+  // dense.
+  const SparseMatrix<Dtype>* sparse_weights(const Dtype* weights);
+  // The im2col scratch actually in use: the workspace if one was set,
+  // otherwise this layer's own col_buffer_.
+  inline Blob<Dtype>* col_buffer() {
+    return workspace_ ? workspace_->buffer() : &col_buffer_;
+  }
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -109,6 +171,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data(), stride_.cpu_data(), dilation_.cpu_data(), col_buff);
     }
   }
+  // Unrolls num 2D images into one buffer, the columns of each image
+  // interleaved within every row.
+  void conv_im2col_batch_cpu(const Dtype* data, int num, Dtype* col_buff);
   inline void conv_col2im_cpu(const Dtype* col_buff, Dtype* data) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
       col2im_cpu(col_buff, conv_in_channels_,
@@ -166,6 +231,16 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int output_offset_;
 
   Blob<Dtype> col_buffer_;
+  shared_ptr<Workspace<Dtype> > workspace_;
+  StoragePrecision weight_storage_;
+  vector<uint16_t> half_weights_;
+  float sparse_min_sparsity_;
+  float sparse_threshold_;
+  bool sparse_checked_;
+  vector<SparseMatrix<Dtype> > sparse_weights_;
+  // The output, or its diff, of the batched helpers, with the images
+  // interleaved as output channels x images x output spatial dim.
+  Blob<Dtype> batch_output_buffer_;
   Blob<Dtype> bias_multiplier_;
 };
 
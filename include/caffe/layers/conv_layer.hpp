@@ -8,6 +8,7 @@
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/epilogue.hpp"
 
 namespace caffe {
 
@@ -59,13 +60,27 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *  group.
    *  - bias_term (\b optional, default true). Whether to have a bias.
    *  - engine: convolution has CAFFE (matrix multiplication) and CUDNN (library
-   *    kernels + stream parallelism) engines.
+   *    kernels + stream parallelism) engines, and the CPU engines WINOGRAD
+   *    (see WinogradConvolutionLayer) and DIRECT (see DirectConvolutionLayer).
    */
   explicit ConvolutionLayer(const LayerParameter& param)
-      : BaseConvolutionLayer<Dtype>(param) {}
+      : BaseConvolutionLayer<Dtype>(param), nhwc_(false) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Convolution"; }
 
+  /**
+   * @brief Apply an epilogue to each output image right after the GEMM and
+   *        bias, while it is still in cache. Needs a single top.
+   *
+   * Backward then treats top as the epilogue's output and turns its diff
+   * in place into the diff of the convolution output.
+   */
+  void set_epilogue(const shared_ptr<Epilogue<Dtype> >& epilogue) {
+    epilogue_ = epilogue;
+  }
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -77,6 +92,20 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+
+  /**
+   * @brief Forward for NHWC blobs of 2 spatial axes, as an implicit GEMM:
+   *        each kernel tap multiplies the channel vectors of a row of input
+   *        positions, read in place, by its C x num_output weights.
+   */
+  void forward_cpu_nhwc(const Dtype* bottom, const Dtype* weight,
+      Dtype* top);
+
+  shared_ptr<Epilogue<Dtype> > epilogue_;
+  /// Whether the blobs are NHWC, which only runs Forward_cpu.
+  bool nhwc_;
+  /// The weights as kernel taps x channels / group x num_output, for NHWC.
+  Blob<Dtype> nhwc_weights_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,63 @@
+#ifndef CAFFE_DIRECT_CONV_LAYER_HPP_
+#define CAFFE_DIRECT_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/// @brief The shape of the 2D convolution of one image.
+struct DirectConvShape {
+  int groups;
+  int channels;  // input channels per group
+  int height, width;
+  int out_channels;  // output channels per group
+  int out_height, out_width;
+  int kernel_h, kernel_w;
+  int pad_h, pad_w;
+  int stride_h, stride_w;
+  int dilation_h, dilation_w;
+};
+
+/**
+ * @brief Direct implementation of ConvolutionLayer for 2D convolutions on the
+ *        CPU, with no im2col matrix.
+ *
+ * Every filter tap is applied to whole output rows, over the range of columns
+ * that falls inside the input, so the loops need no bounds checks and stay
+ * contiguous at stride 1. With few channels per group the im2col matrix is
+ * mostly overhead and this is faster than the GEMM; with many, the GEMM wins.
+ * Depthwise convolutions in particular would otherwise take one tiny GEMM per
+ * group and image. The output channels of all the images, or the input
+ * channels for the input gradient, run in parallel on the Caffe thread pool;
+ * the weight gradient runs in parallel over output channels.
+ *
+ * Other shapes, and the GPU, fall back to ConvolutionLayer.
+ */
+template <typename Dtype>
+class DirectConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit DirectConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), direct_(false) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// Whether the shape is 2D; otherwise ConvolutionLayer runs.
+  bool direct_;
+  DirectConvShape shape_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_DIRECT_CONV_LAYER_HPP_
@@ -1,11 +1,14 @@
 #ifndef CAFFE_INNER_PRODUCT_LAYER_HPP_
 #define CAFFE_INNER_PRODUCT_LAYER_HPP_
 
+#include <stdint.h>
 #include <vector>
 
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/epilogue.hpp"
+#include "caffe/util/sparse.hpp"
 
 namespace caffe {
 
@@ -19,7 +22,8 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), weight_storage_(FULL_PRECISION),
+        sparse_min_sparsity_(0), sparse_threshold_(0), sparse_checked_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -29,6 +33,42 @@ class InnerProductLayer : public Layer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
+  /**
+   * @brief Apply an epilogue to the output right after the GEMM and bias.
+   *
+   * Backward then treats top as the epilogue's output and turns its diff
+   * in place into the diff of the inner product.
+   */
+  void set_epilogue(const shared_ptr<Epilogue<Dtype> >& epilogue) {
+    epilogue_ = epilogue;
+  }
+
+  /**
+   * @brief Multiply with a 16-bit copy of the weights in Forward_cpu.
+   *
+   * The copy is made at the first Forward and is not refreshed when the
+   * weights change, so this is for inference only.
+   */
+  void set_weight_storage(StoragePrecision precision) {
+    weight_storage_ = precision;
+    half_weights_.clear();
+  }
+
+  /**
+   * @brief Multiply with a sparse copy of the weights in Forward_cpu if at
+   *        least min_sparsity of them are zeros; 0 never does.
+   *
+   * Weights of magnitude at most threshold count as zeros. The copy is made
+   * and the sparsity checked at the first Forward, as for
+   * set_weight_storage, and the sparse copy takes precedence.
+   */
+  void set_sparse_weights(float min_sparsity, float threshold) {
+    sparse_min_sparsity_ = min_sparsity;
+    sparse_threshold_ = threshold;
+    sparse_checked_ = false;
+    sparse_weights_ = SparseMatrix<Dtype>();
+  }
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -45,6 +85,15 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  shared_ptr<Epilogue<Dtype> > epilogue_;
+  StoragePrecision weight_storage_;
+  /// The weights in weight_storage_, N_ x K_ whatever transpose_ says.
+  vector<uint16_t> half_weights_;
+  float sparse_min_sparsity_;
+  float sparse_threshold_;
+  bool sparse_checked_;
+  /// The weights as N_ x K_ in sparse form, if sparse enough; else empty.
+  SparseMatrix<Dtype> sparse_weights_;
 };
 
 }  // namespace caffe
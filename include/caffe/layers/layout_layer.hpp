@@ -0,0 +1,48 @@
+#ifndef CAFFE_LAYOUT_LAYER_HPP_
+#define CAFFE_LAYOUT_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Reorders the values of the input in memory into the layout of
+ *        layout_param, NCHW or NHWC, keeping the N x C x H x W shape.
+ *
+ * Net inserts these layers where an NHWC net passes blobs between layers
+ * that run in different layouts; see NetParameter.layout. Any number of
+ * spatial axes is allowed.
+ */
+template <typename Dtype>
+class LayoutLayer : public Layer<Dtype> {
+ public:
+  explicit LayoutLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "Layout"; }
+  virtual inline int ExactNumBottomBlobs() const { return 1; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// Copies x in the layout from to y in the layout to.
+  void Convert(BlobLayout from, BlobLayout to, const Dtype* x, Dtype* y);
+
+  int num_;
+  int channels_;
+  int spatial_dim_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_LAYOUT_LAYER_HPP_
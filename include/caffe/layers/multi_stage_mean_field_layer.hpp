@@ -44,6 +44,13 @@ class MeanfieldIteration {
       const vector<shared_ptr<ModifiedPermutohedral> >* const bilateral_lattices,
       const Blob<Dtype>* const bilateral_norms);
 
+  /**
+   * Alias the intermediate blobs to those of another iteration. Only one
+   * iteration's intermediates are then valid at a time, so Forward_cpu()
+   * has to be re-run before Backward_cpu().
+   */
+  void ShareInternalBlobs(const MeanfieldIteration<Dtype>& other);
+
   /**
    * Forward pass - to be called during inference.
    */
@@ -131,6 +138,8 @@ class MultiStageMeanfieldLayer : public Layer<Dtype> {
   Dtype theta_beta_;
   Dtype theta_gamma_;
   int num_iterations_;
+  // iterations share their intermediate blobs and are recomputed in Backward
+  bool checkpoint_iterations_;
 
   boost::shared_array<Dtype> norm_feed_;
   Blob<Dtype> spatial_norm_;
@@ -43,6 +43,8 @@ class PoolingLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  /// @brief MAX or AVE forward for NHWC blobs, over whole channel vectors.
+  void Forward_cpu_nhwc(const Blob<Dtype>& bottom, Blob<Dtype>* top);
 
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
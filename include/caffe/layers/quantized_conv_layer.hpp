@@ -0,0 +1,60 @@
+#ifndef CAFFE_QUANTIZED_CONV_LAYER_HPP_
+#define CAFFE_QUANTIZED_CONV_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Int8 implementation of ConvolutionLayer for inference on the CPU,
+ *        chosen by a quantization_param.
+ *
+ * The weights are quantized per output channel at the first Forward, so they
+ * must have their final values by then. The input is quantized with the
+ * calibrated quantization_param().input_range(), or with its own range when
+ * that is 0, unrolled by im2col as int8 and multiplied with the weights in
+ * int32 (see caffe_cpu_gemm_s8). One pass over each output image then scales
+ * the sums back to float, adds the bias and runs the epilogue, so the layers
+ * around it are unchanged.
+ *
+ * Inference only: Backward is an error. N-D convolutions and the GPU run the
+ * float convolution.
+ */
+template <typename Dtype>
+class QuantizedConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit QuantizedConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), quantized_(false),
+        weights_quantized_(false) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// Whether the shape is 2D; otherwise ConvolutionLayer runs.
+  bool quantized_;
+  bool weights_quantized_;
+  vector<int8_t> quantized_weights_;
+  /// The factor turning each output channel of the weights back into float.
+  vector<Dtype> weight_scales_;
+  vector<int8_t> quantized_input_;
+  vector<int8_t> quantized_col_buffer_;
+  /// The int32 sums of one output image.
+  vector<int32_t> sums_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_QUANTIZED_CONV_LAYER_HPP_
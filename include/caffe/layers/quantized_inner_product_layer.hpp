@@ -0,0 +1,51 @@
+#ifndef CAFFE_QUANTIZED_INNER_PRODUCT_LAYER_HPP_
+#define CAFFE_QUANTIZED_INNER_PRODUCT_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/inner_product_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Int8 implementation of InnerProductLayer for inference on the CPU,
+ *        chosen by a quantization_param.
+ *
+ * Quantizes the weights per output at the first Forward and the input as
+ * QuantizedConvolutionLayer does, takes the inner products in int32 and
+ * scales them back to float with the bias and the epilogue in one pass.
+ *
+ * Inference only: Backward is an error. The GPU runs the float layer.
+ */
+template <typename Dtype>
+class QuantizedInnerProductLayer : public InnerProductLayer<Dtype> {
+ public:
+  explicit QuantizedInnerProductLayer(const LayerParameter& param)
+      : InnerProductLayer<Dtype>(param), weights_quantized_(false) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  bool weights_quantized_;
+  /// The weights as N_ x K_, whatever transpose_.
+  vector<int8_t> quantized_weights_;
+  /// The factor turning the weights of each output back into float.
+  vector<Dtype> weight_scales_;
+  vector<int8_t> quantized_input_;
+  vector<int32_t> sums_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_QUANTIZED_INNER_PRODUCT_LAYER_HPP_
@@ -0,0 +1,53 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Winograd implementation of ConvolutionLayer for 2D 3 x 3 filters at
+ *        stride 1 on the CPU.
+ *
+ * Each output tile is computed in the transform domain of F(2 x 2, 3 x 3) or,
+ * once the output is at least 8 x 8, F(4 x 4, 3 x 3), which takes 2.25 or 4
+ * times fewer multiplies than the direct convolution and reads the input once
+ * instead of through a nine times larger im2col matrix. The gradient with
+ * respect to the input runs the same way on the rotated filters as long as
+ * the padding is at most 2; the weight gradient goes through im2col.
+ *
+ * Other shapes, and the GPU, fall back to ConvolutionLayer.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param), tile_(0) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief The output tile side in use, 2 or 4, or 0 when falling back.
+  inline int tile() const { return tile_; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  int tile_;
+  int height_, width_, out_height_, out_width_;
+  Blob<Dtype> transformed_weights_;
+  Blob<Dtype> input_buffer_;
+  Blob<Dtype> output_buffer_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
@@ -11,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/workspace.hpp"
 
 namespace caffe {
 
@@ -215,6 +216,20 @@ class Net {
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
   void set_debug_info(const bool value) { debug_info_ = value; }
+  /// @brief Whether activations share memory, keeping only the inputs,
+  ///        outputs and requested blobs intact after Forward.
+  inline bool share_activations() const { return share_activations_; }
+  /**
+   * @brief The layer running a layer as its epilogue, or -1.
+   *
+   * Fused layers have no bottom or top ids and do not run; the ids of the
+   * layer running them list the blobs the epilogue reads and writes.
+   */
+  inline int fused_into(int layer_id) const { return fused_into_[layer_id]; }
+  /// @brief The im2col scratch shared by the convolutions, or NULL.
+  inline const shared_ptr<Workspace<Dtype> >& conv_workspace() const {
+    return conv_workspace_;
+  }
 
   // Helpers for Init.
   /**
@@ -241,6 +256,31 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Let Convolution and InnerProduct layers run the element-wise
+  ///        layers that follow them as epilogues.
+  void FuseEpilogues();
+  /// @brief Let Convolution and InnerProduct layers take a fresh 16-bit or
+  ///        sparse copy of their weights, after these changed.
+  void ResetWeightStorage();
+  /// @brief The first layer after layer_id reading blob_id, if no other
+  ///        layer reads it; -1 otherwise.
+  int FindOnlyReader(int layer_id, int blob_id) const;
+  /// @brief Let activations that are not needed at the same time share
+  ///        memory.
+  void ShareActivations();
+  /// @brief For each blob, the first blob whose data (or diff) memory it
+  ///        shares, possibly itself.
+  void FindMemoryRoots(vector<int>* data_root, vector<int>* diff_root) const;
+  /// @brief Find the layers each layer has to wait for when the layers run
+  ///        concurrently.
+  void InitConcurrentSchedule();
+  /// @brief Run the layers listed in serial order on the thread pool, as
+  ///        allowed by dependencies; false if they form a chain.
+  bool RunConcurrently(const vector<int>& layer_ids,
+      const vector<vector<int> >& dependencies, bool forward);
+  /// @brief Run one layer for RunConcurrently.
+  void RunLayer(const vector<int>* layer_ids, bool forward, int node);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -305,6 +345,29 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether activations share memory, and the blobs that must not.
+  bool share_activations_;
+  vector<string> keep_blobs_;
+  /// For each blob, the first blob whose data memory it shares by design.
+  vector<int> activation_roots_;
+  /// For each layer, the layer running it as an epilogue, or -1.
+  vector<int> fused_into_;
+  /// The im2col scratch shared by the convolutions, if any.
+  shared_ptr<Workspace<Dtype> > conv_workspace_;
+  /// The precision Convolution and InnerProduct layers multiply weights in.
+  StoragePrecision weight_storage_;
+  /// The fraction of zero weights from which those layers multiply sparsely,
+  /// or 0, and the magnitude up to which weights count as zeros.
+  float sparse_min_sparsity_;
+  float sparse_threshold_;
+  /// Whether to run independent layers concurrently in CPU mode.
+  bool concurrent_branches_;
+  /// For each layer, the earlier layers it has to wait for in Forward, and
+  /// the later layers it has to wait for in Backward.
+  vector<vector<int> > forward_dependencies_;
+  vector<vector<int> > backward_dependencies_;
+  /// The loss of each layer in the last concurrent Forward.
+  vector<Dtype> layer_losses_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
@@ -0,0 +1,72 @@
+#ifndef CAFFE_NET_SESSION_HPP_
+#define CAFFE_NET_SESSION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Repeated inference over a Net whose inputs change only partially
+ *        between calls, e.g. interactive segmentation where each click
+ *        updates the scribble inputs but not the image.
+ *
+ * The session keeps the activations of the previous Forward and, on the next
+ * one, re-runs only the layers downstream of the inputs that changed. Changes
+ * are detected by comparing each net input against a copy taken at the last
+ * Forward, so inputs may be written directly into the net's blobs (as pycaffe
+ * does). Layers without bottoms other than Input layers (data layers) are
+ * treated as producing new data on every call.
+ *
+ * The cached activations are only valid as long as nothing but the net inputs
+ * changes: call Invalidate() after changing weights or any other state, and
+ * MarkChanged() after writing to an intermediate blob by hand.
+ */
+template <typename Dtype>
+class NetSession {
+ public:
+  explicit NetSession(const shared_ptr<Net<Dtype> >& net);
+
+  /**
+   * @brief Run the layers affected by input changes since the last call
+   *        (all of them on the first call) and return the net outputs.
+   */
+  const vector<Blob<Dtype>*>& Forward(Dtype* loss = NULL);
+
+  /// @brief Drop the cached activations; the next Forward runs every layer.
+  void Invalidate() { valid_ = false; }
+  /// @brief Re-run everything downstream of blob_name on the next Forward.
+  void MarkChanged(const string& blob_name);
+
+  /// @brief the ids of the layers run by the last Forward
+  inline const vector<int>& last_run_layers() const { return run_layers_; }
+  inline const shared_ptr<Net<Dtype> >& net() const { return net_; }
+
+ protected:
+  /// @brief Flag the layers that have to run given the changed blobs.
+  void FindDirtyLayers(const vector<bool>& changed_blobs,
+                       vector<bool>* dirty_layers) const;
+
+  shared_ptr<Net<Dtype> > net_;
+  /// copies of the net inputs taken at the last Forward
+  vector<shared_ptr<Blob<Dtype> > > input_snapshots_;
+  /// layers that run on every call: data layers without bottoms
+  vector<bool> source_layers_;
+  /// for each blob, the layers writing it (more than one when in place)
+  vector<vector<int> > blob_writers_;
+  /// blobs flagged through MarkChanged since the last Forward
+  vector<bool> marked_blobs_;
+  vector<Dtype> layer_losses_;
+  vector<int> run_layers_;
+  bool valid_;
+
+  DISABLE_COPY_AND_ASSIGN(NetSession);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NET_SESSION_HPP_
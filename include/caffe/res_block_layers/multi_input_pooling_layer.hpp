@@ -17,6 +17,7 @@
 #include "caffe/layers/neuron_layer.hpp"
 #include "caffe/layers/conv_layer.hpp"
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/syncedmem.hpp"
 //#include "caffe/crf_layers/pairwise_potential_layer.hpp"
 //#include "caffe/util/modified_permutohedral.hpp"
 //#include "caffe/proto/caffe.pb.h"
@@ -50,6 +51,12 @@ private:
     virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                               const vector<bool>& propagate_down,
                               const vector<Blob<Dtype>*>& bottom);
+    // max-reduce / scatter the elements [begin, end) of all inputs
+    void ForwardRange(const vector<Blob<Dtype>*>& bottom,
+                      const vector<Blob<Dtype>*>& top, int begin, int end);
+    void BackwardRange(const vector<Blob<Dtype>*>& top,
+                       const vector<bool>& propagate_down,
+                       const vector<Blob<Dtype>*>& bottom, int begin, int end);
 
     int count_;
     int num_;
@@ -58,6 +65,8 @@ private:
     int width_;
     int num_pixels_;
     int inputN_;
+    // index of the input that won each element, stored as one byte
+    shared_ptr<SyncedMemory> max_idx_;
 };
 }  // namespace caffe
 
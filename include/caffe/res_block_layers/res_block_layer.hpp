@@ -62,6 +62,10 @@ private:
     int width_;
     int num_pixels_;
     bool enable_residual_;
+    // fused mode: ReLU is applied inside each convolution, dropout runs in
+    // place on the convolution output (TRAIN only), and the four
+    // convolutions share workspace_ as their im2col scratch.
+    bool fused_;
     int layerN_;
     vector<shared_ptr<Blob<Dtype> > > split_out_blobs_;
     vector<shared_ptr<Blob<Dtype> > > conv_out_blobs_;
@@ -85,6 +89,7 @@ private:
     vector<shared_ptr<DropoutLayer<Dtype> > > drop_layers_;
     shared_ptr<SplitLayer<Dtype> > split_layer_;
     shared_ptr<EltwiseLayer<Dtype> > sum_layer_;
+    shared_ptr<Workspace<Dtype> > workspace_;
     
 };
 }  // namespace caffe
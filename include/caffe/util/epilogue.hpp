@@ -0,0 +1,70 @@
+#ifndef CAFFE_UTIL_EPILOGUE_HPP_
+#define CAFFE_UTIL_EPILOGUE_HPP_
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Element-wise work that a Convolution or InnerProduct layer applies
+ *        to its output right after computing it, while it is still in cache.
+ *
+ * The epilogue first adds a residual as an Eltwise SUM would,
+ * top = coeff * top + residual_coeff * residual, then runs an activation in
+ * place. Backward reads the activation derivative off the output, turns the
+ * top diff in place into the diff of the layer's own output and writes the
+ * residual diff.
+ */
+template <typename Dtype>
+class Epilogue {
+ public:
+  Epilogue();
+
+  /**
+   * @brief Whether a layer of these parameters can be the activation:
+   *        a ReLU, PReLU, ELU, Sigmoid or TanH.
+   *
+   * With backward, the output must also tell the sign of the input, which
+   * rules out PReLU and negative slopes.
+   */
+  static bool CanFuseActivation(const LayerParameter& param, bool backward);
+
+  void set_residual(Blob<Dtype>* residual, Dtype coeff, Dtype residual_coeff,
+                    bool propagate_down);
+  /// @brief The activation layer must be set up on the output's shape.
+  void set_activation(const shared_ptr<Layer<Dtype> >& activation);
+
+  /// @brief Checks the residual against the output's shape.
+  void Reshape(const Blob<Dtype>& top);
+  /// @brief Applies the epilogue to the count outputs starting at offset.
+  void Forward_cpu(int offset, int count, Dtype* top_data) const;
+  void Backward_cpu(Blob<Dtype>* top) const;
+  /// @brief Applies the epilogue to the whole output, running the
+  ///        activation layer in place.
+  void Forward_gpu(Blob<Dtype>* top) const;
+  void Backward_gpu(Blob<Dtype>* top) const;
+
+ protected:
+  enum ActivationType { NONE, RELU, PRELU, ELU, SIGMOID, TANH };
+
+  Blob<Dtype>* residual_;
+  Dtype coeff_;
+  Dtype residual_coeff_;
+  bool propagate_residual_;
+  shared_ptr<Layer<Dtype> > activation_;
+  ActivationType activation_type_;
+  /// The ReLU negative slope or the ELU alpha.
+  Dtype slope_;
+  /// The PReLU channels and the size of each channel of the output.
+  int channels_;
+  int dim_;
+
+  DISABLE_COPY_AND_ASSIGN(Epilogue);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_EPILOGUE_HPP_
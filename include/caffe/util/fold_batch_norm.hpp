@@ -0,0 +1,26 @@
+#ifndef CAFFE_UTIL_FOLD_BATCH_NORM_HPP_
+#define CAFFE_UTIL_FOLD_BATCH_NORM_HPP_
+
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Copies the definition and the trained weights of a TEST net, folding
+ *        BatchNorm, Scale and Bias layers into the Convolution or
+ *        InnerProduct layer whose output they transform.
+ *
+ * param is the definition net was built from. Every layer of param_folded
+ * carries its weights as blobs, so Net(param_folded) needs no caffemodel.
+ * A layer is folded when it is per-channel, reads the only top of the
+ * producing layer and no other layer reads that top in between; BatchNorm
+ * also needs its global statistics. Returns the number of layers folded.
+ */
+template <typename Dtype>
+int FoldBatchNorm(const NetParameter& param, const Net<Dtype>& net,
+    NetParameter* param_folded);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FOLD_BATCH_NORM_HPP_
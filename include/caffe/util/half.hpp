@@ -0,0 +1,120 @@
+#ifndef CAFFE_UTIL_HALF_HPP_
+#define CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+inline uint32_t float_bits(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+inline float float_from_bits(uint32_t bits) {
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+/// @brief Rounds to the nearest bfloat16, ties to even; NaNs stay NaNs.
+inline uint16_t float_to_bf16(float f) {
+  uint32_t bits = float_bits(f);
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40);
+  }
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return static_cast<uint16_t>(bits >> 16);
+}
+
+inline float bf16_to_float(uint16_t h) {
+  return float_from_bits(static_cast<uint32_t>(h) << 16);
+}
+
+/**
+ * @brief Rounds to the nearest IEEE half, ties to even, with subnormals;
+ *        overflows to infinity.
+ *
+ * The rounding is done by the float unit: scaling by 2^112 then 2^-110
+ * leaves the bits below the half mantissa to be rounded off by one add.
+ * Nothing branches on the value, so loops over it vectorize.
+ */
+inline uint16_t float_to_fp16(float f) {
+  const float scale_to_inf = float_from_bits(0x77800000);  // 2^112
+  const float scale_to_zero = float_from_bits(0x08800000);  // 2^-110
+  float base = (std::fabs(f) * scale_to_inf) * scale_to_zero;
+  const uint32_t w = float_bits(f);
+  const uint32_t shl1_w = w + w;
+  const uint32_t sign = w & 0x80000000;
+  uint32_t bias = shl1_w & 0xff000000;
+  if (bias < 0x71000000) {
+    bias = 0x71000000;
+  }
+  base = float_from_bits((bias >> 1) + 0x07800000) + base;
+  const uint32_t bits = float_bits(base);
+  const uint32_t exp_bits = (bits >> 13) & 0x00007c00;
+  const uint32_t mantissa_bits = bits & 0x00000fff;
+  const uint32_t nonsign = exp_bits + mantissa_bits;
+  return static_cast<uint16_t>((sign >> 16) |
+      (shl1_w > 0xff000000 ? 0x7e00 : nonsign));
+}
+
+/// @brief Exact; branch free like float_to_fp16.
+inline float fp16_to_float(uint16_t h) {
+  const uint32_t w = static_cast<uint32_t>(h) << 16;
+  const uint32_t sign = w & 0x80000000;
+  const uint32_t two_w = w + w;
+  // Rebias the exponent, then scale by 2^-112 to fix infinities and NaNs.
+  const float normalized = float_from_bits((two_w >> 4) + (0xe0 << 23)) *
+      float_from_bits(0x07800000);
+  // Subnormals: the mantissa under the exponent of 0.5, minus 0.5.
+  const float denormalized =
+      float_from_bits((two_w >> 17) | (126 << 23)) - 0.5f;
+  const uint32_t result = sign | (two_w < (1u << 27) ?
+      float_bits(denormalized) : float_bits(normalized));
+  return float_from_bits(result);
+}
+
+/// @brief The number of bytes per value stored in a precision.
+inline int storage_bytes(StoragePrecision precision) {
+  return precision == FULL_PRECISION ? 0 : 2;
+}
+
+/// @brief Converts the n values of x to the 16-bit precision.
+template <typename Dtype>
+void caffe_cpu_to_half(StoragePrecision precision, const int n,
+    const Dtype* x, uint16_t* y);
+
+template <typename Dtype>
+void caffe_cpu_from_half(StoragePrecision precision, const int n,
+    const uint16_t* x, Dtype* y);
+
+/**
+ * @brief C = W * B, with the M x K matrix W stored in the 16-bit precision
+ *        and B K x N; all row-major.
+ *
+ * W is converted as it is read and the products accumulate in Dtype, so the
+ * only error is the rounding of W. Blocks of rows of C run in parallel.
+ */
+template <typename Dtype>
+void caffe_cpu_half_gemm(StoragePrecision precision, const int M,
+    const int N, const int K, const uint16_t* W, const Dtype* B, Dtype* C);
+
+/**
+ * @brief C = A * W^T, with A M x K and the N x K matrix W stored in the 16-bit
+ *        precision, as the weights of an inner product.
+ *
+ * Each row of W is read once for all the rows of A. The rows of W run in
+ * parallel.
+ */
+template <typename Dtype>
+void caffe_cpu_gemm_half_trans(StoragePrecision precision, const int M,
+    const int N, const int K, const Dtype* A, const uint16_t* W, Dtype* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_HPP_
@@ -0,0 +1,84 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Allocates the host memory of blobs, aligned to 64 bytes so that the
+ *        vector loads of the CPU kernels, up to AVX-512, never split a line.
+ *
+ * Freed blocks are cached by size class and handed out again, which spares
+ * Reshape and short-lived nets the round trips to the system allocator and
+ * the page faults of fresh memory. There are four size classes per power of
+ * two, so a block is at most 25% larger than requested. Once the cache holds
+ * max_cached_bytes, freed blocks go back to the system; 0 disables caching.
+ *
+ * With huge_pages, blocks of kHugePageSize and more are aligned to it and
+ * advised to use transparent huge pages, where the system supports them.
+ *
+ * Thread safe. Choose the allocator of the process with
+ * Caffe::set_host_allocator.
+ */
+class HostAllocator {
+ public:
+  struct Stats {
+    /// Bytes of the blocks held by callers.
+    size_t bytes_in_use;
+    size_t peak_bytes_in_use;
+    /// Bytes of the freed blocks kept for reuse.
+    size_t bytes_cached;
+    size_t num_allocs;
+    /// Allocations served from the cache.
+    size_t num_cache_hits;
+  };
+
+  static const size_t kAlignment = 64;
+  static const size_t kHugePageSize = 2 << 20;
+  static const size_t kDefaultMaxCachedBytes = 1 << 30;
+
+  explicit HostAllocator(size_t max_cached_bytes = kDefaultMaxCachedBytes,
+                         bool huge_pages = false);
+  /// @brief Releases the cache; every block must have been freed.
+  ~HostAllocator();
+
+  void* Allocate(size_t size);
+  /// @brief Frees a block; size is the one passed to Allocate.
+  void Free(void* ptr, size_t size);
+  /// @brief Gives the cached blocks back to the system.
+  void ReleaseCache();
+
+  Stats stats() const;
+  inline size_t max_cached_bytes() const { return max_cached_bytes_; }
+  inline bool huge_pages() const { return huge_pages_; }
+
+ protected:
+  /// @brief The size of the block serving a request of size bytes.
+  size_t BlockSize(size_t size) const;
+  void* SystemAllocate(size_t block_size) const;
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+
+  const size_t max_cached_bytes_;
+  const bool huge_pages_;
+  shared_ptr<sync> sync_;
+  Stats stats_;
+  /// Freed blocks by block size.
+  std::map<size_t, std::vector<void*> > cache_;
+
+  DISABLE_COPY_AND_ASSIGN(HostAllocator);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
@@ -0,0 +1,26 @@
+#ifndef CAFFE_UTIL_INSERT_LAYOUTS_HPP_
+#define CAFFE_UTIL_INSERT_LAYOUTS_HPP_
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Copies a net definition so that the layers that can run in NHWC do,
+ *        with Layout layers converting blobs where they meet the others.
+ *
+ * Convolution and Pooling always switch to NHWC, converting their inputs if
+ * needed. Element-wise activations, Eltwise, BatchNorm, Scale and Softmax
+ * follow the layout their first input already has. A blob written in NHWC
+ * is renamed with an "_nhwc" suffix; layers reading it in NCHW, and the
+ * outputs of the net, get it back under its own name. Meant for TEST nets
+ * run on the CPU with 4-D inputs to Convolution and Pooling.
+ */
+void InsertLayouts(const NetParameter& param, NetParameter* param_layout);
+
+/// @brief Whether a layer of these parameters has an NHWC implementation.
+bool LayerSupportsNHWC(const LayerParameter& param);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INSERT_LAYOUTS_HPP_
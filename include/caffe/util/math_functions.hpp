@@ -12,6 +12,10 @@
 
 namespace caffe {
 
+// Sets the number of threads the BLAS library may use, where the library
+// supports it (MKL, OpenBLAS); a no-op otherwise.
+void caffe_set_blas_num_threads(const int num_threads);
+
 // Caffe gemm provides a simpler interface to the gemm functions, with the
 // limitation that the data has to be contiguous in memory.
 template <typename Dtype>
@@ -91,6 +95,13 @@ void caffe_exp(const int n, const Dtype* a, Dtype* y);
 template <typename Dtype>
 void caffe_log(const int n, const Dtype* a, Dtype* y);
 
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
+// y[i] = 1 / (1 + exp(-a[i]))
+template <typename Dtype>
+void caffe_sigmoid(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
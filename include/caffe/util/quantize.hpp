@@ -0,0 +1,59 @@
+#ifndef CAFFE_UTIL_QUANTIZE_HPP_
+#define CAFFE_UTIL_QUANTIZE_HPP_
+
+#include <stdint.h>
+
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+/// @brief The largest magnitude of a symmetric int8 value; -128 is unused.
+const int kInt8Max = 127;
+
+/// @brief The largest magnitude among the n values of x.
+template <typename Dtype>
+Dtype caffe_cpu_amax(const int n, const Dtype* x);
+
+/// @brief Rounds scale * x[i] to the nearest int8, clipping to +-kInt8Max.
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype scale, const Dtype* x,
+    int8_t* q);
+
+/**
+ * @brief Quantizes each of the rows of a rows x cols matrix with its own
+ *        scale, so that its largest magnitude maps to kInt8Max.
+ *
+ * scales[i] receives the factor turning row i of q back into w; rows of
+ * zeros get scale 0.
+ */
+template <typename Dtype>
+void caffe_cpu_quantize_rows(const int rows, const int cols, const Dtype* w,
+    int8_t* q, Dtype* scales);
+
+/**
+ * @brief C = A * op(B) for int8 matrices, accumulated exactly in int32.
+ *
+ * A is M x K and C is M x N, both row-major; B is K x N, or N x K with
+ * CblasTrans. Rows of C run in parallel on the Caffe thread pool.
+ */
+void caffe_cpu_gemm_s8(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const int8_t* A, const int8_t* B, int32_t* C);
+
+/**
+ * @brief Records the input ranges of the Convolution and InnerProduct layers
+ *        of a float TEST net as their quantization_param.
+ *
+ * Runs iterations forward passes of net, which was built from param, and
+ * copies param into param_calibrated with the input_range of every such layer
+ * set to the largest magnitude its input took. Returns the number of layers
+ * calibrated.
+ */
+template <typename Dtype>
+int CalibrateQuantization(const NetParameter& param, Net<Dtype>* net,
+    int iterations, NetParameter* param_calibrated);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZE_HPP_
@@ -0,0 +1,32 @@
+#ifndef CAFFE_UTIL_SOFTMAX_HPP_
+#define CAFFE_UTIL_SOFTMAX_HPP_
+
+namespace caffe {
+
+/**
+ * @brief Softmax over the channels of x, laid out as
+ *        outer_num x channels x inner_num, for each of its
+ *        outer_num x inner_num positions.
+ *
+ * The positions are cut into tiles that run on the Caffe thread pool. One
+ * pass over a tile finds the maxima, a second writes exp(x - max) to y and
+ * sums it, and the tile, still in cache, is then divided by the sums.
+ * The spatial positions of a tile are contiguous, so the passes vectorize
+ * across them. y may be x.
+ */
+template <typename Dtype>
+void caffe_cpu_softmax(const int outer_num, const int channels,
+    const int inner_num, const Dtype* x, Dtype* y);
+
+/**
+ * @brief The gradient of caffe_cpu_softmax with respect to x, given its
+ *        output y: x_diff = y * (y_diff - sum_channels(y_diff * y)), in the
+ *        same tiles. x_diff may be y_diff.
+ */
+template <typename Dtype>
+void caffe_cpu_softmax_backward(const int outer_num, const int channels,
+    const int inner_num, const Dtype* y, const Dtype* y_diff, Dtype* x_diff);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SOFTMAX_HPP_
@@ -0,0 +1,75 @@
+#ifndef CAFFE_UTIL_SPARSE_HPP_
+#define CAFFE_UTIL_SPARSE_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A rows x cols matrix in compressed sparse row form: the nonzeros of
+ *        row r are values[row_begin[r], row_begin[r + 1]), in the columns
+ *        listed at the same positions of col.
+ */
+template <typename Dtype>
+struct SparseMatrix {
+  int rows;
+  int cols;
+  vector<int> row_begin;
+  vector<int> col;
+  vector<Dtype> values;
+
+  SparseMatrix() : rows(0), cols(0) {}
+  inline int nnz() const { return values.size(); }
+  /// @brief The fraction of the entries that are zeros.
+  inline double sparsity() const {
+    return rows * cols > 0 ? 1 - double(nnz()) / rows / cols : 0;
+  }
+};
+
+/**
+ * @brief Keeps the entries of the row-major rows x cols matrix a whose
+ *        magnitude is above threshold; with threshold 0, the nonzeros.
+ */
+template <typename Dtype>
+void caffe_cpu_to_sparse(const int rows, const int cols, const Dtype* a,
+    const Dtype threshold, SparseMatrix<Dtype>* s);
+
+/**
+ * @brief C = A * B for sparse A (M x K) and row-major B (K x N) and C
+ *        (M x N), as the 1 x 1 convolution of B by A.
+ *
+ * Each nonzero of a row of A adds a row of B, scaled, to the row of C.
+ * Rows of C run in parallel on the Caffe thread pool.
+ */
+template <typename Dtype>
+void caffe_cpu_sparse_gemm(const SparseMatrix<Dtype>& A, const int N,
+    const Dtype* B, Dtype* C);
+
+/**
+ * @brief C = B * A^T for row-major B (M x K) and C (M x N) and sparse A
+ *        (N x K), as the inner products of B by the weights A.
+ *
+ * Each entry of C is the dot product of a row of A with the values of a row
+ * of B it picks out. Columns of C run in parallel on the Caffe thread pool.
+ */
+template <typename Dtype>
+void caffe_cpu_sparse_gemm_trans(const int M, const Dtype* B,
+    const SparseMatrix<Dtype>& A, Dtype* C);
+
+/**
+ * @brief Stores the data of proto as its nonzeros and the zero_run before
+ *        each, if that takes less space than the dense values.
+ *
+ * Blobs with a diff are left dense. Blob::FromProto reads either form.
+ */
+void SparsifyBlobProto(BlobProto* proto);
+
+/// @brief SparsifyBlobProto on the blobs of every layer of param.
+void SparsifyNetBlobs(NetParameter* param);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_HPP_
@@ -0,0 +1,137 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of worker threads running the tasks of parallel loops.
+ *
+ * The thread calling Run() works on the tasks too. Tasks are claimed one at a
+ * time, so threads that finish early take over the work left by slow ones.
+ * Run() called from inside a task, or while another thread's Run() is in
+ * progress, executes its tasks inline rather than waiting for the workers.
+ */
+class ThreadPool {
+ public:
+  /// @brief num_threads counts the calling thread, so it starts one less.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  inline int num_threads() const { return num_threads_; }
+
+  /// @brief Calls task(i) for i in [0, num_tasks) and waits for all of them.
+  void Run(int num_tasks, const boost::function<void(int)>& task);
+
+ protected:
+  void WorkerLoop();
+  /// @brief Runs the tasks of the current job until none are left.
+  void Work();
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+
+  const int num_threads_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+namespace internal {
+
+template <typename Body>
+void RunChunk(const Body* body, int begin, int end, int chunk, int i) {
+  const int chunk_begin = begin + i * chunk;
+  (*body)(chunk_begin, std::min(end, chunk_begin + chunk));
+}
+
+template <typename T, typename Body>
+void RunReduceChunk(const Body* body, int begin, int end, int grain,
+    std::vector<T>* partials, int i) {
+  const int chunk_begin = begin + i * grain;
+  (*partials)[i] = (*body)(chunk_begin, std::min(end, chunk_begin + grain));
+}
+
+}  // namespace internal
+
+/**
+ * @brief Calls body(chunk_begin, chunk_end) over disjoint chunks covering
+ *        [begin, end) on the Caffe thread pool.
+ *
+ * Chunks hold at least grain iterations, so small loops stay on the calling
+ * thread. The body must only write state owned by its own chunk; results
+ * then do not depend on the number of threads.
+ */
+template <typename Body>
+void parallel_for(int begin, int end, int grain, const Body& body) {
+  const int n = end - begin;
+  if (n <= 0) { return; }
+  const int num_threads = Caffe::cpu_threads();
+  if (num_threads <= 1 || n <= grain) {
+    body(begin, end);
+    return;
+  }
+  // A few chunks per thread let the faster threads balance the load.
+  const int num_chunks = std::min((n + grain - 1) / std::max(grain, 1),
+                                  4 * num_threads);
+  const int chunk = (n + num_chunks - 1) / num_chunks;
+  Caffe::thread_pool().Run((n + chunk - 1) / chunk,
+      boost::bind(&internal::RunChunk<Body>, &body, begin, end, chunk, _1));
+}
+
+/**
+ * @brief Reduces body(chunk_begin, chunk_end) over [begin, end) with combine,
+ *        starting from identity.
+ *
+ * The chunks are cut every grain iterations whatever the number of threads
+ * and are combined in order, so the result is the same for any thread count.
+ */
+template <typename T, typename Body, typename Combine>
+T parallel_reduce(int begin, int end, int grain, const T& identity,
+    const Body& body, const Combine& combine) {
+  const int n = end - begin;
+  if (n <= 0) { return identity; }
+  grain = std::max(grain, 1);
+  const int num_chunks = (n + grain - 1) / grain;
+  std::vector<T> partials(num_chunks, identity);
+  if (Caffe::cpu_threads() <= 1 || num_chunks == 1) {
+    for (int i = 0; i < num_chunks; ++i) {
+      internal::RunReduceChunk<T, Body>(&body, begin, end, grain, &partials, i);
+    }
+  } else {
+    Caffe::thread_pool().Run(num_chunks,
+        boost::bind(&internal::RunReduceChunk<T, Body>, &body, begin, end,
+                    grain, &partials, _1));
+  }
+  T result = identity;
+  for (int i = 0; i < num_chunks; ++i) {
+    result = combine(result, partials[i]);
+  }
+  return result;
+}
+
+/**
+ * @brief Calls task(i) for the nodes i of a DAG, each once all of the nodes
+ *        listed in predecessors[i] have returned.
+ *
+ * Independent nodes run on different threads of the Caffe thread pool. Among
+ * the nodes that are ready the lowest index starts first, so with a single
+ * thread the nodes run in index order.
+ */
+void parallel_dag(const vector<vector<int> >& predecessors,
+    const boost::function<void(int)>& task);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
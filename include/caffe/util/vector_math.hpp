@@ -0,0 +1,49 @@
+#ifndef CAFFE_UTIL_VECTOR_MATH_HPP_
+#define CAFFE_UTIL_VECTOR_MATH_HPP_
+
+namespace caffe {
+
+/**
+ * @brief The instruction sets the float kernels below can run with, widest
+ *        first. BASE is SSE2 on x86, 128 bit vectors elsewhere, or plain libm
+ *        calls without GCC vector extensions.
+ */
+enum SimdIsa { SIMD_AVX512, SIMD_AVX2, SIMD_BASE };
+
+/// @brief The instruction set the kernels run with, picked at the first call
+///        as the widest one the CPU supports.
+SimdIsa caffe_simd_isa();
+/// @brief Runs the kernels with isa, or with the widest instruction set the
+///        CPU supports if that is narrower. For tests and benchmarks; not
+///        thread safe.
+void caffe_simd_set_isa(SimdIsa isa);
+const char* caffe_simd_isa_name(SimdIsa isa);
+
+/*
+ * Element-wise float transcendentals as polynomial approximations evaluated
+ * on whole vectors, for builds without MKL. The error bounds hold for every
+ * float input, measured against double precision libm, in units in the last
+ * place of the float result:
+ *
+ *   caffe_simd_exp      2 ulp; underflows to subnormals and 0, overflows
+ *                       to infinity above 88.72
+ *   caffe_simd_log      2 ulp; -inf at 0, NaN below
+ *   caffe_simd_tanh     3 ulp
+ *   caffe_simd_sigmoid  3 ulp
+ *   caffe_simd_powx     exact for b in {0, 1, 2, -1, 0.5, -0.5}; otherwise
+ *                       2 (1 + |b ln(x)|) ulp, as the error of the
+ *                       logarithm is scaled by b, so results within that
+ *                       of the largest float may overflow. Negative x
+ *                       only have a power if b is an integer.
+ *
+ * NaNs propagate and x and y may be the same array.
+ */
+void caffe_simd_exp(const int n, const float* x, float* y);
+void caffe_simd_log(const int n, const float* x, float* y);
+void caffe_simd_tanh(const int n, const float* x, float* y);
+void caffe_simd_sigmoid(const int n, const float* x, float* y);
+void caffe_simd_powx(const int n, const float* x, const float b, float* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_VECTOR_MATH_HPP_
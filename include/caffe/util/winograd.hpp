@@ -0,0 +1,48 @@
+#ifndef CAFFE_UTIL_WINOGRAD_HPP_
+#define CAFFE_UTIL_WINOGRAD_HPP_
+
+namespace caffe {
+
+// Winograd F(m x m, 3 x 3) convolution of 2D images, for m = 2 or 4: each
+// m x m output tile takes (m + 2)^2 multiplies per input channel instead of
+// 9 m^2, as an elementwise product in the transform domain.
+
+/// @brief The elements of the transformed weights, the input buffer and the
+///        output buffer of winograd_conv_cpu().
+int winograd_weights_size(const int tile, const int out_channels,
+    const int in_channels);
+int winograd_input_buffer_size(const int tile, const int in_channels,
+    const int out_height, const int out_width);
+int winograd_output_buffer_size(const int tile, const int out_channels,
+    const int out_height, const int out_width);
+
+/**
+ * @brief Transforms the 3 x 3 filters of weights, shaped out_channels x
+ *        in_channels x 3 x 3.
+ *
+ * With flip, transforms the filters of the transposed convolution instead,
+ * which computes the gradient with respect to the input: they are rotated by
+ * 180 degrees, with the in_channels as outputs.
+ */
+template <typename Dtype>
+void winograd_transform_weights_cpu(const int tile, const Dtype* weights,
+    const int out_channels, const int in_channels, const bool flip,
+    Dtype* transformed_weights);
+
+/**
+ * @brief Correlates the image with the transformed 3 x 3 filters at stride
+ *        one, overwriting output.
+ *
+ * The buffers hold winograd_input_buffer_size() and
+ * winograd_output_buffer_size() elements.
+ */
+template <typename Dtype>
+void winograd_conv_cpu(const int tile, const Dtype* data_im,
+    const int in_channels, const int height, const int width,
+    const int pad_h, const int pad_w, const Dtype* transformed_weights,
+    const int out_channels, const int out_height, const int out_width,
+    Dtype* input_buffer, Dtype* output_buffer, Dtype* output);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WINOGRAD_HPP_
@@ -0,0 +1,54 @@
+#ifndef CAFFE_UTIL_WORKSPACE_HPP_
+#define CAFFE_UTIL_WORKSPACE_HPP_
+
+#include <cstddef>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Scratch memory shared by layers that never use it at the same time,
+ *        such as the im2col buffers of the convolutions of a net.
+ *
+ * Layers reserve the elements they need at Reshape and fetch the buffer
+ * whenever they compute; it holds the largest reservation. Each thread gets
+ * its own buffer, so layers running concurrently on the thread pool do not
+ * overwrite each other's scratch.
+ */
+template <typename Dtype>
+class Workspace {
+ public:
+  Workspace();
+
+  /// @brief Grows the workspace to hold at least count elements.
+  void Reserve(int count);
+  /// @brief The buffer of the calling thread, holding the reserved elements.
+  Blob<Dtype>* buffer();
+
+  /// @brief The largest reservation so far, in elements.
+  inline int count() const { return count_; }
+  /// @brief The largest reservation so far, in bytes: the memory each
+  ///        thread's buffer takes once used.
+  inline size_t high_water_mark() const { return count_ * sizeof(Dtype); }
+  /// @brief The number of threads that have fetched a buffer.
+  int num_buffers() const;
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+
+  int count_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(Workspace);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WORKSPACE_HPP_
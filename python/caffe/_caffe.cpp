@@ -154,6 +154,12 @@ void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
       PyArray_DIMS(data_arr)[0]);
 }
 
+Dtype NetSession_Forward(NetSession<Dtype>* session) {
+  Dtype loss;
+  session->Forward(&loss);
+  return loss;
+}
+
 Solver<Dtype>* GetSolverFromFile(const string& filename) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(filename, &param);
@@ -261,6 +267,7 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("set_mode_cpu", &set_mode_cpu);
   bp::def("set_mode_gpu", &set_mode_gpu);
   bp::def("set_device", &Caffe::SetDevice);
+  bp::def("set_cpu_threads", &Caffe::set_cpu_threads);
 
   bp::def("layer_type_list", &LayerRegistry<Dtype>::LayerTypeList);
 
@@ -301,6 +308,18 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("load_hdf5", &Net_LoadHDF5);
   BP_REGISTER_SHARED_PTR_TO_PYTHON(Net<Dtype>);
 
+  bp::class_<NetSession<Dtype>, shared_ptr<NetSession<Dtype> >,
+    boost::noncopyable>("NetSession", bp::init<shared_ptr<Net<Dtype> > >())
+    .def("_forward", &NetSession_Forward)
+    .def("invalidate", &NetSession<Dtype>::Invalidate)
+    .def("mark_changed", &NetSession<Dtype>::MarkChanged)
+    .add_property("net", bp::make_function(&NetSession<Dtype>::net,
+        bp::return_value_policy<bp::copy_const_reference>()))
+    .add_property("last_run_layers",
+        bp::make_function(&NetSession<Dtype>::last_run_layers,
+        bp::return_value_policy<bp::copy_const_reference>()));
+  BP_REGISTER_SHARED_PTR_TO_PYTHON(NetSession<Dtype>);
+
   bp::class_<Blob<Dtype>, shared_ptr<Blob<Dtype> >, boost::noncopyable>(
     "Blob", bp::no_init)
     .add_property("shape",
@@ -10,7 +10,7 @@ except:
     from itertools import zip_longest as izip_longest
 import numpy as np
 
-from ._caffe import Net, SGDSolver, NesterovSolver, AdaGradSolver, \
+from ._caffe import Net, NetSession, SGDSolver, NesterovSolver, AdaGradSolver, \
         RMSPropSolver, AdaDeltaSolver, AdamSolver
 import caffe.io
 
@@ -308,6 +308,24 @@ class _Net_IdNameWrapper:
         id_to_name = list(self.net.blobs)
         return [id_to_name[i] for i in ids]
 
+def _NetSession_forward(self, blobs=None, **kwargs):
+    """
+    Forward pass that re-runs only the layers downstream of the inputs
+    that changed since the last call; see Net.forward for the arguments.
+
+    Returns
+    -------
+    outs : {blob name: blob ndarray} dict.
+    """
+    net = self.net
+    outputs = set(net.outputs + (blobs or []))
+    for in_, blob in six.iteritems(kwargs):
+        if in_ not in net.inputs:
+            raise Exception('{} is not a net input.'.format(in_))
+        net.blobs[in_].data[...] = blob
+    self._forward()
+    return {out: net.blobs[out].data for out in outputs}
+
 # Attach methods to Net.
 Net.blobs = _Net_blobs
 Net.blob_loss_weights = _Net_blob_loss_weights
@@ -322,3 +340,6 @@ Net.inputs = _Net_inputs
 Net.outputs = _Net_outputs
 Net.top_names = property(lambda n: _Net_IdNameWrapper(n, Net._top_ids))
 Net.bottom_names = property(lambda n: _Net_IdNameWrapper(n, Net._bottom_ids))
+
+# Attach methods to NetSession.
+NetSession.forward = _NetSession_forward
@@ -93,3 +93,35 @@ class TestNet(unittest.TestCase):
             for i in range(len(self.net.params[name])):
                 self.assertEqual(abs(self.net.params[name][i].data
                     - net2.params[name][i].data).sum(), 0)
+
+
+class TestNetSession(unittest.TestCase):
+    def setUp(self):
+        f = tempfile.NamedTemporaryFile(mode='w+', delete=False)
+        f.write("""name: 'clicknet'
+        layer { type: 'Input' name: 'image' top: 'image'
+          input_param { shape { dim: 1 dim: 2 dim: 5 dim: 5 } } }
+        layer { type: 'Input' name: 'scribble' top: 'scribble'
+          input_param { shape { dim: 1 dim: 1 dim: 5 dim: 5 } } }
+        layer { type: 'Convolution' name: 'trunk' bottom: 'image'
+          top: 'trunk' convolution_param { num_output: 3 kernel_size: 3
+            pad: 1 weight_filler { type: 'gaussian' std: 1 } } }
+        layer { type: 'Concat' name: 'concat' bottom: 'trunk'
+          bottom: 'scribble' top: 'concat' }""")
+        f.close()
+        self.net = caffe.Net(f.name, caffe.TEST)
+        os.remove(f.name)
+        self.session = caffe.NetSession(self.net)
+
+    def test_forward_reruns_changed_branch(self):
+        image = np.random.randn(1, 2, 5, 5)
+        out = self.session.forward(image=image,
+                                   scribble=np.zeros((1, 1, 5, 5)))
+        self.assertEqual(len(self.session.last_run_layers), 4)
+        out = self.session.forward(scribble=np.ones((1, 1, 5, 5)))
+        self.assertEqual(list(self.session.last_run_layers), [3])
+        cached = out['concat'].copy()
+        self.assertTrue((cached[:, 3] == 1).all())
+        full = self.net.forward(image=image,
+                                scribble=np.ones((1, 1, 5, 5)))
+        self.assertTrue((cached == full['concat']).all())
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -57,20 +58,21 @@ void Blob<Dtype>::Reshape(const BlobShape& shape) {
 template <typename Dtype>
 void Blob<Dtype>::ReshapeLike(const Blob<Dtype>& other) {
   Reshape(other.shape());
+  layout_ = other.layout();
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), layout_(NCHW) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), layout_(NCHW) {
   Reshape(shape);
 }
 
@@ -146,6 +148,13 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareDataMemory(const shared_ptr<SyncedMemory>& memory) {
+  CHECK_GE(memory->size(), count_ * sizeof(Dtype));
+  data_ = memory;
+  capacity_ = count_;
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -469,7 +478,25 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   }
   // copy data
   Dtype* data_vec = mutable_cpu_data();
-  if (proto.double_data_size() > 0) {
+  if (proto.zero_run_size() > 0) {
+    // Only the nonzeros are stored, between runs of zeros.
+    const bool is_double = proto.double_data_size() > 0;
+    const int nnz = is_double ? proto.double_data_size() : proto.data_size();
+    CHECK_EQ(nnz + 1, proto.zero_run_size());
+    int index = 0;
+    for (int i = 0; i <= nnz; ++i) {
+      const uint32_t run = proto.zero_run(i);
+      CHECK_LE(run, static_cast<uint32_t>(count_ - index))
+          << "zero_run exceeds the blob";
+      std::fill(data_vec + index, data_vec + index + run, Dtype(0));
+      index += run;
+      if (i < nnz) {
+        CHECK_LT(index, count_) << "zero_run exceeds the blob";
+        data_vec[index++] = is_double ? proto.double_data(i) : proto.data(i);
+      }
+    }
+    CHECK_EQ(count_, index);
+  } else if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.double_data(i);
@@ -1,11 +1,16 @@
 #include <boost/thread.hpp>
 #include <glog/logging.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -49,6 +54,63 @@ void GlobalInit(int* pargc, char*** pargv) {
   ::google::InstallFailureSignalHandler();
 }
 
+// The CPU thread pool is process-wide rather than thread local.
+static boost::mutex thread_pool_mutex_;
+static shared_ptr<ThreadPool> thread_pool_;
+static int cpu_threads_ = 0;  // 0 until configured
+
+int Caffe::cpu_threads() {
+  if (cpu_threads_ == 0) {
+    const char* env = getenv("CAFFE_NUM_THREADS");
+    if (env != NULL && atoi(env) > 0) {
+      set_cpu_threads(atoi(env));
+    } else {
+      // Leave the BLAS library at its own default.
+      boost::mutex::scoped_lock lock(thread_pool_mutex_);
+      if (cpu_threads_ == 0) {
+        cpu_threads_ = std::max<int>(1, boost::thread::hardware_concurrency());
+      }
+    }
+  }
+  return cpu_threads_;
+}
+
+void Caffe::set_cpu_threads(const int num_threads) {
+  CHECK_GE(num_threads, 1) << "Need at least one CPU thread.";
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  if (thread_pool_ && thread_pool_->num_threads() != num_threads) {
+    thread_pool_.reset();
+  }
+  cpu_threads_ = num_threads;
+  caffe_set_blas_num_threads(num_threads);
+}
+
+ThreadPool& Caffe::thread_pool() {
+  const int num_threads = cpu_threads();
+  boost::mutex::scoped_lock lock(thread_pool_mutex_);
+  if (!thread_pool_) {
+    thread_pool_.reset(new ThreadPool(num_threads));
+  }
+  return *thread_pool_;
+}
+
+static boost::mutex host_allocator_mutex_;
+static shared_ptr<HostAllocator> host_allocator_;
+
+shared_ptr<HostAllocator> Caffe::host_allocator() {
+  boost::mutex::scoped_lock lock(host_allocator_mutex_);
+  if (!host_allocator_) {
+    host_allocator_.reset(new HostAllocator());
+  }
+  return host_allocator_;
+}
+
+void Caffe::set_host_allocator(const shared_ptr<HostAllocator>& allocator) {
+  CHECK(allocator);
+  boost::mutex::scoped_lock lock(host_allocator_mutex_);
+  host_allocator_ = allocator;
+}
+
 #ifdef CPU_ONLY  // CPU-only Caffe.
 
 Caffe::Caffe()
@@ -123,6 +123,17 @@ void CRFIterationLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     sum_layer_->Reshape(sum_bottom_vec_, sum_top_vec_);
 }
 
+template <typename Dtype>
+void CRFIterationLayer<Dtype>::ShareInternalBlobs(const CRFIterationLayer<Dtype>& other)
+{
+    softmax_output_blob_->ShareData(*other.softmax_output_blob_);
+    softmax_output_blob_->ShareDiff(*other.softmax_output_blob_);
+    message_passing_output_blob_->ShareData(*other.message_passing_output_blob_);
+    message_passing_output_blob_->ShareDiff(*other.message_passing_output_blob_);
+    compatibility_output_blob_->ShareData(*other.compatibility_output_blob_);
+    compatibility_output_blob_->ShareDiff(*other.compatibility_output_blob_);
+}
+
 /**
  * Forward pass during the inference.
  */
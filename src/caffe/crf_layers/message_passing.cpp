@@ -14,14 +14,17 @@
  *
  *             For more information about CRF-RNN, please visit the project website http://crfasrnn.torr.vision.
  */
+#include <algorithm>
 #include <vector>
 #include <math.h>
+#include <boost/bind.hpp>
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layers/loss_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/crf_layers/message_passing_layer.hpp"
 #include "caffe/crf_layers/pixel_access.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 template <typename Dtype>
@@ -71,130 +74,167 @@ void MessagePassingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top[0]->Reshape(num_, channels_, height_, width_);
 }
 template <typename Dtype>
-void MessagePassingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                        const vector<Blob<Dtype>*>& top)
+void MessagePassingLayer<Dtype>::ForwardRange(const Dtype* input_data, const Dtype* kernel_data,
+                                              const Dtype* mask_data, Dtype* output_data,
+                                              int begin, int end)
 {
-    const Dtype * input_data  = bottom[0]->cpu_data();
-    const Dtype * kernel_data = bottom[1]->cpu_data();
-    const Dtype * mask_data   = (user_interaction_constrain_)? bottom[2]->cpu_data(): NULL;
-    Dtype * output_data=top[0]->mutable_cpu_data();
+    // [begin, end) indexes the image rows of all the samples
     int kr=(kernel_size_-1)/2;
-    for(int n=0; n<num_; n++)
+    for(int row=begin; row<end; row++)
     {
-        for(int h=0; h< height_; h++)
+        const int n = row / height_;
+        const int h = row % height_;
+        for(int w=0; w<width_; w++)
         {
-            for(int w=0; w<width_; w++)
+            bool interaction_exist=false;
+            if(user_interaction_constrain_){
+                interaction_exist = get_pixel(mask_data, num_, 1, height_, width_, n, 0, h, w)>0;
+            }
+            for(int c=0; c<channels_; c++)
             {
-                bool interaction_exist=false;
-                if(user_interaction_constrain_){
-                    interaction_exist = get_pixel(mask_data, num_, 1, height_, width_, n, 0, h, w)>0;
-                }
-                for(int c=0; c<channels_; c++)
-                {
-                    Dtype sum_value=0.0;
-                    int neighIdx=0;
-                    if(!(user_interaction_constrain_ && interaction_exist)){
-                        for(int i=-kr; i<=kr; i++)
+                Dtype sum_value=0.0;
+                int neighIdx=0;
+                if(!(user_interaction_constrain_ && interaction_exist)){
+                    for(int i=-kr; i<=kr; i++)
+                    {
+                        for(int j=-kr; j<=kr; j++)
                         {
-                            for(int j=-kr; j<=kr; j++)
-                            {
-                                if(i==0 && j==0) continue;
-                                Dtype value = get_pixel(input_data, num_, channels_, height_, width_,
-                                                        n, c, h+i, w+j);
-                                Dtype weight = get_pixel(kernel_data, num_, neighN_, height_, width_,
-                                                         n, neighIdx, h, w);
-                                sum_value  += value*weight;
-                                neighIdx++;
-                            }
+                            if(i==0 && j==0) continue;
+                            Dtype value = get_pixel(input_data, num_, channels_, height_, width_,
+                                                    n, c, h+i, w+j);
+                            Dtype weight = get_pixel(kernel_data, num_, neighN_, height_, width_,
+                                                     n, neighIdx, h, w);
+                            sum_value  += value*weight;
+                            neighIdx++;
                         }
                     }
-                    set_pixel(output_data, num_, channels_, height_, width_,
-                              n, c, h, w, sum_value);
                 }
+                set_pixel(output_data, num_, channels_, height_, width_,
+                          n, c, h, w, sum_value);
             }
         }
     }
 }
 
 template <typename Dtype>
-void MessagePassingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
-                                       const vector<bool>& propagate_down,
-                                       const vector<Blob<Dtype>*>& bottom)
+void MessagePassingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+                                        const vector<Blob<Dtype>*>& top)
 {
-    const Dtype * top_diff = top[0]->cpu_diff();
-    const Dtype * bottom_data = bottom[0]->cpu_data();
-    Dtype * bottom_diff = bottom[0]->mutable_cpu_diff();
+    const Dtype * input_data  = bottom[0]->cpu_data();
     const Dtype * kernel_data = bottom[1]->cpu_data();
-    Dtype * kernel_diff = bottom[1]->mutable_cpu_diff();
     const Dtype * mask_data   = (user_interaction_constrain_)? bottom[2]->cpu_data(): NULL;
+    Dtype * output_data=top[0]->mutable_cpu_data();
+    parallel_for(0, num_ * height_, RowGrain(channels_),
+                 boost::bind(&MessagePassingLayer<Dtype>::ForwardRange, this,
+                             input_data, kernel_data, mask_data, output_data, _1, _2));
+}
+
+template <typename Dtype>
+void MessagePassingLayer<Dtype>::BackwardDataRange(const Dtype* top_diff, const Dtype* kernel_data,
+                                                   const Dtype* mask_data, Dtype* bottom_diff,
+                                                   int begin, int end)
+{
+    // [begin, end) indexes the image rows of all the samples and channels
     int kr=(kernel_size_-1)/2;
-    for(int n=0; n<num_; n++)
+    for(int row=begin; row<end; row++)
     {
-        for(int c=0; c<channels_; c++)
+        const int n = row / (channels_ * height_);
+        const int c = (row / height_) % channels_;
+        const int h = row % height_;
+        for(int w=0; w<width_; w++)
         {
-            for(int h=0; h< height_; h++)
+            int q_index=0;
+            Dtype value_diff = 0.0;
+            for(int i=-kr; i<=kr; i++)
             {
-                for(int w=0; w<width_; w++)
+                for(int j=-kr; j<=kr; j++)
                 {
-                    int q_index=0;
-                    Dtype value_diff = 0.0;
-                    for(int i=-kr; i<=kr; i++)
-                    {
-                        for(int j=-kr; j<=kr; j++)
-                        {
-                            if(i==0 && j==0) continue;
-                            int nq_index = neighN_ -1 -q_index;
-                            Dtype weight_nq = get_pixel(kernel_data, num_, neighN_, height_, width_,
-                                                     n, nq_index, h+i, w+j);
-                            if(user_interaction_constrain_ &&
-                               get_pixel(mask_data, num_, 1, height_, width_, n, 0, h+i, w+j)){
-                                weight_nq = 0;
-                            }
-                            Dtype t_diff_nq = get_pixel(top_diff, num_, channels_, height_, width_,
-                                                        n, c, h+i, w+j);
-                            value_diff += weight_nq * t_diff_nq;
-                            q_index++;
-                        }
+                    if(i==0 && j==0) continue;
+                    int nq_index = neighN_ -1 -q_index;
+                    Dtype weight_nq = get_pixel(kernel_data, num_, neighN_, height_, width_,
+                                             n, nq_index, h+i, w+j);
+                    if(user_interaction_constrain_ &&
+                       get_pixel(mask_data, num_, 1, height_, width_, n, 0, h+i, w+j)){
+                        weight_nq = 0;
                     }
-                    set_pixel(bottom_diff, num_, channels_, height_, width_,
-                              n, c, h, w, value_diff);
+                    Dtype t_diff_nq = get_pixel(top_diff, num_, channels_, height_, width_,
+                                                n, c, h+i, w+j);
+                    value_diff += weight_nq * t_diff_nq;
+                    q_index++;
                 }
             }
+            set_pixel(bottom_diff, num_, channels_, height_, width_,
+                      n, c, h, w, value_diff);
         }
     }
-    
-    for(int n=0; n<num_; n++)
+}
+
+template <typename Dtype>
+void MessagePassingLayer<Dtype>::BackwardKernelRange(const Dtype* top_diff, const Dtype* bottom_data,
+                                                     const Dtype* mask_data, Dtype* kernel_diff,
+                                                     int begin, int end)
+{
+    // [begin, end) indexes the image rows of all the samples
+    int kr=(kernel_size_-1)/2;
+    for(int row=begin; row<end; row++)
     {
-        for(int h=0; h< height_; h++)
+        const int n = row / height_;
+        const int h = row % height_;
+        for(int w=0; w<width_; w++)
         {
-            for(int w=0; w<width_; w++)
+            if(user_interaction_constrain_ &&
+               get_pixel(mask_data, num_, 1, height_, width_, n, 0, h, w)){
+                continue;
+            }
+            int q_index=0;
+            for(int i=-kr; i<=kr; i++)
             {
-                if(user_interaction_constrain_ &&
-                   get_pixel(mask_data, num_, 1, height_, width_, n, 0, h, w)){
-                    continue;
-                }
-                int q_index=0;
-                for(int i=-kr; i<=kr; i++)
+                for(int j=-kr; j<=kr; j++)
                 {
-                    for(int j=-kr; j<=kr; j++)
+                    if(i==0 && j==0) continue;
+                    Dtype k_diff = 0.0;
+                    for(int c=0; c< channels_; c++)
                     {
-                        if(i==0 && j==0) continue;
-                        Dtype k_diff = 0.0;
-                        for(int c=0; c< channels_; c++)
-                        {
-                            Dtype value = get_pixel(bottom_data, num_, channels_, height_, width_, n, c, h+i, w+j);
-                            Dtype t_diff = get_pixel(top_diff, num_, channels_, height_, width_,
-                                                        n, c, h, w);
-                            k_diff += t_diff*value;
-                        }
-                        set_pixel(kernel_diff, num_, neighN_, height_, width_, n, q_index, h, w, k_diff);
-                        q_index++;
+                        Dtype value = get_pixel(bottom_data, num_, channels_, height_, width_, n, c, h+i, w+j);
+                        Dtype t_diff = get_pixel(top_diff, num_, channels_, height_, width_,
+                                                    n, c, h, w);
+                        k_diff += t_diff*value;
                     }
+                    set_pixel(kernel_diff, num_, neighN_, height_, width_, n, q_index, h, w, k_diff);
+                    q_index++;
                 }
             }
         }
     }
 }
 
+template <typename Dtype>
+void MessagePassingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+                                       const vector<bool>& propagate_down,
+                                       const vector<Blob<Dtype>*>& bottom)
+{
+    const Dtype * top_diff = top[0]->cpu_diff();
+    const Dtype * bottom_data = bottom[0]->cpu_data();
+    Dtype * bottom_diff = bottom[0]->mutable_cpu_diff();
+    const Dtype * kernel_data = bottom[1]->cpu_data();
+    Dtype * kernel_diff = bottom[1]->mutable_cpu_diff();
+    const Dtype * mask_data   = (user_interaction_constrain_)? bottom[2]->cpu_data(): NULL;
+    parallel_for(0, num_ * channels_ * height_, RowGrain(1),
+                 boost::bind(&MessagePassingLayer<Dtype>::BackwardDataRange, this,
+                             top_diff, kernel_data, mask_data, bottom_diff, _1, _2));
+    parallel_for(0, num_ * height_, RowGrain(channels_),
+                 boost::bind(&MessagePassingLayer<Dtype>::BackwardKernelRange, this,
+                             top_diff, bottom_data, mask_data, kernel_diff, _1, _2));
+}
+
+template <typename Dtype>
+int MessagePassingLayer<Dtype>::RowGrain(int channels) const
+{
+    // rows per pool task, so that a task visits a few thousand neighbours
+    const int kMinNeighboursPerTask = 16384;
+    const int per_row = std::max(1, width_ * channels * neighN_);
+    return std::max(1, kMinNeighboursPerTask / per_row);
+}
+
 INSTANTIATE_CLASS(MessagePassingLayer);
 }  // namespace caffe
@@ -34,6 +34,7 @@ void MultiStageCRFLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   const caffe::MultiStageCRFParameter multi_crf_param = this->layer_param_.multi_stage_crf_param();
   num_iterations_ = multi_crf_param.num_iterations();
   user_interaction_constrain_ = multi_crf_param.user_interaction_constrain();
+  checkpoint_iterations_ = multi_crf_param.checkpoint_iterations();
   CHECK_GT(num_iterations_, 1) << "Number of iterations must be greater than 1.";
 
   count_ = bottom[0]->count();
@@ -203,6 +204,15 @@ void MultiStageCRFLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
         }
         crf_iterations_[i]->Reshape(interation_bottom_vecs_[i], interation_top_vecs_[i]);
     }
+    if(checkpoint_iterations_)
+    {
+        // One set of intermediates and of pairwise diffs serves all
+        // iterations; Reshape may have reallocated them, so share again.
+        for (int i = 1; i < num_iterations_; ++i) {
+            crf_iterations_[i]->ShareInternalBlobs(*crf_iterations_[0]);
+            pair_split_output_blobs_[i]->ShareDiff(*pair_split_output_blobs_[0]);
+        }
+    }
 //    std::cout<<"multistagecrf reshape crf iteration finished"<<std::endl;
 }
 
@@ -255,14 +265,35 @@ void MultiStageCRFLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
 //  unary_split_layer_bottom_vec_[0] = bottom[1];
 //  interation_top_vecs_[num_iterations_-1][0] = top[0];
 //  std::cout<<"back multistagecrf start"<<std::endl;
-  for (int i = (num_iterations_ - 1); i >= 0; i--) {
-    vector<bool> iter_propagate_down(3, true);
-    crf_iterations_[i]->Backward(interation_top_vecs_[i], iter_propagate_down, interation_bottom_vecs_[i]);
-    //LOG(INFO) << ("crf iteration done ")<<i;
+  if(checkpoint_iterations_)
+  {
+    // The intermediates still hold the last iteration; the earlier ones are
+    // recomputed from their stored inputs. The pairwise diff is accumulated
+    // here since all the pair split tops share a single diff.
+    Dtype * pairwise_diff = pairwise_layer_output_blob_->mutable_cpu_diff();
+    caffe_set(pairwise_layer_output_blob_->count(), Dtype(0), pairwise_diff);
+    for (int i = (num_iterations_ - 1); i >= 0; i--) {
+      if(i < num_iterations_ - 1)
+      {
+        crf_iterations_[i]->Forward(interation_bottom_vecs_[i], interation_top_vecs_[i]);
+      }
+      vector<bool> iter_propagate_down(3, true);
+      crf_iterations_[i]->Backward(interation_top_vecs_[i], iter_propagate_down, interation_bottom_vecs_[i]);
+      caffe_axpy(pairwise_layer_output_blob_->count(), Dtype(1.),
+                 pair_split_output_blobs_[i]->cpu_diff(), pairwise_diff);
+    }
   }
+  else
+  {
+    for (int i = (num_iterations_ - 1); i >= 0; i--) {
+      vector<bool> iter_propagate_down(3, true);
+      crf_iterations_[i]->Backward(interation_top_vecs_[i], iter_propagate_down, interation_bottom_vecs_[i]);
+      //LOG(INFO) << ("crf iteration done ")<<i;
+    }
 //  std::cout<<"back crf iteration finished"<<std::endl;
-  vector<bool> pair_split_propagate_down(1, true);
-  pair_split_layer_->Backward(pair_split_layer_top_vec_, pair_split_propagate_down, pair_split_layer_bottom_vec_);
+    vector<bool> pair_split_propagate_down(1, true);
+    pair_split_layer_->Backward(pair_split_layer_top_vec_, pair_split_propagate_down, pair_split_layer_bottom_vec_);
+  }
 //  std::cout<<"back pair split  finished"<<std::endl;
   vector<bool> pairwise_propagate_down(1, true);
   pairwise_layer_->Backward(pairwise_layer_top_vec_, pairwise_propagate_down, pairwise_layer_bottom_vec_);
@@ -14,13 +14,18 @@
  *
  *             For more information about CRF-RNN, please visit the project website http://crfasrnn.torr.vision.
  */
+#include <algorithm>
 #include <vector>
 #include <math.h>
+#include <boost/bind.hpp>
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layers/loss_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/crf_layers/pairwise_function_freeform_layer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -28,59 +33,81 @@
 
 namespace caffe {
 template <typename Dtype>
-bool PairwiseFunctionFreeformLayer<Dtype>::LoadParamFromFile(shared_ptr<vector<vector<Dtype> > > matrix,
-                                                     int H, int W, std::string filename)
+bool PairwiseFunctionFreeformLayer<Dtype>::LoadParam(const std::string& param_dir,
+                                                     const std::string& name,
+                                                     shared_ptr<Blob<Dtype> > blob)
 {
-    vector<vector<Dtype> > * matrix_data = matrix.get();
-    matrix_data->resize(H);
-    std::ifstream param_fstream;
-    param_fstream.open(filename.c_str(), std::ifstream::in);
-    int loadedN=0;
-
-    for(int i=0; i<H; i++)
+    string binary_file_name = param_dir + "/" + name + ".binaryproto";
+    if(std::ifstream(binary_file_name.c_str()).good())
     {
-        vector<Dtype> temprow;
-        temprow.resize(W);
-        for(int j=0; j<W; j++)
+        if(LoadParamFromBinaryFile(binary_file_name, blob))
         {
-            if( !param_fstream.good()) break;
-            Dtype a;
-            param_fstream >> a;
-            temprow[j] = a;
-            loadedN++;
+            LOG(INFO)<<"initialized "<<name<<" with "<<binary_file_name;
+            return true;
         }
-        (*matrix_data)[i] = temprow;
+        LOG(INFO)<<"LoadParamFromBinaryFile failed "<<binary_file_name;
+        return false;
     }
-    param_fstream.close();
-    return H*W == loadedN;
+    string file_name = param_dir + "/" + name + ".txt";
+    if(LoadParamFromFile(file_name, blob))
+    {
+        LOG(INFO)<<"initialized "<<name<<" with "<<file_name;
+        return true;
+    }
+    LOG(INFO)<<"LoadParamFromFile failed "<<file_name;
+    return false;
 }
-    
+
 template <typename Dtype>
-bool PairwiseFunctionFreeformLayer<Dtype>::CopyParamToBlob(shared_ptr<vector<vector<Dtype> > > matrix,
-                                                   shared_ptr<Blob<Dtype> > blob)
+bool PairwiseFunctionFreeformLayer<Dtype>::LoadParamFromBinaryFile(const std::string& filename,
+                                                                   shared_ptr<Blob<Dtype> > blob)
 {
-    vector<vector<Dtype> > * matrix_data = matrix.get();
-    int H = matrix_data->size();
-    int W = (*matrix_data)[0].size();
-    int blob_size = blob->count();
+    BlobProto proto;
+    if(!ReadProtoFromBinaryFile(filename, &proto))
+    {
+        return false;
+    }
+    // only the element count has to match: the weights of a 1x1 convolution
+    // may be stored as a plain (output, input) matrix
+    const int count = blob->count();
     Dtype * blob_data = blob->mutable_cpu_data();
-    if(H*W == blob_size)
+    if(proto.double_data_size() == count)
     {
-        int idx = 0;
-        for(int i=0; i<H; i++)
+        for(int i=0; i<count; i++)
         {
-            for(int j=0; j<W; j++)
-            {
-                blob_data[idx] = (* matrix_data)[i][j];
-                idx++;
-            }
+            blob_data[i] = proto.double_data(i);
+        }
+        return true;
+    }
+    if(proto.data_size() == count)
+    {
+        for(int i=0; i<count; i++)
+        {
+            blob_data[i] = proto.data(i);
         }
         return true;
     }
-    else
+    return false;
+}
+
+template <typename Dtype>
+bool PairwiseFunctionFreeformLayer<Dtype>::LoadParamFromFile(const std::string& filename,
+                                                             shared_ptr<Blob<Dtype> > blob)
+{
+    std::ifstream param_fstream(filename.c_str(), std::ifstream::in);
+    const int count = blob->count();
+    vector<Dtype> values(count);
+    int loadedN=0;
+    while(loadedN < count && param_fstream >> values[loadedN])
+    {
+        loadedN++;
+    }
+    if(loadedN != count)
     {
         return false;
     }
+    caffe_copy(count, &values[0], blob->mutable_cpu_data());
+    return true;
 }
     
 template <typename Dtype>
@@ -112,6 +139,9 @@ void PairwiseFunctionFreeformLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>
     string param_dir = this->layer_param_.multi_stage_crf_param().pairwise_potential_net_param_path();
 
     layerN_ = inner_layer_size_.size()-1;
+    negative_slope_ = Dtype(0.01);
+    use_fused_ = this->phase_ == TEST ||
+                 this->layer_param_.multi_stage_crf_param().fix_param();
     LOG(INFO) << ("PairwiseFunctionLayer entered ")<< layerN_;
     conv_out_blobs_.resize(layerN_);
     conv_layers_.resize(layerN_);
@@ -156,38 +186,15 @@ void PairwiseFunctionFreeformLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>
         LOG(INFO) << ("param_dir ")<< param_dir;
         if(param_dir.length() > 0)
         {
-            shared_ptr<Blob<Dtype> > w_blob = conv_layers_[i]->blobs()[0];
-            shared_ptr<Blob<Dtype> > b_blob = conv_layers_[i]->blobs()[1];
-            
             std::ostringstream ss;
             ss << i;
-            string w_file_name = param_dir + "/w" + ss.str() + ".txt";
-            shared_ptr<vector<vector<Dtype> > > w_buffer(new vector<vector<Dtype> >);
-            if(LoadParamFromFile(w_buffer, output_n, input_n, w_file_name))
-            {
-                if(CopyParamToBlob(w_buffer, w_blob))
-                {
-                    LOG(INFO)<<"initialized weight with "<<w_file_name;
-                }
-            }
-            else{
-                LOG(INFO)<<"LoadParamFromFile  failed "<<w_file_name;
-            }
-            
-            string b_file_name = param_dir + "/b" + ss.str() + ".txt";
-            shared_ptr<vector<vector<Dtype> > > b_buffer(new vector<vector<Dtype> >);
-            if(LoadParamFromFile(b_buffer, output_n, 1, b_file_name))
-            {
-                if(CopyParamToBlob(b_buffer, b_blob))
-                {
-                    LOG(INFO)<<"initialized bias with "<<b_file_name;
-                }
-            }
+            LoadParam(param_dir, "w" + ss.str(), conv_layers_[i]->blobs()[0]);
+            LoadParam(param_dir, "b" + ss.str(), conv_layers_[i]->blobs()[1]);
         }
         LOG(INFO) << ("ConvolutionLayer created ")<< i;
         //  relu layers
         LayerParameter relu_param;
-        relu_param.mutable_relu_param()->set_negative_slope(0.01);
+        relu_param.mutable_relu_param()->set_negative_slope(negative_slope_);
         relu_layers_[i].reset(new ReLULayer<Dtype>(relu_param));
         vector<Blob<Dtype> *> temp_relu_bottom_vec_;
         vector<Blob<Dtype> *> temp_relu_top_vec_;
@@ -221,6 +228,110 @@ void PairwiseFunctionFreeformLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& b
     }
 
 }
+template <typename Dtype>
+void PairwiseFunctionFreeformLayer<Dtype>::PackWeights()
+{
+    // Repacked on every call: it is tiny next to the per-pair work, and the
+    // weights may be replaced after SetUp (e.g. by CopyTrainedLayersFrom).
+    packed_offsets_.resize(layerN_ + 1);
+    packed_offsets_[0] = 0;
+    for(int l=0; l<layerN_; l++)
+    {
+        packed_offsets_[l+1] = packed_offsets_[l] +
+            (inner_layer_size_[l] + 1) * inner_layer_size_[l+1];
+    }
+    packed_params_.resize(packed_offsets_[layerN_]);
+    for(int l=0; l<layerN_; l++)
+    {
+        const int weight_count = inner_layer_size_[l] * inner_layer_size_[l+1];
+        Dtype * packed = &packed_params_[packed_offsets_[l]];
+        caffe_copy(weight_count, conv_layers_[l]->blobs()[0]->cpu_data(), packed);
+        caffe_copy(inner_layer_size_[l+1], conv_layers_[l]->blobs()[1]->cpu_data(),
+                   packed + weight_count);
+    }
+}
+
+template <typename Dtype>
+void PairwiseFunctionFreeformLayer<Dtype>::FusedForwardRange(const Dtype* bottom_data,
+                                                             Dtype* top_data, int spatial_dim,
+                                                             int begin, int end)
+{
+    // Pairs are processed in tiles of kTile neighbouring positions; the
+    // activations of a tile are laid out unit x kTile so that the inner loop
+    // over the tile vectorizes.
+    const int kTile = 16;
+    const int channels = inner_layer_size_[0];
+    const int max_size = *std::max_element(inner_layer_size_.begin(), inner_layer_size_.end());
+    vector<Dtype> act_in(max_size * kTile, Dtype(0));
+    vector<Dtype> act_out(max_size * kTile, Dtype(0));
+    for(int p = begin; p < end; )
+    {
+        const int n = p / spatial_dim;
+        const int s = p % spatial_dim;
+        const int len = std::min(kTile, std::min(spatial_dim - s, end - p));
+        const Dtype * in = bottom_data + n * channels * spatial_dim + s;
+        for(int c=0; c<channels; c++)
+        {
+            for(int t=0; t<len; t++)
+            {
+                act_in[c * kTile + t] = in[c * spatial_dim + t];
+            }
+        }
+        for(int l=0; l<layerN_; l++)
+        {
+            const int input_n = inner_layer_size_[l];
+            const int output_n = inner_layer_size_[l+1];
+            const Dtype * weight = &packed_params_[packed_offsets_[l]];
+            const Dtype * bias = weight + input_n * output_n;
+            for(int o=0; o<output_n; o++)
+            {
+                Dtype * y = &act_out[o * kTile];
+                for(int t=0; t<kTile; t++)
+                {
+                    y[t] = bias[o];
+                }
+                for(int i=0; i<input_n; i++)
+                {
+                    const Dtype w = weight[o * input_n + i];
+                    const Dtype * x = &act_in[i * kTile];
+                    for(int t=0; t<kTile; t++)
+                    {
+                        y[t] += w * x[t];
+                    }
+                }
+                for(int t=0; t<kTile; t++)
+                {
+                    y[t] = std::max(y[t], Dtype(0)) + negative_slope_ * std::min(y[t], Dtype(0));
+                }
+            }
+            act_in.swap(act_out);
+        }
+        Dtype * out = top_data + n * spatial_dim + s;
+        for(int t=0; t<len; t++)
+        {
+            out[t] = act_in[t];
+        }
+        p += len;
+    }
+}
+
+template <typename Dtype>
+void PairwiseFunctionFreeformLayer<Dtype>::FusedForward_cpu(const Blob<Dtype>* bottom,
+                                                            Blob<Dtype>* top)
+{
+    PackWeights();
+    const Dtype * bottom_data = bottom->cpu_data();
+    Dtype * top_data = top->mutable_cpu_data();
+    const int spatial_dim = bottom->count(2);
+    const int total = bottom->num() * spatial_dim;
+    // hand the pairs to the thread pool, keeping enough work per task to pay
+    // for scheduling it
+    const int kMinPairsPerTask = 4096;
+    parallel_for(0, total, kMinPairsPerTask,
+                 boost::bind(&PairwiseFunctionFreeformLayer<Dtype>::FusedForwardRange,
+                             this, bottom_data, top_data, spatial_dim, _1, _2));
+}
+
 template <typename Dtype>
 void PairwiseFunctionFreeformLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                                const vector<Blob<Dtype>*>& top)
@@ -228,6 +339,11 @@ void PairwiseFunctionFreeformLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*
 //    Blob<Dtype> * bias2 = conv_layers_[2]->blobs()[1].get();
 //    std::cout<<"b2 "<< bias2->cpu_data()[0] << " "<<bias2->cpu_diff()[0] <<std::endl;
     
+    if(use_fused_)
+    {
+        FusedForward_cpu(bottom[0], top[0]);
+        return;
+    }
     conv_bottom_vec_[0][0] = bottom[0];
     relu_top_vec_[layerN_-1][0]=top[0];
 
@@ -4,6 +4,7 @@
 
 #include "caffe/crf_layers/softmax_weighted_loss_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/softmax.hpp"
 
 namespace caffe {
     
@@ -91,8 +92,11 @@ namespace caffe {
     template <typename Dtype>
     void SoftmaxWithWeightedLossLayer<Dtype>::Forward_cpu(
                                                   const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-        // The forward pass computes the softmax prob values.
-        softmax_layer_->Forward(softmax_bottom_vec_, softmax_top_vec_);
+        // The forward pass computes the softmax prob values, with the fused
+        // kernel rather than through the Softmax layer.
+        caffe_cpu_softmax(outer_num_, bottom[0]->shape(softmax_axis_),
+                          inner_num_, bottom[0]->cpu_data(),
+                          prob_.mutable_cpu_data());
         const Dtype* prob_data = prob_.cpu_data();
         const Dtype* label = bottom[1]->cpu_data();
         const Dtype* weight = bottom[2]->cpu_data();
@@ -8,12 +8,17 @@
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/layers/quantized_conv_layer.hpp"
+#include "caffe/layers/quantized_inner_product_layer.hpp"
 #include "caffe/layers/relu_layer.hpp"
 #include "caffe/layers/sigmoid_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #ifdef USE_CUDNN
@@ -33,12 +38,56 @@
 
 namespace caffe {
 
+// The output channels per group up to which AUTO prefers direct loops to
+// im2col and matrix multiplication.
+const int kDirectConvolutionMaxOutputs = 16;
+
+// Pick the CPU convolution engine for the filter shape.
+static ConvolutionParameter_Engine GetAutoConvolutionEngine(
+    const ConvolutionParameter& conv_param) {
+  bool winograd = conv_param.group() == 1;
+  if (conv_param.has_kernel_h() || conv_param.has_kernel_w()) {
+    winograd &= conv_param.kernel_h() == 3 && conv_param.kernel_w() == 3;
+  } else {
+    winograd &= conv_param.kernel_size_size() > 0;
+    for (int i = 0; i < conv_param.kernel_size_size(); ++i) {
+      winograd &= conv_param.kernel_size(i) == 3;
+    }
+  }
+  if (conv_param.has_stride_h() || conv_param.has_stride_w()) {
+    winograd &= conv_param.stride_h() == 1 && conv_param.stride_w() == 1;
+  }
+  for (int i = 0; i < conv_param.stride_size(); ++i) {
+    winograd &= conv_param.stride(i) == 1;
+  }
+  for (int i = 0; i < conv_param.dilation_size(); ++i) {
+    winograd &= conv_param.dilation(i) == 1;
+  }
+  if (winograd) {
+    return ConvolutionParameter_Engine_WINOGRAD;
+  }
+  if (conv_param.num_output() <=
+      kDirectConvolutionMaxOutputs * conv_param.group()) {
+    return ConvolutionParameter_Engine_DIRECT;
+  }
+  return ConvolutionParameter_Engine_CAFFE;
+}
+
 // Get convolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetConvolutionLayer(
     const LayerParameter& param) {
   ConvolutionParameter conv_param = param.convolution_param();
   ConvolutionParameter_Engine engine = conv_param.engine();
+  if (engine == ConvolutionParameter_Engine_AUTO) {
+    engine = GetAutoConvolutionEngine(conv_param);
+  }
+  // Quantization replaces any CPU engine.
+  if (param.has_quantization_param() &&
+      engine != ConvolutionParameter_Engine_CUDNN) {
+    return shared_ptr<Layer<Dtype> >(
+        new QuantizedConvolutionLayer<Dtype>(param));
+  }
 #ifdef USE_CUDNN
   bool use_dilation = false;
   for (int i = 0; i < conv_param.dilation_size(); ++i) {
@@ -49,6 +98,12 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 #endif
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
     engine = ConvolutionParameter_Engine_CAFFE;
+    // Grouped convolutions with few outputs per group, depthwise ones in
+    // particular, would take one tiny GEMM per group and image.
+    if (conv_param.group() > 1 && conv_param.num_output() <=
+        kDirectConvolutionMaxOutputs * conv_param.group()) {
+      engine = ConvolutionParameter_Engine_DIRECT;
+    }
 #ifdef USE_CUDNN
     if (!use_dilation) {
       engine = ConvolutionParameter_Engine_CUDNN;
@@ -57,6 +112,11 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
     return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_WINOGRAD) {
+    return shared_ptr<Layer<Dtype> >(
+        new WinogradConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_DIRECT) {
+    return shared_ptr<Layer<Dtype> >(new DirectConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     if (use_dilation) {
@@ -72,6 +132,18 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 
 REGISTER_LAYER_CREATOR(Convolution, GetConvolutionLayer);
 
+// Get inner product layer according to quantization.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetInnerProductLayer(const LayerParameter& param) {
+  if (param.has_quantization_param()) {
+    return shared_ptr<Layer<Dtype> >(
+        new QuantizedInnerProductLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new InnerProductLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(InnerProduct, GetInnerProductLayer);
+
 // Get pooling layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
@@ -3,6 +3,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -238,7 +239,32 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       col_buffer_shape_.push_back(output_shape_[i]);
     }
   }
-  col_buffer_.Reshape(col_buffer_shape_);
+  // On the CPU, a 2D convolution can instead unroll as many images as fit
+  // in its memory budget, for fewer and larger GEMMs.
+  col_batch_size_ = 1;
+  const size_t batch_col_buffer_bytes = static_cast<size_t>(
+      this->layer_param_.convolution_param().batch_col_buffer_mb()) << 20;
+  if (batch_col_buffer_bytes > 0 && Caffe::mode() == Caffe::CPU &&
+      !reverse_dimensions() && !force_nd_im2col_ && num_spatial_axes_ == 2) {
+    const size_t image_bytes = sizeof(Dtype) * conv_out_spatial_dim_ *
+        (kernel_dim_ * group_ + conv_out_channels_);
+    col_batch_size_ = std::max(1, static_cast<int>(std::min(
+        static_cast<size_t>(num_), batch_col_buffer_bytes / image_bytes)));
+  }
+  if (col_batch_size_ > 1) {
+    vector<int> batch_col_buffer_shape(1, kernel_dim_ * group_);
+    batch_col_buffer_shape.push_back(col_batch_size_ * conv_out_spatial_dim_);
+    col_buffer_.Reshape(batch_col_buffer_shape);
+    vector<int> batch_output_shape(1, conv_out_channels_);
+    batch_output_shape.push_back(col_batch_size_ * conv_out_spatial_dim_);
+    batch_output_buffer_.Reshape(batch_output_shape);
+  } else {
+    col_buffer_.Reshape(col_buffer_shape_);
+  }
+  // col_buffer_ stays unallocated when the scratch comes from a workspace.
+  if (workspace_ && (!is_1x1_ || col_batch_size_ > 1)) {
+    workspace_->Reserve(col_buffer_.count());
+  }
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
@@ -253,15 +279,67 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+const uint16_t* BaseConvolutionLayer<Dtype>::half_weights(
+    const Dtype* weights) {
+  if (half_weights_.empty()) {
+    half_weights_.resize(weight_offset_ * group_);
+    caffe_cpu_to_half(weight_storage_, half_weights_.size(), weights,
+                      &half_weights_[0]);
+  }
+  return &half_weights_[0];
+}
+
+template <typename Dtype>
+const SparseMatrix<Dtype>* BaseConvolutionLayer<Dtype>::sparse_weights(
+    const Dtype* weights) {
+  if (sparse_min_sparsity_ <= 0) {
+    return NULL;
+  }
+  if (!sparse_checked_) {
+    sparse_checked_ = true;
+    sparse_weights_.resize(group_);
+    int nnz = 0;
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_to_sparse(conv_out_channels_ / group_, kernel_dim_,
+          weights + weight_offset_ * g, Dtype(sparse_threshold_),
+          &sparse_weights_[g]);
+      nnz += sparse_weights_[g].nnz();
+    }
+    if (1 - double(nnz) / (weight_offset_ * group_) < sparse_min_sparsity_) {
+      sparse_weights_.clear();
+    }
+  }
+  return sparse_weights_.empty() ? NULL : &sparse_weights_[0];
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      conv_im2col_cpu(input, col_buffer()->mutable_cpu_data());
     }
-    col_buff = col_buffer_.cpu_data();
+    col_buff = col_buffer()->cpu_data();
+  }
+  const SparseMatrix<Dtype>* sparse_weights = this->sparse_weights(weights);
+  if (sparse_weights) {
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_sparse_gemm(sparse_weights[g], conv_out_spatial_dim_,
+          col_buff + col_offset_ * g, output + output_offset_ * g);
+    }
+    return;
+  }
+  if (weight_storage_ != FULL_PRECISION) {
+    const uint16_t* half_weights = this->half_weights(weights);
+    for (int g = 0; g < group_; ++g) {
+      caffe_cpu_half_gemm(weight_storage_, conv_out_channels_ / group_,
+          conv_out_spatial_dim_, kernel_dim_,
+          half_weights + weight_offset_ * g, col_buff + col_offset_ * g,
+          output + output_offset_ * g);
+    }
+    return;
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -282,9 +360,9 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  Dtype* col_buff = input;
+  if (!is_1x1_) {
+    col_buff = col_buffer()->mutable_cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -302,8 +380,8 @@ void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+    conv_im2col_cpu(input, col_buffer()->mutable_cpu_data());
+    col_buff = col_buffer()->cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -320,6 +398,124 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
       input, bias_multiplier_.cpu_data(), 1., bias);
 }
 
+// Copies num blocks of rows x size elements into rows blocks of num x size,
+// so that row r of every image lands in row r of a rows x (num * size)
+// matrix.
+template <typename Dtype>
+static void interleave_images(const Dtype* images, int num, int rows,
+    int size, Dtype* matrix) {
+  for (int n = 0; n < num; ++n) {
+    for (int r = 0; r < rows; ++r) {
+      caffe_copy(size, images + (n * rows + r) * size,
+          matrix + (r * num + n) * size);
+    }
+  }
+}
+
+// The inverse of interleave_images.
+template <typename Dtype>
+static void deinterleave_images(const Dtype* matrix, int num, int rows,
+    int size, Dtype* images) {
+  for (int n = 0; n < num; ++n) {
+    for (int r = 0; r < rows; ++r) {
+      caffe_copy(size, matrix + (r * num + n) * size,
+          images + (n * rows + r) * size);
+    }
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::conv_im2col_batch_cpu(const Dtype* data,
+    int num, Dtype* col_buff) {
+  for (int n = 0; n < num; ++n) {
+    im2col_strided_cpu(data + n * bottom_dim_, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        num * conv_out_spatial_dim_, col_buff + n * conv_out_spatial_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    const Dtype* weights, Dtype* output, int num) {
+  CHECK_LE(num, col_batch_size_);
+  Dtype* col_buff = col_buffer()->mutable_cpu_data();
+  Dtype* output_buff = batch_output_buffer_.mutable_cpu_data();
+  conv_im2col_batch_cpu(input, num, col_buff);
+  const SparseMatrix<Dtype>* sparse_weights = this->sparse_weights(weights);
+  for (int g = 0; g < group_; ++g) {
+    if (sparse_weights) {
+      caffe_cpu_sparse_gemm(sparse_weights[g], num * conv_out_spatial_dim_,
+          col_buff + col_offset_ * num * g,
+          output_buff + output_offset_ * num * g);
+      continue;
+    }
+    if (weight_storage_ != FULL_PRECISION) {
+      caffe_cpu_half_gemm(weight_storage_, conv_out_channels_ / group_,
+          num * conv_out_spatial_dim_, kernel_dim_,
+          half_weights(weights) + weight_offset_ * g,
+          col_buff + col_offset_ * num * g,
+          output_buff + output_offset_ * num * g);
+      continue;
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+        group_, num * conv_out_spatial_dim_, kernel_dim_,
+        (Dtype)1., weights + weight_offset_ * g,
+        col_buff + col_offset_ * num * g,
+        (Dtype)0., output_buff + output_offset_ * num * g);
+  }
+  deinterleave_images(output_buff, num, conv_out_channels_,
+      conv_out_spatial_dim_, output);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm_batch(const Dtype* output,
+    const Dtype* weights, Dtype* input, int num) {
+  CHECK_LE(num, col_batch_size_);
+  Dtype* col_buff = col_buffer()->mutable_cpu_data();
+  Dtype* output_buff = batch_output_buffer_.mutable_cpu_data();
+  interleave_images(output, num, conv_out_channels_, conv_out_spatial_dim_,
+      output_buff);
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+        num * conv_out_spatial_dim_, conv_out_channels_ / group_,
+        (Dtype)1., weights + weight_offset_ * g,
+        output_buff + output_offset_ * num * g,
+        (Dtype)0., col_buff + col_offset_ * num * g);
+  }
+  for (int n = 0; n < num; ++n) {
+    col2im_strided_cpu(col_buff + n * conv_out_spatial_dim_,
+        conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        num * conv_out_spatial_dim_, input + n * bottom_dim_);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm_batch(const Dtype* input,
+    const Dtype* output, Dtype* weights, int num) {
+  CHECK_LE(num, col_batch_size_);
+  Dtype* col_buff = col_buffer()->mutable_cpu_data();
+  Dtype* output_buff = batch_output_buffer_.mutable_cpu_data();
+  conv_im2col_batch_cpu(input, num, col_buff);
+  interleave_images(output, num, conv_out_channels_, conv_out_spatial_dim_,
+      output_buff);
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
+        kernel_dim_, num * conv_out_spatial_dim_,
+        (Dtype)1., output_buff + output_offset_ * num * g,
+        col_buff + col_offset_ * num * g,
+        (Dtype)1., weights + weight_offset_ * g);
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -328,9 +524,9 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
+      conv_im2col_gpu(input, col_buffer()->mutable_gpu_data());
     }
-    col_buff = col_buffer_.gpu_data();
+    col_buff = col_buffer()->gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -351,9 +547,9 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_gpu_data();
-  if (is_1x1_) {
-    col_buff = input;
+  Dtype* col_buff = input;
+  if (!is_1x1_) {
+    col_buff = col_buffer()->mutable_gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
@@ -371,8 +567,8 @@ void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
-    col_buff = col_buffer_.gpu_data();
+    conv_im2col_gpu(input, col_buffer()->mutable_gpu_data());
+    col_buff = col_buffer()->gpu_data();
   }
   for (int g = 0; g < group_; ++g) {
     caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
@@ -79,6 +80,26 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
 
+  if (bottom[0]->layout() == NHWC) {
+    CHECK(use_global_stats_) << "NHWC BatchNorm needs the global statistics.";
+    const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
+        0 : 1 / this->blobs_[2]->cpu_data()[0];
+    Dtype* mean = mean_.mutable_cpu_data();
+    Dtype* stddev = variance_.mutable_cpu_data();
+    for (int c = 0; c < channels_; ++c) {
+      mean[c] = scale_factor * this->blobs_[0]->cpu_data()[c];
+      stddev[c] = std::sqrt(
+          scale_factor * this->blobs_[1]->cpu_data()[c] + eps_);
+    }
+    for (int i = 0; i < num * spatial_dim; ++i) {
+      for (int c = 0; c < channels_; ++c) {
+        top_data[i * channels_ + c] =
+            (bottom_data[i * channels_ + c] - mean[c]) / stddev[c];
+      }
+    }
+    return;
+  }
+
   if (bottom[0] != top[0]) {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
@@ -157,6 +178,7 @@ template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK_EQ(bottom[0]->layout(), NCHW) << "NHWC BatchNorm only runs forward.";
   const Dtype* top_diff;
   if (bottom[0] != top[0]) {
     top_diff = top[0]->cpu_diff();
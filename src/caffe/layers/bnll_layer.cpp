@@ -1,11 +1,14 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/bnll_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
-const float kBNLL_THRESHOLD = 50.;
+// Elements whose exponentials are taken at once, in buffers on the stack.
+const int kBNLLBlock = 256;
 
 template <typename Dtype>
 void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -13,10 +16,28 @@ void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
+  // log(1 + exp(x)) = max(x, 0) + log(1 + exp(-|x|)).
+  Dtype e[kBNLLBlock];
+  Dtype log_1pe[kBNLLBlock];
+  for (int begin = 0; begin < count; begin += kBNLLBlock) {
+    const int n = std::min(kBNLLBlock, count - begin);
+    const Dtype* x = bottom_data + begin;
+    for (int i = 0; i < n; ++i) {
+      e[i] = -std::abs(x[i]);
+    }
+    caffe_exp(n, e, e);
+    for (int i = 0; i < n; ++i) {
+      log_1pe[i] = 1 + e[i];
+    }
+    caffe_log(n, log_1pe, log_1pe);
+    Dtype* y = top_data + begin;
+    for (int i = 0; i < n; ++i) {
+      // Where 1 + e rounds, log(1 + e) = e log(u) / (u - 1) keeps the
+      // relative precision of log1p.
+      const Dtype u = 1 + e[i];
+      const Dtype log1p = u == 1 ? e[i] : log_1pe[i] * e[i] / (u - 1);
+      y[i] = std::max(x[i], Dtype(0)) + log1p;
+    }
   }
 }
 
@@ -29,10 +50,14 @@ void BNLLLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype expval;
-    for (int i = 0; i < count; ++i) {
-      expval = exp(std::min(bottom_data[i], Dtype(kBNLL_THRESHOLD)));
-      bottom_diff[i] = top_diff[i] * expval / (expval + 1.);
+    // The derivative is sigmoid(x).
+    Dtype sigmoid[kBNLLBlock];
+    for (int begin = 0; begin < count; begin += kBNLLBlock) {
+      const int n = std::min(kBNLLBlock, count - begin);
+      caffe_sigmoid(n, bottom_data + begin, sigmoid);
+      for (int i = 0; i < n; ++i) {
+        bottom_diff[begin + i] = top_diff[begin + i] * sigmoid[i];
+      }
     }
   }
 }
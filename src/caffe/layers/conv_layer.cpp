@@ -1,9 +1,138 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Positions per task of NHWC 1 x 1 convolutions.
+const int kNHWCPointwiseBlock = 64;
+
+// C += A B for row-major A (M x K), B (K x N) and C (M x N) whose rows are
+// lda, ldb and ldc apart.
+template <typename Dtype>
+static void gemm_strided(const int M, const int N, const int K,
+    const Dtype* A, const int lda, const Dtype* B, const int ldb, Dtype* C,
+    const int ldc);
+
+template <>
+void gemm_strided<float>(const int M, const int N, const int K,
+    const float* A, const int lda, const float* B, const int ldb, float* C,
+    const int ldc) {
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, M, N, K, 1.f, A,
+              lda, B, ldb, 1.f, C, ldc);
+}
+
+template <>
+void gemm_strided<double>(const int M, const int N, const int K,
+    const double* A, const int lda, const double* B, const int ldb,
+    double* C, const int ldc) {
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, M, N, K, 1., A,
+              lda, B, ldb, 1., C, ldc);
+}
+
+// The geometry of an NHWC convolution, and its blobs.
+template <typename Dtype>
+struct NHWCConvolution {
+  int height, width, channels;
+  int out_height, out_width, num_output;
+  int kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w;
+  int dilation_h, dilation_w;
+  int group;
+  const Dtype* bottom;
+  const Dtype* weight;
+  const Dtype* bias;  // NULL without a bias term
+  Dtype* top;
+
+  // Sets count outputs of num_output channels to the bias.
+  void init(const int count, Dtype* output) const {
+    for (int i = 0; i < count; ++i) {
+      if (bias) {
+        std::copy(bias, bias + num_output, output + i * num_output);
+      } else {
+        std::fill(output + i * num_output, output + (i + 1) * num_output,
+                  Dtype(0));
+      }
+    }
+  }
+
+  // Adds the product of count input positions, rows lda apart, with the
+  // weights of kernel tap to count outputs.
+  void multiply(const int count, const Dtype* input, const int lda,
+      const int tap, Dtype* output) const {
+    const int group_channels = channels / group;
+    const int group_outputs = num_output / group;
+    const Dtype* tap_weight = weight + tap * group_channels * num_output;
+    for (int g = 0; g < group; ++g) {
+      gemm_strided(count, group_outputs, group_channels,
+          input + g * group_channels, lda, tap_weight + g * group_outputs,
+          num_output, output + g * group_outputs, num_output);
+    }
+  }
+};
+
+// Computes the rows of output positions [begin, end) of all the images.
+template <typename Dtype>
+struct NHWCConvolutionRows {
+  NHWCConvolution<Dtype> conv;
+
+  void operator()(int begin, int end) const {
+    for (int row = begin; row < end; ++row) {
+      const int n = row / conv.out_height;
+      const int oh = row % conv.out_height;
+      Dtype* top_row = conv.top + row * conv.out_width * conv.num_output;
+      conv.init(conv.out_width, top_row);
+      for (int kh = 0; kh < conv.kernel_h; ++kh) {
+        const int ih = oh * conv.stride_h - conv.pad_h + kh * conv.dilation_h;
+        if (ih < 0 || ih >= conv.height) {
+          continue;
+        }
+        for (int kw = 0; kw < conv.kernel_w; ++kw) {
+          // Input column iw = ow * stride_w - offset lies in the image for
+          // ow in [ow_begin, ow_end).
+          const int offset = conv.pad_w - kw * conv.dilation_w;
+          const int last = conv.width - 1 + offset;
+          if (last < 0) {
+            continue;
+          }
+          const int ow_begin =
+              offset > 0 ? (offset + conv.stride_w - 1) / conv.stride_w : 0;
+          const int ow_end = std::min(conv.out_width, last / conv.stride_w + 1);
+          if (ow_begin >= ow_end) {
+            continue;
+          }
+          const Dtype* input = conv.bottom + ((n * conv.height + ih) *
+              conv.width + ow_begin * conv.stride_w - offset) * conv.channels;
+          conv.multiply(ow_end - ow_begin, input,
+              conv.stride_w * conv.channels, kh * conv.kernel_w + kw,
+              top_row + ow_begin * conv.num_output);
+        }
+      }
+    }
+  }
+};
+
+// Computes blocks of positions of a 1 x 1 convolution at stride 1 without
+// padding, where input and output positions match.
+template <typename Dtype>
+struct NHWCPointwiseBlocks {
+  NHWCConvolution<Dtype> conv;
+  int positions;
+
+  void operator()(int begin, int end) const {
+    for (int block = begin; block < end; ++block) {
+      const int p = block * kNHWCPointwiseBlock;
+      const int count = std::min(kNHWCPointwiseBlock, positions - p);
+      Dtype* output = conv.top + p * conv.num_output;
+      conv.init(count, output);
+      conv.multiply(count, conv.bottom + p * conv.channels, conv.channels, 0,
+                    output);
+    }
+  }
+};
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::compute_output_shape() {
   const int* kernel_shape_data = this->kernel_shape_.cpu_data();
@@ -21,20 +150,59 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  BaseConvolutionLayer<Dtype>::Reshape(bottom, top);
+  nhwc_ = bottom[0]->layout() == NHWC;
+  CHECK(!nhwc_ || this->num_spatial_axes_ == 2)
+      << "NHWC convolutions need 2 spatial axes.";
+  for (int i = 0; i < bottom.size(); ++i) {
+    CHECK_EQ(bottom[i]->layout(), bottom[0]->layout())
+        << "All inputs must have the same layout.";
+    top[i]->set_layout(bottom[0]->layout());
+  }
+  if (epilogue_) {
+    CHECK_EQ(top.size(), 1) << "An epilogue needs a single top.";
+    epilogue_->Reshape(*top[0]);
+  }
+}
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (nhwc_) {
+    for (int i = 0; i < bottom.size(); ++i) {
+      Dtype* top_data = top[i]->mutable_cpu_data();
+      forward_cpu_nhwc(bottom[i]->cpu_data(), weight, top_data);
+      if (epilogue_) {
+        epilogue_->Forward_cpu(0, top[i]->count(), top_data);
+      }
+    }
+    return;
+  }
+  const int batch_size = this->col_batch_size_;
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
+      if (batch_size == 1) {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      } else if (n % batch_size == 0) {
+        this->forward_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+            weight, top_data + n * this->top_dim_,
+            std::min(batch_size, this->num_ - n));
+      }
       if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
+      if (epilogue_) {
+        epilogue_->Forward_cpu(n * this->top_dim_, this->top_dim_,
+                               top_data + n * this->top_dim_);
+      }
     }
   }
 }
@@ -42,9 +210,14 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!nhwc_) << "NHWC convolutions only run forward.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
+    if (epilogue_) {
+      // top holds the epilogue's output; turn its diff in place.
+      epilogue_->Backward_cpu(top[i]);
+    }
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
@@ -55,7 +228,19 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
       }
     }
-    if (this->param_propagate_down_[0] || propagate_down[i]) {
+    if (this->col_batch_size_ > 1) {
+      for (int n = 0; n < this->num_; n += this->col_batch_size_) {
+        const int num = std::min(this->col_batch_size_, this->num_ - n);
+        if (this->param_propagate_down_[0]) {
+          this->weight_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+              top_diff + n * this->top_dim_, weight_diff, num);
+        }
+        if (propagate_down[i]) {
+          this->backward_cpu_gemm_batch(top_diff + n * this->top_dim_, weight,
+              bottom_diff + n * this->bottom_dim_, num);
+        }
+      }
+    } else if (this->param_propagate_down_[0] || propagate_down[i]) {
       for (int n = 0; n < this->num_; ++n) {
         // gradient w.r.t. weight. Note that we will accumulate diffs.
         if (this->param_propagate_down_[0]) {
@@ -72,6 +257,65 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::forward_cpu_nhwc(const Dtype* bottom,
+    const Dtype* weight, Dtype* top) {
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const int taps = kernel_shape[0] * kernel_shape[1];
+  const int group_channels = this->channels_ / this->group_;
+  // Reorder the weights, num_output x channels / group x taps, every time
+  // as they may have changed.
+  vector<int> weight_shape(3);
+  weight_shape[0] = taps;
+  weight_shape[1] = group_channels;
+  weight_shape[2] = this->num_output_;
+  nhwc_weights_.Reshape(weight_shape);
+  Dtype* nhwc_weight = nhwc_weights_.mutable_cpu_data();
+  for (int o = 0; o < this->num_output_; ++o) {
+    for (int c = 0; c < group_channels; ++c) {
+      for (int t = 0; t < taps; ++t) {
+        nhwc_weight[(t * group_channels + c) * this->num_output_ + o] =
+            weight[(o * group_channels + c) * taps + t];
+      }
+    }
+  }
+  NHWCConvolution<Dtype> conv;
+  conv.height = this->input_shape(1);
+  conv.width = this->input_shape(2);
+  conv.channels = this->channels_;
+  conv.out_height = this->output_shape_[0];
+  conv.out_width = this->output_shape_[1];
+  conv.num_output = this->num_output_;
+  conv.kernel_h = kernel_shape[0];
+  conv.kernel_w = kernel_shape[1];
+  conv.stride_h = stride[0];
+  conv.stride_w = stride[1];
+  conv.pad_h = pad[0];
+  conv.pad_w = pad[1];
+  conv.dilation_h = dilation[0];
+  conv.dilation_w = dilation[1];
+  conv.group = this->group_;
+  conv.bottom = bottom;
+  conv.weight = nhwc_weight;
+  conv.bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  conv.top = top;
+  if (taps == 1 && stride[0] == 1 && stride[1] == 1 && pad[0] == 0 &&
+      pad[1] == 0) {
+    NHWCPointwiseBlocks<Dtype> body;
+    body.conv = conv;
+    body.positions = this->num_ * conv.height * conv.width;
+    parallel_for(0, (body.positions + kNHWCPointwiseBlock - 1) /
+                 kNHWCPointwiseBlock, 1, body);
+  } else {
+    NHWCConvolutionRows<Dtype> body;
+    body.conv = conv;
+    parallel_for(0, this->num_ * conv.out_height, 1, body);
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(ConvolutionLayer);
 #endif
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// The outputs [*begin, *end) along one axis whose input under filter tap k
+// lies inside the image, so that the inner loops need no bounds checks.
+static inline void valid_outputs(int k, int pad, int stride, int dilation,
+    int size, int out_size, int* begin, int* end) {
+  const int offset = k * dilation - pad;
+  *begin = offset >= 0 ? 0 : (stride - 1 - offset) / stride;
+  *end = size - 1 - offset < 0 ? 0 :
+      std::min(out_size, (size - 1 - offset) / stride + 1);
+  *begin = std::min(*begin, *end);
+}
+
+// The multiply-adds a chunk of parallel work should hold at least.
+const int kDirectConvGrain = 32768;
+
+// out[i] += w * in[i * stride] for i in [0, n), split on the stride so that
+// the common stride 1 vectorizes.
+template <typename Dtype>
+static inline void axpy_row(int n, Dtype w, const Dtype* in, int stride,
+    Dtype* out) {
+  if (stride == 1) {
+    for (int i = 0; i < n; ++i) {
+      out[i] += w * in[i];
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      out[i] += w * in[i * stride];
+    }
+  }
+}
+
+// out[i * stride] += w * in[i] for i in [0, n).
+template <typename Dtype>
+static inline void scatter_row(int n, Dtype w, const Dtype* in, int stride,
+    Dtype* out) {
+  if (stride == 1) {
+    for (int i = 0; i < n; ++i) {
+      out[i] += w * in[i];
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      out[i * stride] += w * in[i];
+    }
+  }
+}
+
+// The sum of a[i] * b[i * stride] for i in [0, n).
+template <typename Dtype>
+static inline Dtype dot_row(int n, const Dtype* a, const Dtype* b,
+    int stride) {
+  Dtype sum = 0;
+  if (stride == 1) {
+    for (int i = 0; i < n; ++i) {
+      sum += a[i] * b[i];
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      sum += a[i] * b[i * stride];
+    }
+  }
+  return sum;
+}
+
+// Computes the output channels [begin, end) of the batch, counted over the
+// images and then their channels, starting from the bias if any.
+template <typename Dtype>
+struct DirectConvForward {
+  const DirectConvShape* shape;
+  const Dtype* input;
+  const Dtype* weight;
+  const Dtype* bias;
+  Dtype* output;
+
+  void operator()(int begin, int end) const {
+    const DirectConvShape& s = *shape;
+    const int in_dim = s.height * s.width;
+    const int out_dim = s.out_height * s.out_width;
+    const int kernel_dim = s.kernel_h * s.kernel_w;
+    const int outputs = s.groups * s.out_channels;
+    for (int t = begin; t < end; ++t) {
+      const int n = t / outputs;
+      const int o = t % outputs;
+      const Dtype* group_input = input + (n * s.groups * s.channels
+          + o / s.out_channels * s.channels) * in_dim;
+      Dtype* out = output + t * out_dim;
+      caffe_set(out_dim, bias ? bias[o] : Dtype(0), out);
+      for (int c = 0; c < s.channels; ++c) {
+        const Dtype* in = group_input + c * in_dim;
+        const Dtype* filter = weight + (o * s.channels + c) * kernel_dim;
+        for (int kh = 0; kh < s.kernel_h; ++kh) {
+          int oh_begin, oh_end;
+          valid_outputs(kh, s.pad_h, s.stride_h, s.dilation_h, s.height,
+              s.out_height, &oh_begin, &oh_end);
+          for (int kw = 0; kw < s.kernel_w; ++kw) {
+            int ow_begin, ow_end;
+            valid_outputs(kw, s.pad_w, s.stride_w, s.dilation_w, s.width,
+                s.out_width, &ow_begin, &ow_end);
+            const Dtype w = filter[kh * s.kernel_w + kw];
+            const int w_offset = kw * s.dilation_w - s.pad_w;
+            for (int oh = oh_begin; oh < oh_end; ++oh) {
+              const Dtype* in_row = in + (oh * s.stride_h + kh * s.dilation_h
+                  - s.pad_h) * s.width + w_offset;
+              Dtype* out_row = out + oh * s.out_width;
+              axpy_row(ow_end - ow_begin, w, in_row + ow_begin * s.stride_w,
+                  s.stride_w, out_row + ow_begin);
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+// Computes the gradient of the input channels [begin, end) of the batch,
+// counted over the images and then their channels.
+template <typename Dtype>
+struct DirectConvBackwardData {
+  const DirectConvShape* shape;
+  const Dtype* output_diff;
+  const Dtype* weight;
+  Dtype* input_diff;
+
+  void operator()(int begin, int end) const {
+    const DirectConvShape& s = *shape;
+    const int in_dim = s.height * s.width;
+    const int out_dim = s.out_height * s.out_width;
+    const int kernel_dim = s.kernel_h * s.kernel_w;
+    const int inputs = s.groups * s.channels;
+    for (int t = begin; t < end; ++t) {
+      const int n = t / inputs;
+      const int group = t % inputs / s.channels;
+      const int group_c = t % s.channels;
+      Dtype* in = input_diff + t * in_dim;
+      caffe_set(in_dim, Dtype(0), in);
+      for (int o = group * s.out_channels; o < (group + 1) * s.out_channels;
+           ++o) {
+        const Dtype* out = output_diff
+            + (n * s.groups * s.out_channels + o) * out_dim;
+        const Dtype* filter = weight + (o * s.channels + group_c) * kernel_dim;
+        for (int kh = 0; kh < s.kernel_h; ++kh) {
+          int oh_begin, oh_end;
+          valid_outputs(kh, s.pad_h, s.stride_h, s.dilation_h, s.height,
+              s.out_height, &oh_begin, &oh_end);
+          for (int kw = 0; kw < s.kernel_w; ++kw) {
+            int ow_begin, ow_end;
+            valid_outputs(kw, s.pad_w, s.stride_w, s.dilation_w, s.width,
+                s.out_width, &ow_begin, &ow_end);
+            const Dtype w = filter[kh * s.kernel_w + kw];
+            const int w_offset = kw * s.dilation_w - s.pad_w;
+            for (int oh = oh_begin; oh < oh_end; ++oh) {
+              Dtype* in_row = in + (oh * s.stride_h + kh * s.dilation_h
+                  - s.pad_h) * s.width + w_offset;
+              const Dtype* out_row = out + oh * s.out_width;
+              scatter_row(ow_end - ow_begin, w, out_row + ow_begin,
+                  s.stride_w, in_row + ow_begin * s.stride_w);
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+// Accumulates the weight gradient of the output channels [begin, end) over
+// the num images of the batch, one image after the other.
+template <typename Dtype>
+struct DirectConvBackwardWeight {
+  const DirectConvShape* shape;
+  int num;
+  const Dtype* input;
+  const Dtype* output_diff;
+  Dtype* weight_diff;
+
+  void operator()(int begin, int end) const {
+    const DirectConvShape& s = *shape;
+    const int in_dim = s.height * s.width;
+    const int out_dim = s.out_height * s.out_width;
+    const int kernel_dim = s.kernel_h * s.kernel_w;
+    const int input_dim = s.groups * s.channels * in_dim;
+    const int output_dim = s.groups * s.out_channels * out_dim;
+    for (int n = 0; n < num; ++n) {
+      for (int o = begin; o < end; ++o) {
+        const Dtype* group_input = input + n * input_dim
+            + o / s.out_channels * s.channels * in_dim;
+        const Dtype* out = output_diff + n * output_dim + o * out_dim;
+        for (int c = 0; c < s.channels; ++c) {
+          const Dtype* in = group_input + c * in_dim;
+          Dtype* filter_diff = weight_diff + (o * s.channels + c) * kernel_dim;
+          for (int kh = 0; kh < s.kernel_h; ++kh) {
+            int oh_begin, oh_end;
+            valid_outputs(kh, s.pad_h, s.stride_h, s.dilation_h, s.height,
+                s.out_height, &oh_begin, &oh_end);
+            for (int kw = 0; kw < s.kernel_w; ++kw) {
+              int ow_begin, ow_end;
+              valid_outputs(kw, s.pad_w, s.stride_w, s.dilation_w, s.width,
+                  s.out_width, &ow_begin, &ow_end);
+              const int w_offset = kw * s.dilation_w - s.pad_w;
+              Dtype sum = 0;
+              for (int oh = oh_begin; oh < oh_end; ++oh) {
+                const Dtype* in_row = in + (oh * s.stride_h
+                    + kh * s.dilation_h - s.pad_h) * s.width + w_offset;
+                const Dtype* out_row = out + oh * s.out_width;
+                sum += dot_row(ow_end - ow_begin, out_row + ow_begin,
+                    in_row + ow_begin * s.stride_w, s.stride_w);
+              }
+              filter_diff[kh * s.kernel_w + kw] += sum;
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Reshape(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  direct_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  if (!direct_) {
+    return;
+  }
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* pad_data = this->pad_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  shape_.groups = this->group_;
+  shape_.channels = this->channels_ / this->group_;
+  shape_.height = this->input_shape(1);
+  shape_.width = this->input_shape(2);
+  shape_.out_channels = this->num_output_ / this->group_;
+  shape_.out_height = this->output_shape_[0];
+  shape_.out_width = this->output_shape_[1];
+  shape_.kernel_h = kernel_shape_data[0];
+  shape_.kernel_w = kernel_shape_data[1];
+  shape_.pad_h = pad_data[0];
+  shape_.pad_w = pad_data[1];
+  shape_.stride_h = stride_data[0];
+  shape_.stride_w = stride_data[1];
+  shape_.dilation_h = dilation_data[0];
+  shape_.dilation_w = dilation_data[1];
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!direct_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  const int work = shape_.channels * shape_.kernel_h * shape_.kernel_w
+      * this->top_dim_ / this->num_output_;
+  for (int i = 0; i < bottom.size(); ++i) {
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    const DirectConvForward<Dtype> forward = { &shape_, bottom[i]->cpu_data(),
+        weight, bias, top_data };
+    parallel_for(0, this->num_ * this->num_output_,
+                 kDirectConvGrain / std::max(work, 1) + 1, forward);
+    if (this->epilogue_) {
+      this->epilogue_->Forward_cpu(0, top[i]->count(), top_data);
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Backward_cpu(
+      const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {
+  if (!direct_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  const int work = shape_.channels * shape_.kernel_h * shape_.kernel_w
+      * this->top_dim_ / this->num_output_;
+  for (int i = 0; i < top.size(); ++i) {
+    if (this->epilogue_) {
+      // top holds the epilogue's output; turn its diff in place.
+      this->epilogue_->Backward_cpu(top[i]);
+    }
+    const Dtype* top_diff = top[i]->cpu_diff();
+    // Bias gradient, if necessary.
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+      for (int n = 0; n < this->num_; ++n) {
+        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+      }
+    }
+    // gradient w.r.t. weight. Note that we will accumulate diffs.
+    if (this->param_propagate_down_[0]) {
+      const DirectConvBackwardWeight<Dtype> backward_weight = { &shape_,
+          this->num_, bottom[i]->cpu_data(), top_diff, weight_diff };
+      parallel_for(0, this->num_output_,
+                   kDirectConvGrain / std::max(work * this->num_, 1) + 1,
+                   backward_weight);
+    }
+    // gradient w.r.t. bottom data, if necessary.
+    if (propagate_down[i]) {
+      const DirectConvBackwardData<Dtype> backward_data = { &shape_,
+          top_diff, weight, bottom[i]->mutable_cpu_diff() };
+      const int data_work = work * shape_.out_channels / shape_.channels;
+      parallel_for(0, this->num_ * this->channels_,
+                   kDirectConvGrain / std::max(data_work, 1) + 1,
+                   backward_data);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(DirectConvolutionLayer);
+
+}  // namespace caffe
@@ -34,6 +34,8 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK(bottom[i]->shape() == bottom[0]->shape())<<" i shape"<<
       bottom[i]->shape()[0]<<" "<<bottom[i]->shape()[1]<<" "<<bottom[i]->shape()[2]<<" "<<bottom[i]->shape()[3]<<" 0 shape"<<
       bottom[0]->shape()[0]<<" "<<bottom[0]->shape()[1]<<" "<<bottom[0]->shape()[2]<<" "<<bottom[0]->shape()[3];
+    CHECK_EQ(bottom[i]->layout(), bottom[0]->layout())
+        << "All inputs need the same layout.";
   }
   top[0]->ReshapeLike(*bottom[0]);
   // If max operation, we will initialize the vector index part.
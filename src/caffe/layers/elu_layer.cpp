@@ -2,9 +2,13 @@
 #include <vector>
 
 #include "caffe/layers/elu_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// Elements whose exponentials are taken at once, in a buffer on the stack.
+const int kELUBlock = 256;
+
 template <typename Dtype>
 void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,9 +16,18 @@ void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype alpha = this->layer_param_.elu_param().alpha();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
+  Dtype exp_negative[kELUBlock];
+  for (int begin = 0; begin < count; begin += kELUBlock) {
+    const int n = std::min(kELUBlock, count - begin);
+    const Dtype* x = bottom_data + begin;
+    for (int i = 0; i < n; ++i) {
+      exp_negative[i] = std::min(x[i], Dtype(0));
+    }
+    caffe_exp(n, exp_negative, exp_negative);
+    Dtype* y = top_data + begin;
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::max(x[i], Dtype(0)) + alpha * (exp_negative[i] - Dtype(1));
+    }
   }
 }
 
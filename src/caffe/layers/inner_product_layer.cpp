@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -78,6 +79,9 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     bias_multiplier_.Reshape(bias_shape);
     caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
   }
+  if (epilogue_) {
+    epilogue_->Reshape(*top[0]);
+  }
 }
 
 template <typename Dtype>
@@ -86,20 +90,67 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (sparse_min_sparsity_ > 0 && !sparse_checked_) {
+    sparse_checked_ = true;
+    vector<Dtype> transposed;
+    if (transpose_) {
+      transposed.resize(N_ * K_);
+      for (int k = 0; k < K_; ++k) {
+        for (int n = 0; n < N_; ++n) {
+          transposed[n * K_ + k] = weight[k * N_ + n];
+        }
+      }
+    }
+    caffe_cpu_to_sparse(N_, K_, transpose_ ? &transposed[0] : weight,
+                        Dtype(sparse_threshold_), &sparse_weights_);
+    if (sparse_weights_.sparsity() < sparse_min_sparsity_) {
+      sparse_weights_ = SparseMatrix<Dtype>();
+    }
+  }
+  if (sparse_weights_.rows > 0) {
+    caffe_cpu_sparse_gemm_trans(M_, bottom_data, sparse_weights_, top_data);
+  } else if (weight_storage_ != FULL_PRECISION) {
+    if (half_weights_.empty()) {
+      half_weights_.resize(N_ * K_);
+      if (transpose_) {
+        vector<Dtype> transposed(N_ * K_);
+        for (int k = 0; k < K_; ++k) {
+          for (int n = 0; n < N_; ++n) {
+            transposed[n * K_ + k] = weight[k * N_ + n];
+          }
+        }
+        caffe_cpu_to_half(weight_storage_, N_ * K_, &transposed[0],
+                          &half_weights_[0]);
+      } else {
+        caffe_cpu_to_half(weight_storage_, N_ * K_, weight,
+                          &half_weights_[0]);
+      }
+    }
+    caffe_cpu_gemm_half_trans(weight_storage_, M_, N_, K_, bottom_data,
+                              &half_weights_[0], top_data);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans,
+        transpose_ ? CblasNoTrans : CblasTrans, M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
         this->blobs_[1]->cpu_data(), (Dtype)1., top_data);
   }
+  if (epilogue_) {
+    epilogue_->Forward_cpu(0, M_ * N_, top_data);
+  }
 }
 
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  if (epilogue_) {
+    // top holds the epilogue's output; turn its diff in place.
+    epilogue_->Backward_cpu(top[0]);
+  }
   if (this->param_propagate_down_[0]) {
     const Dtype* top_diff = top[0]->cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
@@ -145,6 +196,5 @@ STUB_GPU(InnerProductLayer);
 #endif
 
 INSTANTIATE_CLASS(InnerProductLayer);
-REGISTER_LAYER_CLASS(InnerProduct);
 
 }  // namespace caffe
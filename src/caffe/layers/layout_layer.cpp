@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/layout_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Side of the square blocks transposed at once, so that both the rows read
+// and the rows written stay in cache.
+const int kLayoutBlock = 32;
+
+// Transposes num matrices of rows x cols into cols x rows, one block of rows
+// of one matrix per task.
+template <typename Dtype>
+struct TransposeBlocks {
+  int rows;
+  int cols;
+  int row_blocks;
+  const Dtype* x;
+  Dtype* y;
+
+  void operator()(int begin, int end) const {
+    for (int t = begin; t < end; ++t) {
+      const int offset = t / row_blocks * rows * cols;
+      const Dtype* x_n = x + offset;
+      Dtype* y_n = y + offset;
+      const int r_begin = t % row_blocks * kLayoutBlock;
+      const int r_end = std::min(r_begin + kLayoutBlock, rows);
+      for (int c_begin = 0; c_begin < cols; c_begin += kLayoutBlock) {
+        const int c_end = std::min(c_begin + kLayoutBlock, cols);
+        for (int r = r_begin; r < r_end; ++r) {
+          for (int c = c_begin; c < c_end; ++c) {
+            y_n[c * rows + r] = x_n[r * cols + c];
+          }
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_NE(top[0], bottom[0]) << this->type() << " Layer does not "
+      "allow in-place computation.";
+  CHECK_GE(bottom[0]->num_axes(), 2)
+      << "The input needs a batch and a channel axis.";
+  top[0]->ReshapeLike(*bottom[0]);
+  top[0]->set_layout(this->layer_param_.layout_param().layout());
+  num_ = bottom[0]->shape(0);
+  channels_ = bottom[0]->shape(1);
+  spatial_dim_ = bottom[0]->count(2);
+}
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Convert(BlobLayout from, BlobLayout to,
+    const Dtype* x, Dtype* y) {
+  if (from == to) {
+    caffe_copy(num_ * channels_ * spatial_dim_, x, y);
+    return;
+  }
+  TransposeBlocks<Dtype> body;
+  body.rows = from == NCHW ? channels_ : spatial_dim_;
+  body.cols = from == NCHW ? spatial_dim_ : channels_;
+  body.row_blocks = (body.rows + kLayoutBlock - 1) / kLayoutBlock;
+  body.x = x;
+  body.y = y;
+  parallel_for(0, num_ * body.row_blocks, 1, body);
+}
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  Convert(bottom[0]->layout(), top[0]->layout(), bottom[0]->cpu_data(),
+          top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void LayoutLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) { return; }
+  Convert(top[0]->layout(), bottom[0]->layout(), top[0]->cpu_diff(),
+          bottom[0]->mutable_cpu_diff());
+}
+
+INSTANTIATE_CLASS(LayoutLayer);
+REGISTER_LAYER_CLASS(Layout);
+
+}  // namespace caffe
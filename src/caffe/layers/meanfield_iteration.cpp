@@ -105,6 +105,18 @@ void MeanfieldIteration<Dtype>::PrePass(
   }
 }
 
+template <typename Dtype>
+void MeanfieldIteration<Dtype>::ShareInternalBlobs(const MeanfieldIteration<Dtype>& other) {
+  Blob<Dtype>* const blobs[] = {&spatial_out_blob_, &bilateral_out_blob_, &pairwise_,
+                                &prob_, &message_passing_};
+  const Blob<Dtype>* const other_blobs[] = {&other.spatial_out_blob_, &other.bilateral_out_blob_,
+                                            &other.pairwise_, &other.prob_, &other.message_passing_};
+  for (int i = 0; i < sizeof(blobs) / sizeof(blobs[0]); ++i) {
+    blobs[i]->ShareData(*other_blobs[i]);
+    blobs[i]->ShareDiff(*other_blobs[i]);
+  }
+}
+
 /**
  * Forward pass during the inference.
  */
@@ -33,6 +33,7 @@ void MultiStageMeanfieldLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bot
   const caffe::MultiStageMeanfieldParameter meanfield_param = this->layer_param_.multi_stage_meanfield_param();
 
   num_iterations_ = meanfield_param.num_iterations();
+  checkpoint_iterations_ = meanfield_param.checkpoint_iterations();
 
   CHECK_GT(num_iterations_, 1) << "Number of iterations must be greater than 1.";
 
@@ -150,6 +151,9 @@ void MultiStageMeanfieldLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bot
         (i == num_iterations_ - 1) ? top[0] : iteration_output_blobs_[i].get(), // output blob
         spatial_lattice_, // spatial lattice
         &spatial_norm_); // spatial normalization factors.
+    if (checkpoint_iterations_ && i > 0) {
+      meanfield_iterations_[i]->ShareInternalBlobs(*meanfield_iterations_[0]);
+    }
   }
 
   this->param_propagate_down_.resize(this->blobs_.size(), true);
@@ -228,6 +232,10 @@ void MultiStageMeanfieldLayer<Dtype>::Backward_cpu(
     const vector<Blob<Dtype>*>& bottom) {
 
   for (int i = (num_iterations_ - 1); i >= 0; --i) {
+    // With checkpointing the intermediates only hold the last iteration.
+    if (checkpoint_iterations_ && i < num_iterations_ - 1) {
+      meanfield_iterations_[i]->Forward_cpu();
+    }
     meanfield_iterations_[i]->Backward_cpu();
   }
 
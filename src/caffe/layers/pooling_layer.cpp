@@ -4,12 +4,64 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 using std::min;
 using std::max;
 
+// Pools the rows of output positions [begin, end) of NHWC blobs.
+template <typename Dtype>
+struct NHWCPoolingRows {
+  bool max_pool;
+  int channels, height, width, pooled_height, pooled_width;
+  int kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w;
+  const Dtype* bottom;
+  Dtype* top;
+
+  void operator()(int begin, int end) const {
+    for (int row = begin; row < end; ++row) {
+      const int n = row / pooled_height;
+      const int ph = row % pooled_height;
+      for (int pw = 0; pw < pooled_width; ++pw) {
+        int hstart = ph * stride_h - pad_h;
+        int wstart = pw * stride_w - pad_w;
+        int hend = min(hstart + kernel_h, height + pad_h);
+        int wend = min(wstart + kernel_w, width + pad_w);
+        const int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, height);
+        wend = min(wend, width);
+        Dtype* output = top + (row * pooled_width + pw) * channels;
+        std::fill(output, output + channels,
+                  max_pool ? Dtype(-FLT_MAX) : Dtype(0));
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const Dtype* input =
+                bottom + ((n * height + h) * width + w) * channels;
+            if (max_pool) {
+              for (int c = 0; c < channels; ++c) {
+                output[c] = max(output[c], input[c]);
+              }
+            } else {
+              for (int c = 0; c < channels; ++c) {
+                output[c] += input[c];
+              }
+            }
+          }
+        }
+        if (!max_pool) {
+          for (int c = 0; c < channels; ++c) {
+            output[c] /= pool_size;
+          }
+        }
+      }
+    }
+  }
+};
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -105,6 +157,13 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
   top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_,
       pooled_width_);
+  top[0]->set_layout(bottom[0]->layout());
+  if (bottom[0]->layout() == NHWC) {
+    CHECK_EQ(top.size(), 1) << "NHWC pooling has no mask output.";
+    CHECK(this->layer_param_.pooling_param().pool() !=
+          PoolingParameter_PoolMethod_STOCHASTIC)
+        << "NHWC pooling is MAX or AVE.";
+  }
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
   }
@@ -127,6 +186,10 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (bottom[0]->layout() == NHWC) {
+    Forward_cpu_nhwc(*bottom[0], top[0]);
+    return;
+  }
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int top_count = top[0]->count();
@@ -232,6 +295,7 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  CHECK_EQ(bottom[0]->layout(), NCHW) << "NHWC pooling only runs forward.";
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   // Different pooling methods. We explicitly do the switch outside the for
@@ -306,6 +370,27 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void PoolingLayer<Dtype>::Forward_cpu_nhwc(const Blob<Dtype>& bottom,
+    Blob<Dtype>* top) {
+  NHWCPoolingRows<Dtype> body;
+  body.max_pool = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  body.channels = channels_;
+  body.height = height_;
+  body.width = width_;
+  body.pooled_height = pooled_height_;
+  body.pooled_width = pooled_width_;
+  body.kernel_h = kernel_h_;
+  body.kernel_w = kernel_w_;
+  body.stride_h = stride_h_;
+  body.stride_w = stride_w_;
+  body.pad_h = pad_h_;
+  body.pad_w = pad_w_;
+  body.bottom = bottom.cpu_data();
+  body.top = top->mutable_cpu_data();
+  parallel_for(0, bottom.num() * pooled_height_, 1, body);
+}
 
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
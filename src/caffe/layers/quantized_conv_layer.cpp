@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/quantized_conv_layer.hpp"
+#include "caffe/util/im2col.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Minimum number of outputs per parallel chunk.
+const int kDequantizeGrain = 16384;
+
+// Scales the sums of the output channels [begin, end) of one image back to
+// float and adds the bias.
+template <typename Dtype>
+struct DequantizeChannels {
+  const int32_t* sums;
+  const Dtype* scales;
+  const Dtype* bias;  // NULL without bias term
+  int dim;
+  Dtype* output;
+
+  void operator()(int begin, int end) const {
+    for (int c = begin; c < end; ++c) {
+      const Dtype scale = scales[c];
+      const Dtype offset = bias ? bias[c] : Dtype(0);
+      const int32_t* sum = sums + c * dim;
+      Dtype* out = output + c * dim;
+      for (int i = 0; i < dim; ++i) {
+        out[i] = scale * sum[i] + offset;
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::Reshape(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  quantized_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  if (!quantized_) {
+    return;
+  }
+  const int kernel_dim = this->blobs_[0]->count(1);
+  quantized_weights_.resize(this->blobs_[0]->count());
+  weight_scales_.resize(this->num_output_);
+  quantized_input_.resize(bottom[0]->count());
+  if (!this->is_1x1_) {
+    quantized_col_buffer_.resize(
+        kernel_dim * this->group_ * this->out_spatial_dim_);
+  }
+  sums_.resize(this->top_dim_);
+}
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!quantized_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const int kernel_dim = this->blobs_[0]->count(1);
+  if (!weights_quantized_) {
+    caffe_cpu_quantize_rows(this->num_output_, kernel_dim,
+        this->blobs_[0]->cpu_data(), &quantized_weights_[0],
+        &weight_scales_[0]);
+    weights_quantized_ = true;
+  }
+  const int out_channels = this->num_output_ / this->group_;
+  const int spatial_dim = this->out_spatial_dim_;
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* pad = this->pad_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const Dtype input_range =
+      this->layer_param_.quantization_param().input_range();
+  vector<Dtype> scales(this->num_output_);
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    const int count = bottom[i]->count();
+    const Dtype range = input_range > 0 ? input_range :
+        caffe_cpu_amax(count, bottom_data);
+    caffe_cpu_quantize(count, range > 0 ? kInt8Max / range : Dtype(0),
+                       bottom_data, &quantized_input_[0]);
+    for (int c = 0; c < this->num_output_; ++c) {
+      scales[c] = range / kInt8Max * weight_scales_[c];
+    }
+    for (int n = 0; n < this->num_; ++n) {
+      const int8_t* col = &quantized_input_[n * this->bottom_dim_];
+      if (!this->is_1x1_) {
+        im2col_cpu(col, this->channels_,
+            this->input_shape(1), this->input_shape(2),
+            kernel_shape[0], kernel_shape[1], pad[0], pad[1],
+            stride[0], stride[1], dilation[0], dilation[1],
+            &quantized_col_buffer_[0]);
+        col = &quantized_col_buffer_[0];
+      }
+      for (int g = 0; g < this->group_; ++g) {
+        caffe_cpu_gemm_s8(CblasNoTrans, out_channels, spatial_dim, kernel_dim,
+            &quantized_weights_[g * out_channels * kernel_dim],
+            col + g * kernel_dim * spatial_dim,
+            &sums_[g * out_channels * spatial_dim]);
+      }
+      const DequantizeChannels<Dtype> dequantize = { &sums_[0], &scales[0],
+          this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL, spatial_dim,
+          top_data + n * this->top_dim_ };
+      parallel_for(0, this->num_output_,
+          kDequantizeGrain / std::max(spatial_dim, 1) + 1, dequantize);
+      if (this->epilogue_) {
+        this->epilogue_->Forward_cpu(n * this->top_dim_, this->top_dim_,
+                                     top_data + n * this->top_dim_);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void QuantizedConvolutionLayer<Dtype>::Backward_cpu(
+      const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << this->type() << " layer " << this->layer_param_.name()
+      << " is quantized for inference and has no backward pass.";
+}
+
+INSTANTIATE_CLASS(QuantizedConvolutionLayer);
+
+}  // namespace caffe
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/quantized_inner_product_layer.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Minimum number of outputs per parallel chunk.
+const int kDequantizeRowsGrain = 16384;
+
+// Scales the sums of the rows [begin, end) back to float and adds the bias;
+// every column has its own scale.
+template <typename Dtype>
+struct DequantizeRows {
+  const int32_t* sums;
+  const Dtype* scales;
+  const Dtype* bias;  // NULL without bias term
+  int dim;
+  Dtype* output;
+
+  void operator()(int begin, int end) const {
+    for (int m = begin; m < end; ++m) {
+      const int32_t* sum = sums + m * dim;
+      Dtype* out = output + m * dim;
+      for (int i = 0; i < dim; ++i) {
+        out[i] = scales[i] * sum[i] + (bias ? bias[i] : Dtype(0));
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::Reshape(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  InnerProductLayer<Dtype>::Reshape(bottom, top);
+  quantized_weights_.resize(this->N_ * this->K_);
+  weight_scales_.resize(this->N_);
+  quantized_input_.resize(this->M_ * this->K_);
+  sums_.resize(this->M_ * this->N_);
+}
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int M = this->M_, N = this->N_, K = this->K_;
+  if (!weights_quantized_) {
+    const Dtype* weight = this->blobs_[0]->cpu_data();
+    vector<Dtype> transposed;
+    if (this->transpose_) {
+      transposed.resize(N * K);
+      for (int k = 0; k < K; ++k) {
+        for (int n = 0; n < N; ++n) {
+          transposed[n * K + k] = weight[k * N + n];
+        }
+      }
+      weight = &transposed[0];
+    }
+    caffe_cpu_quantize_rows(N, K, weight, &quantized_weights_[0],
+                            &weight_scales_[0]);
+    weights_quantized_ = true;
+  }
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const Dtype input_range =
+      this->layer_param_.quantization_param().input_range();
+  const Dtype range = input_range > 0 ? input_range :
+      caffe_cpu_amax(M * K, bottom_data);
+  caffe_cpu_quantize(M * K, range > 0 ? kInt8Max / range : Dtype(0),
+                     bottom_data, &quantized_input_[0]);
+  caffe_cpu_gemm_s8(CblasTrans, M, N, K, &quantized_input_[0],
+                    &quantized_weights_[0], &sums_[0]);
+  vector<Dtype> scales(N);
+  for (int n = 0; n < N; ++n) {
+    scales[n] = range / kInt8Max * weight_scales_[n];
+  }
+  const DequantizeRows<Dtype> dequantize = { &sums_[0], &scales[0],
+      this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL, N, top_data };
+  parallel_for(0, M, kDequantizeRowsGrain / std::max(N, 1) + 1, dequantize);
+  if (this->epilogue_) {
+    this->epilogue_->Forward_cpu(0, M * N, top_data);
+  }
+}
+
+template <typename Dtype>
+void QuantizedInnerProductLayer<Dtype>::Backward_cpu(
+      const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << this->type() << " layer " << this->layer_param_.name()
+      << " is quantized for inference and has no backward pass.";
+}
+
+INSTANTIATE_CLASS(QuantizedInnerProductLayer);
+
+}  // namespace caffe
@@ -2,9 +2,42 @@
 #include <vector>
 
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Elements per thread pool task for the element-wise loops below.
+const int kReLUGrain = 32768;
+
+template <typename Dtype>
+struct ReLUForward {
+  const Dtype* bottom_data;
+  Dtype* top_data;
+  Dtype negative_slope;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      top_data[i] = std::max(bottom_data[i], Dtype(0))
+          + negative_slope * std::min(bottom_data[i], Dtype(0));
+    }
+  }
+};
+
+template <typename Dtype>
+struct ReLUBackward {
+  const Dtype* bottom_data;
+  const Dtype* top_diff;
+  Dtype* bottom_diff;
+  Dtype negative_slope;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
+          + negative_slope * (bottom_data[i] <= 0));
+    }
+  }
+};
+
 template <typename Dtype>
 void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,10 +45,8 @@ void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + negative_slope * std::min(bottom_data[i], Dtype(0));
-  }
+  const ReLUForward<Dtype> body = { bottom_data, top_data, negative_slope };
+  parallel_for(0, count, kReLUGrain, body);
 }
 
 template <typename Dtype>
@@ -28,10 +59,9 @@ void ReLULayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-    for (int i = 0; i < count; ++i) {
-      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
-          + negative_slope * (bottom_data[i] <= 0));
-    }
+    const ReLUBackward<Dtype> body =
+        { bottom_data, top_diff, bottom_diff, negative_slope };
+    parallel_for(0, count, kReLUGrain, body);
   }
 }
 
@@ -109,6 +109,23 @@ template <typename Dtype>
 void ScaleLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
+  if (bottom[0]->layout() == NHWC) {
+    // The channels, scaled along axis 1, are the contiguous axis in NHWC;
+    // the bias goes in the same pass.
+    CHECK_EQ(axis_, 1) << "NHWC Scale needs axis 1.";
+    const Dtype* scale_data =
+        ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
+    const Dtype* bias_data = bias_layer_ ?
+        this->blobs_[bias_param_id_]->cpu_data() : NULL;
+    Dtype* top_data = top[0]->mutable_cpu_data();
+    for (int i = 0; i < outer_dim_ * inner_dim_; ++i) {
+      for (int d = 0; d < scale_dim_; ++d) {
+        top_data[i * scale_dim_ + d] = bottom_data[i * scale_dim_ + d] *
+            scale_data[d] + (bias_data ? bias_data[d] : Dtype(0));
+      }
+    }
+    return;
+  }
   if (bottom[0] == top[0]) {
     // In-place computation; need to store bottom data before overwriting it.
     // Note that this is only necessary for Backward; we could skip this if not
@@ -136,6 +153,7 @@ void ScaleLayer<Dtype>::Forward_cpu(
 template <typename Dtype>
 void ScaleLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK_EQ(bottom[0]->layout(), NCHW) << "NHWC Scale only runs forward.";
   if (bias_layer_ &&
       this->param_propagate_down_[this->param_propagate_down_.size() - 1]) {
     bias_layer_->Backward(top, bias_propagate_down_, bias_bottom_vec_);
@@ -1,14 +1,37 @@
-#include <cmath>
 #include <vector>
 
 #include "caffe/layers/sigmoid_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Elements per thread pool task for the element-wise loops below.
+const int kSigmoidGrain = 8192;
+
 template <typename Dtype>
-inline Dtype sigmoid(Dtype x) {
-  return 1. / (1. + exp(-x));
-}
+struct SigmoidForward {
+  const Dtype* bottom_data;
+  Dtype* top_data;
+
+  void operator()(int begin, int end) const {
+    caffe_sigmoid(end - begin, bottom_data + begin, top_data + begin);
+  }
+};
+
+template <typename Dtype>
+struct SigmoidBackward {
+  const Dtype* top_data;
+  const Dtype* top_diff;
+  Dtype* bottom_diff;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype sigmoid_x = top_data[i];
+      bottom_diff[i] = top_diff[i] * sigmoid_x * (1. - sigmoid_x);
+    }
+  }
+};
 
 template <typename Dtype>
 void SigmoidLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -16,9 +39,8 @@ void SigmoidLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = sigmoid(bottom_data[i]);
-  }
+  const SigmoidForward<Dtype> body = { bottom_data, top_data };
+  parallel_for(0, count, kSigmoidGrain, body);
 }
 
 template <typename Dtype>
@@ -30,10 +52,8 @@ void SigmoidLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    for (int i = 0; i < count; ++i) {
-      const Dtype sigmoid_x = top_data[i];
-      bottom_diff[i] = top_diff[i] * sigmoid_x * (1. - sigmoid_x);
-    }
+    const SigmoidBackward<Dtype> body = { top_data, top_diff, bottom_diff };
+    parallel_for(0, count, kSigmoidGrain, body);
   }
 }
 
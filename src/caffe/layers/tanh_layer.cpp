@@ -4,18 +4,46 @@
 #include <vector>
 
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// Elements per thread pool task for the element-wise loops below.
+const int kTanHGrain = 8192;
+
+template <typename Dtype>
+struct TanHForward {
+  const Dtype* bottom_data;
+  Dtype* top_data;
+
+  void operator()(int begin, int end) const {
+    caffe_tanh(end - begin, bottom_data + begin, top_data + begin);
+  }
+};
+
+template <typename Dtype>
+struct TanHBackward {
+  const Dtype* top_data;
+  const Dtype* top_diff;
+  Dtype* bottom_diff;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      const Dtype tanhx = top_data[i];
+      bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
+    }
+  }
+};
+
 template <typename Dtype>
 void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = tanh(bottom_data[i]);
-  }
+  const TanHForward<Dtype> body = { bottom_data, top_data };
+  parallel_for(0, count, kTanHGrain, body);
 }
 
 template <typename Dtype>
@@ -27,11 +55,8 @@ void TanHLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype tanhx;
-    for (int i = 0; i < count; ++i) {
-      tanhx = top_data[i];
-      bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
-    }
+    const TanHBackward<Dtype> body = { top_data, top_diff, bottom_diff };
+    parallel_for(0, count, kTanHGrain, body);
   }
 }
 
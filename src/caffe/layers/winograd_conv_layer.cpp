@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/winograd.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  tile_ = 0;
+  if (this->num_spatial_axes_ != 2 || this->force_nd_im2col_ ||
+      this->group_ != 1) {
+    return;
+  }
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  const int* stride_data = this->stride_.cpu_data();
+  const int* dilation_data = this->dilation_.cpu_data();
+  for (int i = 0; i < 2; ++i) {
+    if (kernel_shape_data[i] != 3 || stride_data[i] != 1 ||
+        dilation_data[i] != 1) {
+      return;
+    }
+  }
+  height_ = this->input_shape(1);
+  width_ = this->input_shape(2);
+  out_height_ = this->output_shape_[0];
+  out_width_ = this->output_shape_[1];
+  // Larger tiles save more multiplies but waste more on partial tiles.
+  tile_ = std::min(out_height_, out_width_) >= 8 ? 4 : 2;
+  const int channels = this->channels_;
+  const int num_output = this->num_output_;
+  transformed_weights_.Reshape(1, 1, 1,
+      winograd_weights_size(tile_, num_output, channels));
+  // Room for both the forward pass and the input gradient.
+  input_buffer_.Reshape(1, 1, 1, std::max(
+      winograd_input_buffer_size(tile_, channels, out_height_, out_width_),
+      winograd_input_buffer_size(tile_, num_output, height_, width_)));
+  output_buffer_.Reshape(1, 1, 1, std::max(
+      winograd_output_buffer_size(tile_, num_output, out_height_, out_width_),
+      winograd_output_buffer_size(tile_, channels, height_, width_)));
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!tile_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const int* pad_data = this->pad_.cpu_data();
+  winograd_transform_weights_cpu(tile_, this->blobs_[0]->cpu_data(),
+      this->num_output_, this->channels_, false,
+      transformed_weights_.mutable_cpu_data());
+  const Dtype* weight = transformed_weights_.cpu_data();
+  Dtype* input_buffer = input_buffer_.mutable_cpu_data();
+  Dtype* output_buffer = output_buffer_.mutable_cpu_data();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      winograd_conv_cpu(tile_, bottom_data + n * this->bottom_dim_,
+          this->channels_, height_, width_, pad_data[0], pad_data[1], weight,
+          this->num_output_, out_height_, out_width_, input_buffer,
+          output_buffer, top_data + n * this->top_dim_);
+      if (this->bias_term_) {
+        const Dtype* bias = this->blobs_[1]->cpu_data();
+        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      }
+      if (this->epilogue_) {
+        this->epilogue_->Forward_cpu(n * this->top_dim_, this->top_dim_,
+                                     top_data + n * this->top_dim_);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Backward_cpu(
+      const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {
+  if (!tile_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  // The input gradient is the convolution of the padded output gradient
+  // with the rotated filters; a padding of 3 or more would need a negative
+  // padding for it.
+  const int* pad_data = this->pad_.cpu_data();
+  const bool winograd_backward = pad_data[0] <= 2 && pad_data[1] <= 2;
+  if (winograd_backward) {
+    winograd_transform_weights_cpu(tile_, this->blobs_[0]->cpu_data(),
+        this->num_output_, this->channels_, true,
+        transformed_weights_.mutable_cpu_data());
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* flipped_weight = transformed_weights_.cpu_data();
+  Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  Dtype* input_buffer = input_buffer_.mutable_cpu_data();
+  Dtype* output_buffer = output_buffer_.mutable_cpu_data();
+  for (int i = 0; i < top.size(); ++i) {
+    if (this->epilogue_) {
+      // top holds the epilogue's output; turn its diff in place.
+      this->epilogue_->Backward_cpu(top[i]);
+    }
+    const Dtype* top_diff = top[i]->cpu_diff();
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+    // Bias gradient, if necessary.
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+      for (int n = 0; n < this->num_; ++n) {
+        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+      }
+    }
+    if (this->param_propagate_down_[0] || propagate_down[i]) {
+      for (int n = 0; n < this->num_; ++n) {
+        // gradient w.r.t. weight. Note that we will accumulate diffs.
+        if (this->param_propagate_down_[0]) {
+          this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
+              top_diff + n * this->top_dim_, weight_diff);
+        }
+        // gradient w.r.t. bottom data, if necessary.
+        if (propagate_down[i] && winograd_backward) {
+          winograd_conv_cpu(tile_, top_diff + n * this->top_dim_,
+              this->num_output_, out_height_, out_width_, 2 - pad_data[0],
+              2 - pad_data[1], flipped_weight, this->channels_, height_,
+              width_, input_buffer, output_buffer,
+              bottom_diff + n * this->bottom_dim_);
+        } else if (propagate_down[i]) {
+          this->backward_cpu_gemm(top_diff + n * this->top_dim_, weight,
+              bottom_diff + n * this->bottom_dim_);
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include <algorithm>
 #include <map>
 #include <set>
@@ -9,14 +11,23 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/inner_product_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/insert_layouts.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
+#ifdef USE_CUDNN
+#include "caffe/layers/cudnn_conv_layer.hpp"
+#endif
+
 #include "caffe/test/test_caffe_main.hpp"
 
 namespace caffe {
@@ -49,6 +60,15 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
+  if (filtered_param.layout() == NHWC) {
+    if (phase_ == TEST && Caffe::mode() == Caffe::CPU) {
+      NetParameter layout_param;
+      InsertLayouts(filtered_param, &layout_param);
+      filtered_param.Swap(&layout_param);
+    } else {
+      LOG(WARNING) << "Blobs are only NHWC at TEST phase on the CPU.";
+    }
+  }
   // Create a copy of filtered_param with splits added where necessary.
   NetParameter param;
   InsertSplits(filtered_param, &param);
@@ -57,6 +77,10 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   map<string, int> blob_name_to_idx;
   set<string> available_blobs;
   memory_used_ = 0;
+  conv_workspace_.reset();
+  if (param.share_conv_workspace()) {
+    conv_workspace_.reset(new Workspace<Dtype>());
+  }
   // For each layer, set up its input and output
   bottom_vecs_.resize(param.layer_size());
   top_vecs_.resize(param.layer_size());
@@ -86,6 +110,11 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       layers_[layer_id]->SetShared(true);
     } else {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+      BaseConvolutionLayer<Dtype>* conv_layer =
+          dynamic_cast<BaseConvolutionLayer<Dtype>*>(layers_.back().get());
+      if (conv_workspace_ && conv_layer) {
+        conv_layer->set_workspace(conv_workspace_);
+      }
     }
     layer_names_.push_back(layer_param.name());
     LOG_IF(INFO, Caffe::root_solver())
@@ -271,10 +300,496 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  fused_into_.assign(layers_.size(), -1);
+  if (param.fuse_epilogues()) {
+    FuseEpilogues();
+  }
+  weight_storage_ = FULL_PRECISION;
+  if (param.weight_storage() != FULL_PRECISION) {
+    if (phase_ == TEST) {
+      weight_storage_ = param.weight_storage();
+      ResetWeightStorage();
+    } else {
+      LOG(WARNING) << "Weights are only stored in 16 bits at TEST phase.";
+    }
+  }
+  sparse_min_sparsity_ = 0;
+  sparse_threshold_ = 0;
+  if (param.sparse_weights() > 0) {
+    if (phase_ == TEST) {
+      sparse_min_sparsity_ = param.sparse_weights();
+      sparse_threshold_ = param.sparse_threshold();
+      ResetWeightStorage();
+    } else {
+      LOG(WARNING) << "Weights are only multiplied sparsely at TEST phase.";
+    }
+  }
   debug_info_ = param.debug_info();
+  concurrent_branches_ = param.concurrent_branches();
+  share_activations_ = param.share_activations();
+  keep_blobs_.assign(param.keep_blob().begin(), param.keep_blob().end());
+  if (share_activations_ && phase_ != TEST) {
+    LOG(WARNING) << "Activations are only shared at TEST phase.";
+    share_activations_ = false;
+  }
+  if (share_activations_ && concurrent_branches_) {
+    LOG(WARNING) << "Concurrent branches need their own activation memory; "
+        << "not sharing activations of " << name_ << ".";
+    share_activations_ = false;
+  }
+  if (share_activations_) {
+    ShareActivations();
+  }
+  if (concurrent_branches_) {
+    InitConcurrentSchedule();
+  }
+  if (conv_workspace_) {
+    LOG_IF(INFO, Caffe::root_solver()) << "Convolution workspace: "
+        << conv_workspace_->high_water_mark() << " bytes per thread";
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+int Net<Dtype>::FindOnlyReader(int layer_id, int blob_id) const {
+  int reader = -1;
+  for (int i = layer_id + 1; i < layers_.size(); ++i) {
+    const vector<int>& bottoms = bottom_id_vecs_[i];
+    const int reads = std::count(bottoms.begin(), bottoms.end(), blob_id);
+    if (reads == 0) { continue; }
+    if (reader >= 0 || reads > 1) { return -1; }
+    reader = i;
+    // Any later reader reads what this one writes in place.
+    const vector<int>& tops = top_id_vecs_[i];
+    if (std::find(tops.begin(), tops.end(), blob_id) != tops.end()) { break; }
+  }
+  return reader;
+}
+
+template <typename Dtype>
+void Net<Dtype>::FuseEpilogues() {
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    Layer<Dtype>* layer = layers_[layer_id].get();
+    ConvolutionLayer<Dtype>* conv_layer = NULL;
+    InnerProductLayer<Dtype>* ip_layer = NULL;
+    if (strcmp(layer->type(), "Convolution") == 0) {
+      conv_layer = dynamic_cast<ConvolutionLayer<Dtype>*>(layer);
+#ifdef USE_CUDNN
+      // cuDNN convolutions run their own kernels.
+      if (dynamic_cast<CuDNNConvolutionLayer<Dtype>*>(layer)) { continue; }
+#endif
+    } else if (strcmp(layer->type(), "InnerProduct") == 0) {
+      ip_layer = dynamic_cast<InnerProductLayer<Dtype>*>(layer);
+    }
+    if ((!conv_layer && !ip_layer) || top_id_vecs_[layer_id].size() != 1 ||
+        layer->loss(0) || fused_into_[layer_id] >= 0) {
+      continue;
+    }
+    shared_ptr<Epilogue<Dtype> > epilogue(new Epilogue<Dtype>());
+    vector<int> fused;
+    int top_id = top_id_vecs_[layer_id][0];
+    int reader = FindOnlyReader(layer_id, top_id);
+    // An Eltwise SUM with a blob that is ready when the layer runs.
+    if (reader >= 0 && strcmp(layers_[reader]->type(), "Eltwise") == 0 &&
+        bottom_id_vecs_[reader].size() == 2 && !layers_[reader]->loss(0)) {
+      const EltwiseParameter& eltwise_param =
+          layers_[reader]->layer_param().eltwise_param();
+      const int index = (bottom_id_vecs_[reader][0] == top_id) ? 0 : 1;
+      const int residual_id = bottom_id_vecs_[reader][1 - index];
+      const int eltwise_top_id = top_id_vecs_[reader][0];
+      bool ready = eltwise_param.operation() == EltwiseParameter_EltwiseOp_SUM
+          && residual_id != eltwise_top_id;
+      for (int i = layer_id + 1; ready && i < reader; ++i) {
+        const vector<int>& tops = top_id_vecs_[i];
+        ready = std::find(tops.begin(), tops.end(), residual_id) == tops.end();
+      }
+      if (ready) {
+        const bool has_coeff = eltwise_param.coeff_size() > 0;
+        const bool propagate_down = bottom_need_backward_[reader][1 - index];
+        epilogue->set_residual(blobs_[residual_id].get(),
+            has_coeff ? eltwise_param.coeff(index) : 1,
+            has_coeff ? eltwise_param.coeff(1 - index) : 1, propagate_down);
+        bottom_id_vecs_[layer_id].push_back(residual_id);
+        bottom_need_backward_[layer_id].push_back(propagate_down);
+        layer_need_backward_[layer_id] =
+            layer_need_backward_[layer_id] || propagate_down;
+        fused.push_back(reader);
+        top_id = eltwise_top_id;
+        reader = FindOnlyReader(reader, top_id);
+      }
+    }
+    if (reader >= 0 && Epilogue<Dtype>::CanFuseActivation(
+        layers_[reader]->layer_param(), layer_need_backward_[reader])) {
+      epilogue->set_activation(layers_[reader]);
+      fused.push_back(reader);
+      top_id = top_id_vecs_[reader][0];
+    }
+    if (fused.empty()) { continue; }
+    for (int i = 0; i < fused.size(); ++i) {
+      fused_into_[fused[i]] = layer_id;
+      layer_need_backward_[fused[i]] = false;
+      bottom_id_vecs_[fused[i]].clear();
+      top_id_vecs_[fused[i]].clear();
+      LOG_IF(INFO, Caffe::root_solver()) << "Fusing "
+          << layer_names_[fused[i]] << " into " << layer_names_[layer_id];
+    }
+    top_vecs_[layer_id][0] = blobs_[top_id].get();
+    top_id_vecs_[layer_id][0] = top_id;
+    if (conv_layer) {
+      conv_layer->set_epilogue(epilogue);
+    } else {
+      ip_layer->set_epilogue(epilogue);
+    }
+    layer->Reshape(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+  }
+}
+
+// Adds to the dependencies of each layer the layers before it in order that
+// access a resource it writes, or that write a resource it reads.
+static void FindDependencies(const vector<int>& order,
+    const vector<vector<int> >& reads, const vector<vector<int> >& writes,
+    int num_resources, vector<vector<int> >* dependencies) {
+  vector<int> last_writer(num_resources, -1);
+  vector<vector<int> > readers(num_resources);
+  for (int i = 0; i < order.size(); ++i) {
+    const int layer_id = order[i];
+    vector<int>& layer_dependencies = (*dependencies)[layer_id];
+    for (int j = 0; j < reads[layer_id].size(); ++j) {
+      const int resource = reads[layer_id][j];
+      if (last_writer[resource] >= 0) {
+        layer_dependencies.push_back(last_writer[resource]);
+      }
+    }
+    for (int j = 0; j < writes[layer_id].size(); ++j) {
+      const int resource = writes[layer_id][j];
+      if (last_writer[resource] >= 0) {
+        layer_dependencies.push_back(last_writer[resource]);
+      }
+      layer_dependencies.insert(layer_dependencies.end(),
+          readers[resource].begin(), readers[resource].end());
+    }
+    std::sort(layer_dependencies.begin(), layer_dependencies.end());
+    layer_dependencies.erase(std::unique(layer_dependencies.begin(),
+        layer_dependencies.end()), layer_dependencies.end());
+    layer_dependencies.erase(std::remove(layer_dependencies.begin(),
+        layer_dependencies.end(), layer_id), layer_dependencies.end());
+    for (int j = 0; j < reads[layer_id].size(); ++j) {
+      readers[reads[layer_id][j]].push_back(layer_id);
+    }
+    for (int j = 0; j < writes[layer_id].size(); ++j) {
+      last_writer[writes[layer_id][j]] = layer_id;
+      readers[writes[layer_id][j]].clear();
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FindMemoryRoots(vector<int>* data_root,
+                                 vector<int>* diff_root) const {
+  // Split tops share the data of their bottom once forwarded, and layers
+  // such as Flatten share data and diff as soon as they are set up.
+  const int num_blobs = blobs_.size();
+  data_root->resize(num_blobs);
+  diff_root->resize(num_blobs);
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    (*data_root)[blob_id] = blob_id;
+    (*diff_root)[blob_id] = blob_id;
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const bool is_split = strcmp(layers_[layer_id]->type(), "Split") == 0;
+    const vector<int>& bottoms = bottom_id_vecs_[layer_id];
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int top_id = top_id_vecs_[layer_id][i];
+      const Blob<Dtype>& top = *blobs_[top_id];
+      for (int j = 0; j < bottoms.size(); ++j) {
+        const Blob<Dtype>& bottom = *blobs_[bottoms[j]];
+        if (bottoms[j] == top_id || !top.count() || !bottom.count()) {
+          continue;
+        }
+        if (is_split || top.data() == bottom.data()) {
+          (*data_root)[top_id] = (*data_root)[bottoms[j]];
+        }
+        if (top.diff() == bottom.diff()) {
+          (*diff_root)[top_id] = (*diff_root)[bottoms[j]];
+        }
+      }
+    }
+  }
+}
+
+// Whether a layer computes each top element from the same element of its
+// bottom only, so that the two may share memory like an in-place layer.
+static bool IsElementwise(const char* type) {
+  const char* kElementwiseTypes[] = { "AbsVal", "BatchNorm", "Bias", "BNLL",
+      "Dropout", "ELU", "Exp", "Log", "Power", "ReLU", "Scale", "Sigmoid",
+      "TanH", "Threshold" };
+  const int num_types =
+      sizeof(kElementwiseTypes) / sizeof(kElementwiseTypes[0]);
+  for (int i = 0; i < num_types; ++i) {
+    if (strcmp(type, kElementwiseTypes[i]) == 0) { return true; }
+  }
+  return false;
+}
+
+// The smallest free buffer holding size bytes, or else the largest free
+// buffer, to be grown; -1 if none is free.
+static int FindFreeBuffer(const vector<size_t>& buffer_sizes,
+    const vector<bool>& buffer_free, size_t size) {
+  int best = -1;
+  for (int i = 0; i < buffer_sizes.size(); ++i) {
+    if (!buffer_free[i]) { continue; }
+    if (best < 0) {
+      best = i;
+      continue;
+    }
+    const bool fits = buffer_sizes[i] >= size;
+    const bool best_fits = buffer_sizes[best] >= size;
+    if (fits != best_fits) {
+      if (fits) { best = i; }
+    } else if (fits ? buffer_sizes[i] < buffer_sizes[best] :
+                      buffer_sizes[i] > buffer_sizes[best]) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareActivations() {
+  const int num_layers = layers_.size();
+  const int num_blobs = blobs_.size();
+  // Only the first blob of a group sharing memory gets a buffer; the others
+  // pick it up again when their layer reshapes or forwards. The groups are
+  // found before any buffer is shared, and kept for later reshapes.
+  if (activation_roots_.empty()) {
+    vector<int> diff_roots;
+    FindMemoryRoots(&activation_roots_, &diff_roots);
+  }
+  const vector<int>& root = activation_roots_;
+  vector<bool> kept(num_blobs, false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    kept[root[net_input_blob_indices_[i]]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    kept[root[net_output_blob_indices_[i]]] = true;
+  }
+  for (int i = 0; i < keep_blobs_.size(); ++i) {
+    CHECK(has_blob(keep_blobs_[i])) << "Unknown blob to keep "
+        << keep_blobs_[i];
+    kept[root[blob_names_index_[keep_blobs_[i]]]] = true;
+  }
+  // The layers between the first write and the last read of each group.
+  vector<int> first_use(num_blobs, -1);
+  vector<int> last_use(num_blobs, -1);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    const vector<int>& bottoms = bottom_id_vecs_[layer_id];
+    const vector<int>& tops = top_id_vecs_[layer_id];
+    for (int i = 0; i < bottoms.size(); ++i) {
+      last_use[root[bottoms[i]]] = layer_id;
+    }
+    for (int i = 0; i < tops.size(); ++i) {
+      const int blob_id = root[tops[i]];
+      if (first_use[blob_id] < 0) { first_use[blob_id] = layer_id; }
+      last_use[blob_id] = layer_id;
+      // Data layers fill or even replace the memory of their tops.
+      if (bottoms.empty()) { kept[blob_id] = true; }
+    }
+  }
+  // Assign buffers in layer order: a top takes over the buffer of a bottom
+  // dying at an element-wise layer, or else the free buffer closest in size.
+  vector<size_t> buffer_sizes;
+  vector<int> buffer_owners;
+  vector<bool> buffer_free;
+  vector<int> buffer_ids(num_blobs, -1);
+  size_t unshared_size = 0;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    const vector<int>& bottoms = bottom_id_vecs_[layer_id];
+    const vector<int>& tops = top_id_vecs_[layer_id];
+    const bool elementwise = IsElementwise(layers_[layer_id]->type());
+    for (int i = 0; i < tops.size(); ++i) {
+      const int blob_id = tops[i];
+      if (root[blob_id] != blob_id || kept[blob_id] ||
+          first_use[blob_id] != layer_id || !blobs_[blob_id]->count()) {
+        continue;
+      }
+      const size_t size = blobs_[blob_id]->count() * sizeof(Dtype);
+      unshared_size += size;
+      int buffer_id = -1;
+      for (int j = 0; elementwise && j < bottoms.size(); ++j) {
+        const int bottom_id = root[bottoms[j]];
+        if (buffer_ids[bottom_id] >= 0 && last_use[bottom_id] == layer_id &&
+            buffer_owners[buffer_ids[bottom_id]] == bottom_id &&
+            blobs_[bottom_id]->count() == blobs_[blob_id]->count()) {
+          buffer_id = buffer_ids[bottom_id];
+          break;
+        }
+      }
+      if (buffer_id < 0) {
+        buffer_id = FindFreeBuffer(buffer_sizes, buffer_free, size);
+      }
+      if (buffer_id < 0) {
+        buffer_id = buffer_sizes.size();
+        buffer_sizes.push_back(0);
+        buffer_owners.push_back(-1);
+        buffer_free.push_back(false);
+      }
+      buffer_sizes[buffer_id] = std::max(buffer_sizes[buffer_id], size);
+      buffer_owners[buffer_id] = blob_id;
+      buffer_free[buffer_id] = false;
+      buffer_ids[blob_id] = buffer_id;
+    }
+    // Release the buffers of the groups last used by this layer.
+    for (int i = 0; i < bottoms.size() + tops.size(); ++i) {
+      const int blob_id = root[i < bottoms.size() ?
+          bottoms[i] : tops[i - bottoms.size()]];
+      const int buffer_id = buffer_ids[blob_id];
+      if (buffer_id >= 0 && last_use[blob_id] == layer_id &&
+          buffer_owners[buffer_id] == blob_id) {
+        buffer_free[buffer_id] = true;
+      }
+    }
+  }
+  vector<shared_ptr<SyncedMemory> > buffers(buffer_sizes.size());
+  size_t shared_size = 0;
+  for (int i = 0; i < buffers.size(); ++i) {
+    buffers[i].reset(new SyncedMemory(buffer_sizes[i]));
+    shared_size += buffer_sizes[i];
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (buffer_ids[blob_id] >= 0) {
+      blobs_[blob_id]->ShareDataMemory(buffers[buffer_ids[blob_id]]);
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Sharing " << unshared_size
+      << " bytes of activations in " << buffers.size() << " buffers of "
+      << shared_size << " bytes.";
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitConcurrentSchedule() {
+  const int num_layers = layers_.size();
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    if (strcmp(layers_[layer_id]->type(), "Python") == 0) {
+      LOG(WARNING) << "Layer " << layer_names_[layer_id] << " runs Python "
+          << "code; running the layers of " << name_ << " one at a time.";
+      concurrent_branches_ = false;
+      return;
+    }
+  }
+  // The resources are, in order: the blobs themselves (their shape and their
+  // memory pointers), the data or diff memory of the blobs, and the learnable
+  // params. Blobs sharing memory with an earlier blob use its resource.
+  const int num_blobs = blobs_.size();
+  const int num_resources = 2 * num_blobs + learnable_params_.size();
+  vector<int> data_root;
+  vector<int> diff_root;
+  FindMemoryRoots(&data_root, &diff_root);
+  // Forward reads the bottoms and writes the tops; params are only written
+  // in TRAIN, where layers such as BatchNorm update running statistics.
+  vector<vector<int> > reads(num_layers);
+  vector<vector<int> > writes(num_layers);
+  vector<int> order;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    const bool is_split = strcmp(layers_[layer_id]->type(), "Split") == 0;
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = bottom_id_vecs_[layer_id][i];
+      reads[layer_id].push_back(blob_id);
+      reads[layer_id].push_back(num_blobs + data_root[blob_id]);
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = top_id_vecs_[layer_id][i];
+      writes[layer_id].push_back(blob_id);
+      if (!is_split) {
+        writes[layer_id].push_back(num_blobs + data_root[blob_id]);
+      }
+    }
+    for (int i = 0; i < param_id_vecs_[layer_id].size(); ++i) {
+      const int resource = 2 * num_blobs +
+          learnable_param_ids_[param_id_vecs_[layer_id][i]];
+      if (phase_ == TRAIN) {
+        writes[layer_id].push_back(resource);
+      } else {
+        reads[layer_id].push_back(resource);
+      }
+    }
+    order.push_back(layer_id);
+  }
+  forward_dependencies_.assign(num_layers, vector<int>());
+  FindDependencies(order, reads, writes, num_resources,
+                   &forward_dependencies_);
+  // Backward, in reverse order, reads the top diffs and writes the bottom
+  // diffs and the param diffs.
+  reads.assign(num_layers, vector<int>());
+  writes.assign(num_layers, vector<int>());
+  order.clear();
+  for (int layer_id = num_layers - 1; layer_id >= 0; --layer_id) {
+    if (!layer_need_backward_[layer_id]) { continue; }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      reads[layer_id].push_back(
+          num_blobs + diff_root[top_id_vecs_[layer_id][i]]);
+    }
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      if (bottom_need_backward_[layer_id][i]) {
+        writes[layer_id].push_back(
+            num_blobs + diff_root[bottom_id_vecs_[layer_id][i]]);
+      }
+    }
+    for (int i = 0; i < param_id_vecs_[layer_id].size(); ++i) {
+      writes[layer_id].push_back(2 * num_blobs +
+          learnable_param_ids_[param_id_vecs_[layer_id][i]]);
+    }
+    order.push_back(layer_id);
+  }
+  backward_dependencies_.assign(num_layers, vector<int>());
+  FindDependencies(order, reads, writes, num_resources,
+                   &backward_dependencies_);
+  layer_losses_.assign(num_layers, Dtype(0));
+}
+
+template <typename Dtype>
+bool Net<Dtype>::RunConcurrently(const vector<int>& layer_ids,
+    const vector<vector<int> >& dependencies, bool forward) {
+  // Other threads start with their own Caffe context, in CPU mode.
+  if (!concurrent_branches_ || Caffe::mode() != Caffe::CPU || debug_info_ ||
+      Caffe::cpu_threads() <= 1 || layer_ids.size() < 2) {
+    return false;
+  }
+  vector<int> nodes(layers_.size(), -1);
+  for (int i = 0; i < layer_ids.size(); ++i) {
+    nodes[layer_ids[i]] = i;
+  }
+  vector<vector<int> > predecessors(layer_ids.size());
+  bool chain = true;
+  for (int i = 0; i < layer_ids.size(); ++i) {
+    const vector<int>& layer_dependencies = dependencies[layer_ids[i]];
+    bool follows_previous = (i == 0);
+    for (int j = 0; j < layer_dependencies.size(); ++j) {
+      const int node = nodes[layer_dependencies[j]];
+      if (node >= 0) {
+        predecessors[i].push_back(node);
+        follows_previous = follows_previous || node == i - 1;
+      }
+    }
+    chain = chain && follows_previous;
+  }
+  if (chain) { return false; }
+  parallel_dag(predecessors,
+      boost::bind(&Net<Dtype>::RunLayer, this, &layer_ids, forward, _1));
+  return true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RunLayer(const vector<int>* layer_ids, bool forward,
+                          int node) {
+  const int i = (*layer_ids)[node];
+  if (forward) {
+    layer_losses_[i] = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+  } else {
+    layers_[i]->Backward(
+        top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -537,7 +1052,23 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
   Dtype loss = 0;
+  if (concurrent_branches_) {
+    vector<int> layer_ids;
+    for (int i = start; i <= end; ++i) {
+      if (fused_into_[i] < 0) {
+        layer_ids.push_back(i);
+      }
+    }
+    if (RunConcurrently(layer_ids, forward_dependencies_, true)) {
+      // Sum in layer order, as below.
+      for (int i = start; i <= end; ++i) {
+        loss += layer_losses_[i];
+      }
+      return loss;
+    }
+  }
   for (int i = start; i <= end; ++i) {
+    if (fused_into_[i] >= 0) { continue; }
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
@@ -582,6 +1113,19 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  CHECK(!share_activations_)
+      << "Backward needs the activations that " << name_ << " shares.";
+  if (concurrent_branches_) {
+    vector<int> layer_ids;
+    for (int i = start; i >= end; --i) {
+      if (layer_need_backward_[i]) {
+        layer_ids.push_back(i);
+      }
+    }
+    if (RunConcurrently(layer_ids, backward_dependencies_, false)) {
+      return;
+    }
+  }
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
       layers_[i]->Backward(
@@ -670,6 +1214,28 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ResetWeightStorage() {
+  if (weight_storage_ == FULL_PRECISION && sparse_min_sparsity_ == 0) {
+    return;
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    Layer<Dtype>* layer = layers_[i].get();
+    if (dynamic_cast<ConvolutionLayer<Dtype>*>(layer)) {
+      ConvolutionLayer<Dtype>* conv =
+          static_cast<ConvolutionLayer<Dtype>*>(layer);
+      conv->set_weight_storage(weight_storage_);
+      conv->set_sparse_weights(sparse_min_sparsity_, sparse_threshold_);
+    } else if (dynamic_cast<InnerProductLayer<Dtype>*>(layer)) {
+      InnerProductLayer<Dtype>* inner_product =
+          static_cast<InnerProductLayer<Dtype>*>(layer);
+      inner_product->set_weight_storage(weight_storage_);
+      inner_product->set_sparse_weights(sparse_min_sparsity_,
+                                        sparse_threshold_);
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   int num_source_layers = other->layers().size();
@@ -700,6 +1266,7 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  ResetWeightStorage();
 }
 
 template <typename Dtype>
@@ -734,7 +1301,12 @@ void Net<Dtype>::Backward() {
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
-    layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    if (fused_into_[i] < 0) {
+      layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    }
+  }
+  if (share_activations_) {
+    ShareActivations();
   }
 }
 
@@ -774,6 +1346,7 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
   }
+  ResetWeightStorage();
 }
 
 template <typename Dtype>
@@ -842,6 +1415,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  ResetWeightStorage();
 }
 
 template <typename Dtype>
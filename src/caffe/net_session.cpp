@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/net_session.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+NetSession<Dtype>::NetSession(const shared_ptr<Net<Dtype> >& net)
+    : net_(net), valid_(false) {
+  CHECK(net_) << "NetSession needs a net.";
+  CHECK(!net_->share_activations())
+      << "NetSession reuses activations, which the net must not share.";
+  const int num_layers = net_->layers().size();
+  source_layers_.resize(num_layers, false);
+  blob_writers_.resize(net_->blobs().size());
+  for (int i = 0; i < num_layers; ++i) {
+    source_layers_[i] = net_->bottom_ids(i).empty() &&
+        strcmp(net_->layers()[i]->type(), "Input") != 0 &&
+        net_->fused_into(i) < 0;
+    const vector<int>& tops = net_->top_ids(i);
+    for (int j = 0; j < tops.size(); ++j) {
+      blob_writers_[tops[j]].push_back(i);
+    }
+  }
+  for (int i = 0; i < net_->num_inputs(); ++i) {
+    input_snapshots_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  marked_blobs_.resize(net_->blobs().size(), false);
+  layer_losses_.resize(num_layers, Dtype(0));
+}
+
+template <typename Dtype>
+void NetSession<Dtype>::MarkChanged(const string& blob_name) {
+  CHECK(net_->has_blob(blob_name)) << "Unknown blob name " << blob_name;
+  const vector<string>& names = net_->blob_names();
+  const int blob_id =
+      std::find(names.begin(), names.end(), blob_name) - names.begin();
+  marked_blobs_[blob_id] = true;
+}
+
+template <typename Dtype>
+void NetSession<Dtype>::FindDirtyLayers(const vector<bool>& changed_blobs,
+    vector<bool>* dirty_layers) const {
+  const int num_layers = net_->layers().size();
+  // Layers forced to run although their bottoms are unchanged: their tops
+  // were overwritten in place by a later layer that had to run.
+  vector<bool> forced(num_layers, false);
+  bool again = true;
+  while (again) {
+    again = false;
+    vector<bool> dirty_blobs(changed_blobs);
+    for (int i = 0; i < num_layers; ++i) {
+      const vector<int>& bottoms = net_->bottom_ids(i);
+      bool dirty = source_layers_[i] || forced[i];
+      for (int j = 0; j < bottoms.size(); ++j) {
+        dirty = dirty || dirty_blobs[bottoms[j]];
+      }
+      (*dirty_layers)[i] = dirty;
+      if (!dirty) { continue; }
+      const vector<int>& tops = net_->top_ids(i);
+      // (blob, layer) pairs whose earlier writers have to run again
+      vector<pair<int, int> > clobbered;
+      for (int j = 0; j < tops.size(); ++j) {
+        if (!dirty_blobs[tops[j]] &&
+            std::find(bottoms.begin(), bottoms.end(), tops[j]) !=
+            bottoms.end()) {
+          clobbered.push_back(std::make_pair(tops[j], i));
+        }
+        dirty_blobs[tops[j]] = true;
+      }
+      while (!clobbered.empty()) {
+        const int blob_id = clobbered.back().first;
+        const int layer_id = clobbered.back().second;
+        clobbered.pop_back();
+        const vector<int>& writers = blob_writers_[blob_id];
+        for (int k = 0; k < writers.size() && writers[k] < layer_id; ++k) {
+          const int writer = writers[k];
+          if (forced[writer]) { continue; }
+          forced[writer] = true;
+          again = true;
+          // Split tops share their data with the bottom.
+          if (strcmp(net_->layers()[writer]->type(), "Split") == 0) {
+            clobbered.push_back(
+                std::make_pair(net_->bottom_ids(writer)[0], writer));
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& NetSession<Dtype>::Forward(Dtype* loss) {
+  vector<bool> changed_blobs(marked_blobs_);
+  const vector<Blob<Dtype>*>& inputs = net_->input_blobs();
+  const vector<int>& input_ids = net_->input_blob_indices();
+  for (int i = 0; i < inputs.size(); ++i) {
+    Blob<Dtype>* snapshot = input_snapshots_[i].get();
+    if (!valid_ || snapshot->shape() != inputs[i]->shape() ||
+        memcmp(snapshot->cpu_data(), inputs[i]->cpu_data(),
+               sizeof(Dtype) * inputs[i]->count()) != 0) {
+      changed_blobs[input_ids[i]] = true;
+      snapshot->CopyFrom(*inputs[i], false, true);
+    }
+  }
+  const int num_layers = net_->layers().size();
+  vector<bool> dirty_layers(num_layers, true);
+  if (valid_) {
+    FindDirtyLayers(changed_blobs, &dirty_layers);
+  }
+  run_layers_.clear();
+  for (int i = 0; i < num_layers; ++i) {
+    if (dirty_layers[i]) {
+      layer_losses_[i] = net_->ForwardFromTo(i, i);
+      run_layers_.push_back(i);
+    }
+  }
+  std::fill(marked_blobs_.begin(), marked_blobs_.end(), false);
+  valid_ = true;
+  if (loss != NULL) {
+    *loss = Dtype(0);
+    for (int i = 0; i < num_layers; ++i) {
+      *loss += layer_losses_[i];
+    }
+  }
+  return net_->output_blobs();
+}
+
+INSTANTIATE_CLASS(NetSession);
+
+}  // namespace caffe
@@ -14,25 +14,34 @@
  *
  *             For more information about CRF-RNN, please visit the project website http://crfasrnn.torr.vision.
  */
+#include <algorithm>
 #include <vector>
 #include <math.h>
+#include <string.h>
+#include <boost/bind.hpp>
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/layers/loss_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/res_block_layers/multi_input_pooling_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <iostream>
 
 namespace caffe {
-    
+
+// elements per pool task, enough to pay for handing the task out
+const int kMinCountPerTask = 65536;
+
 template <typename Dtype>
 void MultiInputPoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                               const vector<Blob<Dtype>*>& top)
 {
     inputN_ = bottom.size();
+    CHECK_LE(inputN_, 256) << "the argmax mask stores the input index in one byte";
     count_ = bottom[0]->count();
     num_ = bottom[0]->num();
     channels_ = bottom[0]->channels();
@@ -44,52 +53,111 @@ template <typename Dtype>
 void MultiInputPoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                                           const vector<Blob<Dtype>*>& top)
 {
-    
-    top[0]->Reshape(num_, channels_, height_, width_);
+    for(int bn=1; bn<inputN_; bn++)
+    {
+        CHECK(bottom[bn]->shape() == bottom[0]->shape())
+            << "All inputs must have the same shape.";
+    }
+    count_ = bottom[0]->count();
+    top[0]->ReshapeLike(*bottom[0]);
+    if(!max_idx_ || max_idx_->size() < count_)
+    {
+        max_idx_.reset(new SyncedMemory(count_ * sizeof(uint8_t)));
+    }
 }
+
 template <typename Dtype>
-void MultiInputPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                               const vector<Blob<Dtype>*>& top)
+void MultiInputPoolingLayer<Dtype>::ForwardRange(const vector<Blob<Dtype>*>& bottom,
+                                                 const vector<Blob<Dtype>*>& top,
+                                                 int begin, int end)
 {
-    for(int i=0;i<count_; i++)
+    // Blocks small enough for top and the mask to stay in L1 while the
+    // inputs stream through; the branch-free inner loop vectorizes.
+    // Ties go to the lowest input index.
+    const int kBlock = 2048;
+    Dtype * top_data = top[0]->mutable_cpu_data();
+    uint8_t * mask = static_cast<uint8_t*>(max_idx_->mutable_cpu_data());
+    for(int b = begin; b < end; b += kBlock)
     {
-        Dtype max_value = -1e8;
-        for(int bn=0; bn<inputN_; bn++)
+        const int len = std::min(kBlock, end - b);
+        Dtype * max_data = top_data + b;
+        uint8_t * max_idx = mask + b;
+        caffe_copy(len, bottom[0]->cpu_data() + b, max_data);
+        memset(max_idx, 0, len * sizeof(uint8_t));
+        for(int bn=1; bn<inputN_; bn++)
         {
-            Dtype temp_value = bottom[bn]->cpu_data()[i];
-            if(temp_value>max_value) max_value = temp_value;
+            const Dtype * data = bottom[bn]->cpu_data() + b;
+            const uint8_t index = static_cast<uint8_t>(bn);
+            for(int i=0; i<len; i++)
+            {
+                const bool greater = data[i] > max_data[i];
+                max_data[i] = greater ? data[i] : max_data[i];
+                max_idx[i] = greater ? index : max_idx[i];
+            }
         }
-        top[0]->mutable_cpu_data()[i] = max_value;
     }
 }
 
+template <typename Dtype>
+void MultiInputPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+                                               const vector<Blob<Dtype>*>& top)
+{
+    // fetch the pointers once so the pool threads only read synced memory
+    for(int bn=0; bn<inputN_; bn++)
+    {
+        bottom[bn]->cpu_data();
+    }
+    top[0]->mutable_cpu_data();
+    max_idx_->mutable_cpu_data();
+    parallel_for(0, count_, kMinCountPerTask,
+                 boost::bind(&MultiInputPoolingLayer<Dtype>::ForwardRange, this,
+                             boost::cref(bottom), boost::cref(top), _1, _2));
+}
+
 template <typename Dtype>
 void MultiInputPoolingLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
                                                const vector<Blob<Dtype>*>& top)
 {
     Forward_cpu(bottom, top);
 }
-    
+
+template <typename Dtype>
+void MultiInputPoolingLayer<Dtype>::BackwardRange(const vector<Blob<Dtype>*>& top,
+                                                  const vector<bool>& propagate_down,
+                                                  const vector<Blob<Dtype>*>& bottom,
+                                                  int begin, int end)
+{
+    // every input gets the top diff where it won and zero elsewhere
+    const Dtype * top_diff = top[0]->cpu_diff() + begin;
+    const uint8_t * max_idx = static_cast<const uint8_t*>(max_idx_->cpu_data()) + begin;
+    const int len = end - begin;
+    for(int bn=0; bn<inputN_; bn++)
+    {
+        if(!propagate_down[bn]) continue;
+        Dtype * bottom_diff = bottom[bn]->mutable_cpu_diff() + begin;
+        const uint8_t index = static_cast<uint8_t>(bn);
+        for(int i=0; i<len; i++)
+        {
+            bottom_diff[i] = (max_idx[i] == index) ? top_diff[i] : Dtype(0);
+        }
+    }
+}
+
 template <typename Dtype>
 void MultiInputPoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                                 const vector<bool>& propagate_down,
                                                 const vector<Blob<Dtype>*>& bottom)
 {
-    if(!propagate_down[0])return;
-    for(int i=0;i<count_; i++)
+    top[0]->cpu_diff();
+    max_idx_->cpu_data();
+    for(int bn=0; bn<inputN_; bn++)
     {
-        Dtype max_value = -1e8;
-        int max_index =0;
-        for(int bn=0; bn<inputN_; bn++)
-        {
-            Dtype temp_value = bottom[bn]->cpu_data()[i];
-            if(temp_value>max_value) {
-                max_value = temp_value;
-                max_index = bn;
-            }
-        }
-        bottom[max_index]->mutable_cpu_diff()[i] = top[0]->cpu_diff()[i];
+        if(propagate_down[bn]) bottom[bn]->mutable_cpu_diff();
     }
+    parallel_for(0, count_, kMinCountPerTask,
+                 boost::bind(&MultiInputPoolingLayer<Dtype>::BackwardRange, this,
+                             boost::cref(top), boost::cref(propagate_down),
+                             boost::cref(bottom), _1, _2));
 }
 
 template <typename Dtype>
@@ -21,6 +21,7 @@
 #include "caffe/layers/loss_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/res_block_layers/res_block_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -36,13 +37,19 @@ void ResidualBlockLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     output_channels_ = conv_param.num_output();
     
     enable_residual_ = this->layer_param_.res_block_param().enable_residual();
+    fused_ = this->layer_param_.res_block_param().fused();
     count_ = bottom[0]->count();
     num_ = bottom[0]->num();
     channels_ = bottom[0]->channels();
     height_ = bottom[0]->height();
     width_ = bottom[0]->width();
     
-    if(enable_residual_)
+    if(enable_residual_ && fused_)
+    {
+        CHECK_EQ(channels_, output_channels_)
+            << "Residual connection needs num_output equal to input channels.";
+    }
+    if(enable_residual_ && !fused_)
     {
         split_out_blobs_.resize(2);
         split_out_blobs_[0].reset(new Blob<Dtype>());
@@ -76,21 +83,37 @@ void ResidualBlockLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     drop_layers_.resize(dropN);
     drop_bottom_vec_.resize(dropN);
     drop_top_vec_.resize(dropN);
+    if(fused_)
+    {
+        workspace_.reset(new Workspace<Dtype>());
+    }
     
     LOG(INFO) << ("create convlolution layers ");
     for(int i=0; i< layerN_; i++)
     {
         conv_out_blobs_[i].reset(new Blob<Dtype>());
-        relu_out_blobs_[i].reset(new Blob<Dtype>());
+        if(!fused_)
+        {
+            relu_out_blobs_[i].reset(new Blob<Dtype>());
+        }
         
         // convolution layers
         vector<Blob<Dtype> *> temp_conv_bottom_vec_;
         vector<Blob<Dtype> *> temp_conv_top_vec_;
         temp_conv_top_vec_.clear();
-        temp_conv_top_vec_.push_back(conv_out_blobs_[i].get());
+        if(fused_ && i==layerN_-1 && !enable_residual_){
+            temp_conv_top_vec_.push_back(top[0]);
+        }
+        else{
+            temp_conv_top_vec_.push_back(conv_out_blobs_[i].get());
+        }
         temp_conv_bottom_vec_.clear();
         if(i==0){
-            temp_conv_bottom_vec_.push_back(enable_residual_ ? split_out_blobs_[1].get() : bottom[0]);
+            temp_conv_bottom_vec_.push_back((enable_residual_ && !fused_) ? split_out_blobs_[1].get() : bottom[0]);
+        }
+        else if(fused_){
+            // ReLU and dropout have already run in place on this blob
+            temp_conv_bottom_vec_.push_back(conv_out_blobs_[i-1].get());
         }
         else{
             if(i%2==1)
@@ -121,7 +144,35 @@ void ResidualBlockLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
         else{
             conv_layers_[i].reset(new ConvolutionLayer<Dtype>(this->layer_param_));
         }
+        if(fused_)
+        {
+            conv_layers_[i]->set_workspace(workspace_);
+        }
         conv_layers_[i]->SetUp(conv_bottom_vec_[i], conv_top_vec_[i]);
+        
+        if(fused_)
+        {
+            // leaky ReLU run by the convolution in place on its output
+            LayerParameter relu_param;
+            relu_param.mutable_relu_param()->set_negative_slope(0.01);
+            shared_ptr<Layer<Dtype> > relu(new ReLULayer<Dtype>(relu_param));
+            relu->SetUp(conv_top_vec_[i], conv_top_vec_[i]);
+            shared_ptr<Epilogue<Dtype> > epilogue(new Epilogue<Dtype>());
+            epilogue->set_activation(relu);
+            conv_layers_[i]->set_epilogue(epilogue);
+            // dropout in place on the rectified output, training only
+            if(i%2==0 && this->phase_ == TRAIN)
+            {
+                drop_top_vec_[i/2].clear();
+                drop_top_vec_[i/2].push_back(conv_out_blobs_[i].get());
+                drop_bottom_vec_[i/2] = drop_top_vec_[i/2];
+                LayerParameter drop_param;
+                drop_param.set_phase(TRAIN);
+                drop_layers_[i/2].reset(new DropoutLayer<Dtype>(drop_param));
+                drop_layers_[i/2]->SetUp(drop_bottom_vec_[i/2], drop_top_vec_[i/2]);
+            }
+            continue;
+        }
       
         //  relu layers
         vector<Blob<Dtype> *> temp_relu_bottom_vec_;
@@ -153,7 +204,7 @@ void ResidualBlockLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
         }
     }
 
-    if(enable_residual_)
+    if(enable_residual_ && !fused_)
     {
         sum_top_vec_.clear();
         sum_top_vec_.push_back(top[0]);
@@ -188,6 +239,23 @@ template <typename Dtype>
 void ResidualBlockLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                                const vector<Blob<Dtype>*>& top)
 {
+    if(fused_)
+    {
+        for(int i=0; i < layerN_; i++)
+        {
+            conv_layers_[i]->Forward(conv_bottom_vec_[i], conv_top_vec_[i]);
+            if(i%2==0 && this->phase_ == TRAIN)
+            {
+                drop_layers_[i/2]->Forward(drop_bottom_vec_[i/2], drop_top_vec_[i/2]);
+            }
+        }
+        if(enable_residual_)
+        {
+            caffe_add(top[0]->count(), bottom[0]->cpu_data(),
+                      conv_out_blobs_[layerN_-1]->cpu_data(), top[0]->mutable_cpu_data());
+        }
+        return;
+    }
     if(enable_residual_)
     {
         split_layer_->Forward(split_bottom_vec_, split_top_vec_);
@@ -222,6 +290,32 @@ void ResidualBlockLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                                 const vector<Blob<Dtype>*>& bottom)
 {
     if(!propagate_down[0])return;
+    if(fused_)
+    {
+        // the residual sum passes top diff unchanged to both of its inputs;
+        // copy it since the fused ReLU rectifies its top diff in place.
+        if(enable_residual_)
+        {
+            caffe_copy(top[0]->count(), top[0]->cpu_diff(),
+                       conv_out_blobs_[layerN_-1]->mutable_cpu_diff());
+        }
+        for(int i=layerN_-1; i >=0; i--)
+        {
+            if(i%2==0 && this->phase_ == TRAIN)
+            {
+                vector<bool> drop_prop_down(1, true);
+                drop_layers_[i/2]->Backward(drop_top_vec_[i/2], drop_prop_down, drop_bottom_vec_[i/2]);
+            }
+            vector<bool> conv_prop_down(1, true);
+            conv_layers_[i]->Backward(conv_top_vec_[i], conv_prop_down, conv_bottom_vec_[i]);
+        }
+        if(enable_residual_)
+        {
+            caffe_axpy(bottom[0]->count(), Dtype(1), top[0]->cpu_diff(),
+                       bottom[0]->mutable_cpu_diff());
+        }
+        return;
+    }
     if(enable_residual_)
     {
         vector<bool> sum_down(2, true);
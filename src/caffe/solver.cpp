@@ -7,6 +7,7 @@
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/sparse.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -454,6 +455,9 @@ string Solver<Dtype>::SnapshotToBinaryProto() {
   LOG(INFO) << "Snapshotting to binary proto file " << model_filename;
   NetParameter net_param;
   net_->ToProto(&net_param, param_.snapshot_diff());
+  if (param_.snapshot_sparse()) {
+    SparsifyNetBlobs(&net_param);
+  }
   WriteProtoToBinaryFile(net_param, model_filename);
   return model_filename;
 }
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,7 +7,14 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/layers/quantized_conv_layer.hpp"
+#include "caffe/layers/relu_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/quantize.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -181,6 +190,58 @@ class ConvolutionLayerTest : public MultiDeviceTest<TypeParam> {
     return this->ref_blob_top_.get();
   }
 
+  // Checks the forward and backward of layer against ConvolutionLayer with
+  // the same weights, on blob_bottom_ reshaped to bottom_shape.
+  void CheckAgainstConvolution(const vector<int>& bottom_shape,
+      Layer<Dtype>* layer) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    this->blob_bottom_->Reshape(bottom_shape);
+    filler.Fill(this->blob_bottom_);
+    Blob<Dtype> ref_bottom, ref_top;
+    ref_bottom.CopyFrom(*this->blob_bottom_, false, true);
+    vector<Blob<Dtype>*> ref_bottom_vec(1, &ref_bottom);
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    LayerParameter ref_layer_param = layer->layer_param();
+    ref_layer_param.mutable_convolution_param()->clear_batch_col_buffer_mb();
+    ConvolutionLayer<Dtype> ref_layer(ref_layer_param);
+    ref_layer.SetUp(ref_bottom_vec, ref_top_vec);
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(ref_layer.blobs().size(), layer->blobs().size());
+    for (int i = 0; i < ref_layer.blobs().size(); ++i) {
+      layer->blobs()[i]->CopyFrom(*ref_layer.blobs()[i]);
+    }
+    ref_layer.Forward(ref_bottom_vec, ref_top_vec);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_TRUE(ref_top.shape() == this->blob_top_->shape());
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          1e-4);
+    }
+    filler.Fill(&ref_top);
+    caffe_copy(ref_top.count(), ref_top.cpu_data(), ref_top.mutable_cpu_diff());
+    caffe_copy(ref_top.count(), ref_top.cpu_diff(),
+        this->blob_top_->mutable_cpu_diff());
+    vector<bool> propagate_down(1, true);
+    ref_layer.Backward(ref_top_vec, propagate_down, ref_bottom_vec);
+    layer->Backward(this->blob_top_vec_, propagate_down,
+        this->blob_bottom_vec_);
+    for (int i = 0; i < ref_bottom.count(); ++i) {
+      EXPECT_NEAR(ref_bottom.cpu_diff()[i], this->blob_bottom_->cpu_diff()[i],
+          1e-4);
+    }
+    for (int b = 0; b < ref_layer.blobs().size(); ++b) {
+      const Blob<Dtype>* ref_param = ref_layer.blobs()[b].get();
+      const Blob<Dtype>* param = layer->blobs()[b].get();
+      // Parameter diffs sum over every image and position.
+      for (int i = 0; i < param->count(); ++i) {
+        const Dtype ref_diff = ref_param->cpu_diff()[i];
+        EXPECT_NEAR(ref_diff, param->cpu_diff()[i],
+            1e-4 * std::max(Dtype(1), std::fabs(ref_diff)));
+      }
+    }
+  }
+
   Blob<Dtype>* const blob_bottom_;
   Blob<Dtype>* const blob_bottom_2_;
   Blob<Dtype>* const blob_top_;
@@ -706,6 +767,81 @@ TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestFusedReLUWorkspace) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  const Dtype kNegativeSlope = 0.01;
+  // Reference: a plain convolution followed by a separate ReLU.
+  Blob<Dtype> conv_top, relu_top;
+  vector<Blob<Dtype>*> conv_top_vec(1, &conv_top);
+  vector<Blob<Dtype>*> relu_top_vec(1, &relu_top);
+  ConvolutionLayer<Dtype> conv_layer(layer_param);
+  conv_layer.SetUp(this->blob_bottom_vec_, conv_top_vec);
+  LayerParameter relu_param;
+  relu_param.mutable_relu_param()->set_negative_slope(kNegativeSlope);
+  ReLULayer<Dtype> relu_layer(relu_param);
+  relu_layer.SetUp(conv_top_vec, relu_top_vec);
+  // Fused layer with the same weights and an external im2col scratch.
+  shared_ptr<Workspace<Dtype> > workspace(new Workspace<Dtype>());
+  ConvolutionLayer<Dtype> fused_layer(layer_param);
+  fused_layer.set_workspace(workspace);
+  fused_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  shared_ptr<Layer<Dtype> > fused_relu(new ReLULayer<Dtype>(relu_param));
+  fused_relu->SetUp(this->blob_top_vec_, this->blob_top_vec_);
+  shared_ptr<Epilogue<Dtype> > epilogue(new Epilogue<Dtype>());
+  epilogue->set_activation(fused_relu);
+  fused_layer.set_epilogue(epilogue);
+  // kernel_dim x output height x output width
+  EXPECT_EQ(3 * 3 * 3 * 2 * 1, workspace->count());
+  for (int i = 0; i < conv_layer.blobs().size(); ++i) {
+    fused_layer.blobs()[i]->CopyFrom(*conv_layer.blobs()[i]);
+  }
+  conv_layer.Forward(this->blob_bottom_vec_, conv_top_vec);
+  relu_layer.Forward(conv_top_vec, relu_top_vec);
+  fused_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(1, workspace->num_buffers());
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  const Dtype* ref_top_data = relu_top.cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+  // Backward from the same top diff must give the same gradients.
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&relu_top);
+  caffe_copy(relu_top.count(), relu_top.cpu_data(),
+      relu_top.mutable_cpu_diff());
+  caffe_copy(relu_top.count(), relu_top.cpu_diff(),
+      this->blob_top_->mutable_cpu_diff());
+  Blob<Dtype> ref_bottom;
+  ref_bottom.CopyFrom(*this->blob_bottom_, false, true);
+  vector<Blob<Dtype>*> ref_bottom_vec(1, &ref_bottom);
+  vector<bool> propagate_down(1, true);
+  relu_layer.Forward(conv_top_vec, relu_top_vec);
+  relu_layer.Backward(relu_top_vec, propagate_down, conv_top_vec);
+  conv_layer.Backward(conv_top_vec, propagate_down, ref_bottom_vec);
+  fused_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  for (int i = 0; i < ref_bottom.count(); ++i) {
+    EXPECT_NEAR(this->blob_bottom_->cpu_diff()[i], ref_bottom.cpu_diff()[i],
+        1e-4);
+  }
+  for (int b = 0; b < conv_layer.blobs().size(); ++b) {
+    const Blob<Dtype>* ref_param = conv_layer.blobs()[b].get();
+    const Blob<Dtype>* param = fused_layer.blobs()[b].get();
+    for (int i = 0; i < param->count(); ++i) {
+      EXPECT_NEAR(param->cpu_diff()[i], ref_param->cpu_diff()[i], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -811,6 +947,362 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestWinogradAgainstConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  // 6 x 4 output: F(2 x 2, 3 x 3) with a partial last tile.
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &layer);
+  EXPECT_EQ(2, layer.tile());
+  // 11 x 9 output: F(4 x 4, 3 x 3).
+  bottom_shape[2] = 11;
+  bottom_shape[3] = 9;
+  WinogradConvolutionLayer<Dtype> large_layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &large_layer);
+  EXPECT_EQ(4, large_layer.tile());
+  // Without padding, and with an input gradient through im2col.
+  for (int pad = 0; pad <= 3; pad += 3) {
+    convolution_param->set_pad(0, pad);
+    WinogradConvolutionLayer<Dtype> padded_layer(layer_param);
+    this->CheckAgainstConvolution(bottom_shape, &padded_layer);
+    EXPECT_NE(0, padded_layer.tile());
+  }
+  // Strided convolutions fall back to ConvolutionLayer.
+  convolution_param->add_stride(2);
+  WinogradConvolutionLayer<Dtype> strided_layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &strided_layer);
+  EXPECT_EQ(0, strided_layer.tile());
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDirectAgainstConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &layer);
+  // Rectangular filters with stride, dilation, padding and groups.
+  convolution_param->clear_kernel_size();
+  convolution_param->set_kernel_h(3);
+  convolution_param->set_kernel_w(2);
+  convolution_param->add_stride(2);
+  convolution_param->add_stride(1);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  bottom_shape[2] = 9;
+  bottom_shape[3] = 7;
+  DirectConvolutionLayer<Dtype> group_layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &group_layer);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDirectDepthwise) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(16);
+  convolution_param->set_group(16);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  // Enough channels for the images to split over several tasks.
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 3;
+  bottom_shape[1] = 16;
+  bottom_shape[2] = 13;
+  bottom_shape[3] = 11;
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &layer);
+  // Two outputs per channel, at stride 2.
+  convolution_param->set_num_output(32);
+  convolution_param->add_stride(2);
+  DirectConvolutionLayer<Dtype> strided_layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &strided_layer);
+#ifndef USE_CUDNN
+  // The default engine picks the direct loops for these.
+  shared_ptr<Layer<Dtype> > default_layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_TRUE(
+      dynamic_cast<DirectConvolutionLayer<Dtype>*>(default_layer.get()));
+  convolution_param->set_group(1);
+  default_layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_FALSE(
+      dynamic_cast<DirectConvolutionLayer<Dtype>*>(default_layer.get()));
+#endif
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestBatchedIm2col) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  convolution_param->set_batch_col_buffer_mb(1);
+  // 1 MB holds 2 (double) or 4 (float) of these images, so the batch of 5
+  // takes a partial last chunk.
+  vector<int> bottom_shape = this->blob_bottom_->shape();
+  bottom_shape[0] = 5;
+  bottom_shape[2] = 42;
+  bottom_shape[3] = 42;
+  ConvolutionLayer<Dtype> layer(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &layer);
+  // 1x1 convolutions go through the batched im2col as well.
+  convolution_param->set_kernel_size(0, 1);
+  convolution_param->set_pad(0, 0);
+  ConvolutionLayer<Dtype> layer_1x1(layer_param);
+  this->CheckAgainstConvolution(bottom_shape, &layer_1x1);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestBatchedIm2colGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  convolution_param->set_batch_col_buffer_mb(1);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestAutoEngine) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(64);
+  convolution_param->set_engine(ConvolutionParameter_Engine_AUTO);
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_TRUE(dynamic_cast<WinogradConvolutionLayer<Dtype>*>(layer.get()));
+  convolution_param->add_stride(2);
+  layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_FALSE(dynamic_cast<WinogradConvolutionLayer<Dtype>*>(layer.get()));
+  EXPECT_FALSE(dynamic_cast<DirectConvolutionLayer<Dtype>*>(layer.get()));
+  convolution_param->set_num_output(8);
+  layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_TRUE(dynamic_cast<DirectConvolutionLayer<Dtype>*>(layer.get()));
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestWinogradGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDirectGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestDirectDepthwiseGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  this->blob_bottom_vec_.push_back(this->blob_bottom_2_);
+  this->blob_top_vec_.push_back(this->blob_top_2_);
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestQuantizedAgainstConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const Dtype input_range = caffe_cpu_amax(this->blob_bottom_->count(),
+      this->blob_bottom_->cpu_data());
+  // Ranges taken from each input, then calibrated; groups; 1 x 1 filters.
+  for (int c = 0; c < 4; ++c) {
+    layer_param.mutable_quantization_param()->set_input_range(
+        c == 0 ? 0 : 1.5 * input_range);
+    if (c == 2) {
+      convolution_param->set_num_output(6);
+      convolution_param->set_group(3);
+    } else if (c == 3) {
+      convolution_param->set_kernel_size(0, 1);
+      convolution_param->set_pad(0, 0);
+      convolution_param->set_group(1);
+    }
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    ASSERT_TRUE(dynamic_cast<QuantizedConvolutionLayer<Dtype>*>(layer.get()));
+    ConvolutionLayer<Dtype> ref_layer(layer_param);
+    Blob<Dtype> ref_top;
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    ref_layer.SetUp(this->blob_bottom_vec_, ref_top_vec);
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < ref_layer.blobs().size(); ++i) {
+      layer->blobs()[i]->CopyFrom(*ref_layer.blobs()[i]);
+    }
+    ref_layer.Forward(this->blob_bottom_vec_, ref_top_vec);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_TRUE(ref_top.shape() == this->blob_top_->shape());
+    // Rounding to int8 costs a few percent of the output range.
+    const Dtype tolerance = 0.05 * caffe_cpu_amax(ref_top.count(),
+        ref_top.cpu_data());
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          tolerance);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestHalfWeightStorage) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  const StoragePrecision precisions[] = { BFLOAT16, FLOAT16 };
+  for (int p = 0; p < 2; ++p) {
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.set_weight_storage(precisions[p]);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The reference multiplies the same weights, rounded, in full precision.
+    ConvolutionLayer<Dtype> ref_layer(layer_param);
+    Blob<Dtype> ref_top;
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    ref_layer.SetUp(this->blob_bottom_vec_, ref_top_vec);
+    ref_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+    Blob<Dtype>* weights = layer.blobs()[0].get();
+    vector<uint16_t> half_weights(weights->count());
+    caffe_cpu_to_half(precisions[p], weights->count(), weights->cpu_data(),
+                      &half_weights[0]);
+    caffe_cpu_from_half(precisions[p], weights->count(), &half_weights[0],
+                        ref_layer.blobs()[0]->mutable_cpu_data());
+    const Dtype first_weight = weights->cpu_data()[0];
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ref_layer.Forward(this->blob_bottom_vec_, ref_top_vec);
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          1e-4);
+    }
+    // The blob keeps the full weights.
+    EXPECT_EQ(first_weight, weights->cpu_data()[0]);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestSparseWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A 1 x 1 convolution, which multiplies the input in place, and a grouped
+  // one through im2col.
+  const int kernel_sizes[] = { 1, 3 };
+  const int groups[] = { 1, 3 };
+  for (int c = 0; c < 2; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_sizes[c]);
+    convolution_param->set_num_output(6);
+    convolution_param->set_group(groups[c]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    ConvolutionLayer<Dtype> layer(layer_param);
+    // Over half of gaussian weights are within 0.8 of 0; with this few of
+    // them, ask for a fifth to be sure the sparse product runs.
+    layer.set_sparse_weights(0.2, 0.8);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The reference multiplies the pruned weights densely.
+    ConvolutionLayer<Dtype> ref_layer(layer_param);
+    Blob<Dtype> ref_top;
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    ref_layer.SetUp(this->blob_bottom_vec_, ref_top_vec);
+    ref_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+    const Blob<Dtype>& weights = *layer.blobs()[0];
+    Dtype* ref_weights = ref_layer.blobs()[0]->mutable_cpu_data();
+    for (int i = 0; i < weights.count(); ++i) {
+      const Dtype w = weights.cpu_data()[i];
+      ref_weights[i] = std::abs(w) > 0.8 ? w : Dtype(0);
+    }
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ref_layer.Forward(this->blob_bottom_vec_, ref_top_vec);
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          1e-4);
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
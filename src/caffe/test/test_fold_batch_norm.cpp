@@ -0,0 +1,109 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/fold_batch_norm.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class FoldBatchNormTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitNetFromProtoString(const string& proto) {
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    param_.mutable_state()->set_phase(TEST);
+    net_.reset(new Net<Dtype>(param_));
+  }
+
+  // A convolution normalized in place and an inner product normalized into
+  // new blobs, with the ReLU and a second reader in between left unfolded.
+  virtual void InitNormalizedNet() {
+    const string& proto =
+        "name: 'NormalizedNetwork' "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape: { dim: 2 dim: 3 dim: 5 dim: 5 } } } "
+        "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+        "  convolution_param { num_output: 4 kernel_size: 3 bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'conv_bn' type: 'BatchNorm' "
+        "  bottom: 'conv' top: 'conv' } "
+        "layer { name: 'conv_scale' type: 'Scale' bottom: 'conv' top: 'conv' "
+        "  scale_param { bias_term: true } } "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+        "layer { name: 'relu_scale' type: 'Scale' "
+        "  bottom: 'conv' top: 'conv' } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+        "  inner_product_param { num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'ip_bn' type: 'BatchNorm' bottom: 'ip' top: 'ip_bn' } "
+        "layer { name: 'ip_bias' type: 'Bias' bottom: 'ip_bn' top: 'out' } ";
+    InitNetFromProtoString(proto);
+  }
+
+  // Fills the statistics, the scales and the biases with random values.
+  void FillWeights() {
+    FillerParameter filler_param;
+    filler_param.set_min(0.5);
+    filler_param.set_max(1.5);
+    UniformFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < net_->layers().size(); ++i) {
+      const string& type = net_->layers()[i]->type();
+      const vector<shared_ptr<Blob<Dtype> > >& blobs =
+          net_->layers()[i]->blobs();
+      if (type == "BatchNorm") {
+        filler.Fill(blobs[0].get());
+        filler.Fill(blobs[1].get());
+        blobs[2]->mutable_cpu_data()[0] = 2;
+      } else if (type == "Scale" || type == "Bias") {
+        for (int j = 0; j < blobs.size(); ++j) {
+          filler.Fill(blobs[j].get());
+        }
+      }
+    }
+  }
+
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(FoldBatchNormTest, TestDtypesAndDevices);
+
+TYPED_TEST(FoldBatchNormTest, TestFoldMatchesOriginal) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitNormalizedNet();
+  this->FillWeights();
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* data = this->net_->blob_by_name("data").get();
+  filler.Fill(data);
+  this->net_->Forward();
+
+  NetParameter param_folded;
+  EXPECT_EQ(4, FoldBatchNorm(this->param_, *this->net_, &param_folded));
+  ASSERT_EQ(5, param_folded.layer_size());
+  EXPECT_EQ("relu_scale", param_folded.layer(3).name());
+  EXPECT_EQ("out", param_folded.layer(4).top(0));
+  Net<Dtype> net_folded(param_folded);
+  net_folded.blob_by_name("data")->CopyFrom(*data);
+  net_folded.Forward();
+
+  const Blob<Dtype>* expected = this->net_->blob_by_name("out").get();
+  const Blob<Dtype>* output = net_folded.blob_by_name("out").get();
+  ASSERT_EQ(expected->count(), output->count());
+  for (int i = 0; i < expected->count(); ++i) {
+    EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,137 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfConversionTest : public ::testing::Test {};
+
+TEST_F(HalfConversionTest, TestBFloat16) {
+  EXPECT_EQ(0x3f80, float_to_bf16(1.f));
+  EXPECT_EQ(0xc000, float_to_bf16(-2.f));
+  EXPECT_EQ(1.f, bf16_to_float(0x3f80));
+  // 1 + 2^-8 lies halfway between 1 and 1 + 2^-7 and rounds to the even 1;
+  // anything above it rounds up.
+  EXPECT_EQ(0x3f80, float_to_bf16(float_from_bits(0x3f808000)));
+  EXPECT_EQ(0x3f81, float_to_bf16(float_from_bits(0x3f808001)));
+  EXPECT_EQ(0x3f82, float_to_bf16(float_from_bits(0x3f818000)));
+  EXPECT_EQ(0x7f80, float_to_bf16(std::numeric_limits<float>::infinity()));
+  EXPECT_TRUE(std::isnan(bf16_to_float(
+      float_to_bf16(std::numeric_limits<float>::quiet_NaN()))));
+  // A NaN with only low mantissa bits must not round into infinity.
+  EXPECT_TRUE(std::isnan(bf16_to_float(
+      float_to_bf16(float_from_bits(0x7f800001)))));
+}
+
+TEST_F(HalfConversionTest, TestFloat16) {
+  EXPECT_EQ(0x3c00, float_to_fp16(1.f));
+  EXPECT_EQ(0xc000, float_to_fp16(-2.f));
+  EXPECT_EQ(0x7bff, float_to_fp16(65504.f));
+  EXPECT_EQ(0x7c00, float_to_fp16(65536.f));
+  EXPECT_EQ(0xfc00, float_to_fp16(-std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0x0000, float_to_fp16(0.f));
+  EXPECT_EQ(0x8000, float_to_fp16(-0.f));
+  // The smallest subnormal, and half of it which rounds to the even zero.
+  EXPECT_EQ(0x0001, float_to_fp16(std::ldexp(1.f, -24)));
+  EXPECT_EQ(0x0000, float_to_fp16(std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x0001, float_to_fp16(std::ldexp(1.5f, -25)));
+  // 1 + 2^-11 lies halfway between 1 and 1 + 2^-10.
+  EXPECT_EQ(0x3c00, float_to_fp16(1.f + std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c02, float_to_fp16(1.f + 3 * std::ldexp(1.f, -11)));
+  EXPECT_TRUE(std::isnan(fp16_to_float(
+      float_to_fp16(std::numeric_limits<float>::quiet_NaN()))));
+}
+
+TEST_F(HalfConversionTest, TestFloat16RoundTrip) {
+  // Every half that is not a NaN converts to float and back unchanged.
+  for (uint32_t h = 0; h < 0x10000; ++h) {
+    if ((h & 0x7c00) == 0x7c00 && (h & 0x03ff) != 0) {
+      continue;
+    }
+    EXPECT_EQ(h, float_to_fp16(fp16_to_float(static_cast<uint16_t>(h))));
+  }
+  EXPECT_EQ(std::ldexp(1.f, -24), fp16_to_float(0x0001));
+  EXPECT_EQ(-65504.f, fp16_to_float(0xfbff));
+}
+
+template <typename TypeParam>
+class HalfTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  // Rounds x to the precision, as the kernels see it.
+  void Round(StoragePrecision precision, vector<TypeParam>* x) {
+    vector<uint16_t> h(x->size());
+    caffe_cpu_to_half(precision, x->size(), &(*x)[0], &h[0]);
+    caffe_cpu_from_half(precision, x->size(), &h[0], &(*x)[0]);
+  }
+};
+
+TYPED_TEST_CASE(HalfTest, TestDtypes);
+
+TYPED_TEST(HalfTest, TestConversion) {
+  const int n = 1000;
+  vector<TypeParam> x(n), y(n);
+  vector<uint16_t> h(n);
+  for (int i = 0; i < n; ++i) {
+    x[i] = std::sin(TypeParam(i)) * (i % 7 + 1);
+  }
+  caffe_cpu_to_half(BFLOAT16, n, &x[0], &h[0]);
+  caffe_cpu_from_half(BFLOAT16, n, &h[0], &y[0]);
+  for (int i = 0; i < n; ++i) {
+    // bfloat16 keeps 8 significant bits.
+    EXPECT_NEAR(x[i], y[i], std::abs(x[i]) * std::ldexp(1., -8));
+  }
+  caffe_cpu_to_half(FLOAT16, n, &x[0], &h[0]);
+  caffe_cpu_from_half(FLOAT16, n, &h[0], &y[0]);
+  for (int i = 0; i < n; ++i) {
+    // float16 keeps 11, down to its subnormals.
+    EXPECT_NEAR(x[i], y[i],
+        std::abs(x[i]) * std::ldexp(1., -11) + std::ldexp(1., -25));
+  }
+}
+
+TYPED_TEST(HalfTest, TestGemm) {
+  typedef TypeParam Dtype;
+  // More columns than one block of the kernel, and a partial row block.
+  const int M = 6, N = 300, K = 7;
+  const StoragePrecision precisions[] = { BFLOAT16, FLOAT16 };
+  for (int p = 0; p < 2; ++p) {
+    vector<Dtype> W(M * K), B(K * N), A(N * K);
+    for (int i = 0; i < W.size(); ++i) {
+      W[i] = std::cos(Dtype(i));
+    }
+    for (int i = 0; i < B.size(); ++i) {
+      B[i] = std::sin(Dtype(i) / 3);
+      A[i] = std::sin(Dtype(i) / 5);
+    }
+    vector<uint16_t> W_half(M * K);
+    caffe_cpu_to_half(precisions[p], M * K, &W[0], &W_half[0]);
+    this->Round(precisions[p], &W);
+    vector<Dtype> C(M * N), C_trans(N * M);
+    caffe_cpu_half_gemm(precisions[p], M, N, K, &W_half[0], &B[0], &C[0]);
+    // As an inner product: N inputs of K values through the M x K weights.
+    caffe_cpu_gemm_half_trans(precisions[p], N, M, K, &A[0], &W_half[0],
+                              &C_trans[0]);
+    for (int m = 0; m < M; ++m) {
+      for (int n = 0; n < N; ++n) {
+        Dtype expected = 0, expected_trans = 0;
+        for (int k = 0; k < K; ++k) {
+          expected += W[m * K + k] * B[k * N + n];
+          expected_trans += A[n * K + k] * W[m * K + k];
+        }
+        EXPECT_NEAR(expected, C[m * N + n], 1e-5);
+        EXPECT_NEAR(expected_trans, C_trans[n * M + m], 1e-5);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
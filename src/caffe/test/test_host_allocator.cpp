@@ -0,0 +1,122 @@
+#include <stdint.h>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+ protected:
+  HostAllocatorTest() : initial_allocator_(Caffe::host_allocator()) {}
+  virtual ~HostAllocatorTest() {
+    Caffe::set_host_allocator(initial_allocator_);
+  }
+
+  const shared_ptr<HostAllocator> initial_allocator_;
+};
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  HostAllocator allocator;
+  for (size_t size = 0; size < 1000; size += 7) {
+    void* ptr = allocator.Allocate(size);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % HostAllocator::kAlignment);
+    memset(ptr, 1, size);
+    allocator.Free(ptr, size);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestCache) {
+  HostAllocator allocator(1 << 20);
+  void* ptr = allocator.Allocate(1000);
+  HostAllocator::Stats stats = allocator.stats();
+  EXPECT_EQ(1, stats.num_allocs);
+  EXPECT_EQ(0, stats.num_cache_hits);
+  // 1000 bytes fall in the class of 1024.
+  EXPECT_EQ(1024, stats.bytes_in_use);
+  allocator.Free(ptr, 1000);
+  stats = allocator.stats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(1024, stats.bytes_cached);
+  // A request of the same size class reuses the block.
+  EXPECT_EQ(ptr, allocator.Allocate(900));
+  stats = allocator.stats();
+  EXPECT_EQ(2, stats.num_allocs);
+  EXPECT_EQ(1, stats.num_cache_hits);
+  EXPECT_EQ(0, stats.bytes_cached);
+  // Another size class does not.
+  void* large_ptr = allocator.Allocate(1100);
+  EXPECT_NE(ptr, large_ptr);
+  stats = allocator.stats();
+  EXPECT_EQ(1, stats.num_cache_hits);
+  EXPECT_EQ(1024 + 1280, stats.bytes_in_use);
+  EXPECT_EQ(1024 + 1280, stats.peak_bytes_in_use);
+  allocator.Free(ptr, 900);
+  allocator.Free(large_ptr, 1100);
+  stats = allocator.stats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(1024 + 1280, stats.peak_bytes_in_use);
+  EXPECT_EQ(1024 + 1280, stats.bytes_cached);
+  allocator.ReleaseCache();
+  EXPECT_EQ(0, allocator.stats().bytes_cached);
+}
+
+TEST_F(HostAllocatorTest, TestMaxCachedBytes) {
+  HostAllocator allocator(1024);
+  void* ptr = allocator.Allocate(1000);
+  void* other_ptr = allocator.Allocate(1000);
+  allocator.Free(ptr, 1000);
+  // The cache is full, so this block goes back to the system.
+  allocator.Free(other_ptr, 1000);
+  EXPECT_EQ(1024, allocator.stats().bytes_cached);
+  // Without caching, blocks are only rounded up to the alignment.
+  HostAllocator uncached_allocator(0);
+  ptr = uncached_allocator.Allocate(1000);
+  EXPECT_EQ(1024, uncached_allocator.stats().bytes_in_use);
+  uncached_allocator.Free(ptr, 1000);
+  ptr = uncached_allocator.Allocate(1000);
+  EXPECT_EQ(0, uncached_allocator.stats().num_cache_hits);
+  EXPECT_EQ(0, uncached_allocator.stats().bytes_cached);
+  uncached_allocator.Free(ptr, 1000);
+}
+
+TEST_F(HostAllocatorTest, TestHugePages) {
+  HostAllocator allocator(HostAllocator::kDefaultMaxCachedBytes, true);
+  const size_t size = 3 * HostAllocator::kHugePageSize;
+  void* ptr = allocator.Allocate(size);
+  EXPECT_EQ(0,
+      reinterpret_cast<uintptr_t>(ptr) % HostAllocator::kHugePageSize);
+  memset(ptr, 1, size);
+  allocator.Free(ptr, size);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemory) {
+  shared_ptr<HostAllocator> allocator(new HostAllocator());
+  Caffe::set_host_allocator(allocator);
+  shared_ptr<SyncedMemory> mem(new SyncedMemory(1000));
+  mem->mutable_cpu_data();
+  EXPECT_EQ(1024, allocator->stats().bytes_in_use);
+  // The memory goes back to its allocator even after another is chosen.
+  Caffe::set_host_allocator(initial_allocator_);
+  mem.reset();
+  EXPECT_EQ(0, allocator->stats().bytes_in_use);
+  EXPECT_EQ(1024, allocator->stats().bytes_cached);
+  // Recycled memory is zeroed like fresh memory.
+  Caffe::set_host_allocator(allocator);
+  mem.reset(new SyncedMemory(1000));
+  memset(mem->mutable_cpu_data(), 1, 1000);
+  mem.reset(new SyncedMemory(1000));
+  const char* data = static_cast<const char*>(mem->cpu_data());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(0, data[i]);
+  }
+  EXPECT_EQ(3, allocator->stats().num_allocs);
+  EXPECT_EQ(2, allocator->stats().num_cache_hits);
+}
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,7 +6,11 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/layers/quantized_inner_product_layer.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/quantize.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -388,4 +393,118 @@ TYPED_TEST(InnerProductLayerTest, TestBackwardTranspose) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestQuantizedForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_type("InnerProduct");
+  layer_param.mutable_quantization_param();
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  for (int transpose = 0; transpose <= 1; ++transpose) {
+    inner_product_param->set_transpose(transpose);
+    shared_ptr<Layer<Dtype> > layer =
+        LayerRegistry<Dtype>::CreateLayer(layer_param);
+    ASSERT_TRUE(
+        dynamic_cast<QuantizedInnerProductLayer<Dtype>*>(layer.get()));
+    InnerProductLayer<Dtype> ref_layer(layer_param);
+    Blob<Dtype> ref_top;
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    ref_layer.SetUp(this->blob_bottom_vec_, ref_top_vec);
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < ref_layer.blobs().size(); ++i) {
+      layer->blobs()[i]->CopyFrom(*ref_layer.blobs()[i]);
+    }
+    ref_layer.Forward(this->blob_bottom_vec_, ref_top_vec);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_TRUE(ref_top.shape() == this->blob_top_->shape());
+    // Rounding to int8 costs a few percent of the output range.
+    const Dtype tolerance = 0.05 * caffe_cpu_amax(ref_top.count(),
+        ref_top.cpu_data());
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          tolerance);
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestHalfWeightStorage) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  const StoragePrecision precisions[] = { BFLOAT16, FLOAT16 };
+  for (int c = 0; c < 4; ++c) {
+    const StoragePrecision precision = precisions[c % 2];
+    inner_product_param->set_transpose(c >= 2);
+    InnerProductLayer<Dtype> layer(layer_param);
+    layer.set_weight_storage(precision);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The reference multiplies the same weights, rounded, in full precision.
+    InnerProductLayer<Dtype> ref_layer(layer_param);
+    Blob<Dtype> ref_top;
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    ref_layer.SetUp(this->blob_bottom_vec_, ref_top_vec);
+    ref_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+    Blob<Dtype>* weights = layer.blobs()[0].get();
+    vector<uint16_t> half_weights(weights->count());
+    caffe_cpu_to_half(precision, weights->count(), weights->cpu_data(),
+                      &half_weights[0]);
+    caffe_cpu_from_half(precision, weights->count(), &half_weights[0],
+                        ref_layer.blobs()[0]->mutable_cpu_data());
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ref_layer.Forward(this->blob_bottom_vec_, ref_top_vec);
+    ASSERT_TRUE(ref_top.shape() == this->blob_top_->shape());
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          1e-4);
+    }
+  }
+}
+
+
+TYPED_TEST(InnerProductLayerTest, TestSparseWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("gaussian");
+  inner_product_param->mutable_bias_filler()->set_type("gaussian");
+  for (int t = 0; t < 2; ++t) {
+    inner_product_param->set_transpose(t == 1);
+    InnerProductLayer<Dtype> layer(layer_param);
+    // Over half of gaussian weights are within 0.8 of 0.
+    layer.set_sparse_weights(0.4, 0.8);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The reference multiplies the pruned weights densely.
+    InnerProductLayer<Dtype> ref_layer(layer_param);
+    Blob<Dtype> ref_top;
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    ref_layer.SetUp(this->blob_bottom_vec_, ref_top_vec);
+    ref_layer.blobs()[1]->CopyFrom(*layer.blobs()[1]);
+    const Blob<Dtype>& weights = *layer.blobs()[0];
+    Dtype* ref_weights = ref_layer.blobs()[0]->mutable_cpu_data();
+    for (int i = 0; i < weights.count(); ++i) {
+      const Dtype w = weights.cpu_data()[i];
+      ref_weights[i] = std::abs(w) > 0.8 ? w : Dtype(0);
+    }
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ref_layer.Forward(this->blob_bottom_vec_, ref_top_vec);
+    ASSERT_TRUE(ref_top.shape() == this->blob_top_->shape());
+    for (int i = 0; i < ref_top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+          1e-4);
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,96 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/layout_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class LayoutLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  LayoutLayerTest()
+      // More channels and positions than a block, neither a multiple of it.
+      : blob_bottom_(new Blob<Dtype>(2, 40, 5, 7)),
+        blob_middle_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_middle_vec_.push_back(blob_middle_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~LayoutLayerTest() {
+    delete blob_bottom_;
+    delete blob_middle_;
+    delete blob_top_;
+  }
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_middle_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_middle_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(LayoutLayerTest, TestDtypes);
+
+TYPED_TEST(LayoutLayerTest, TestForward) {
+  LayerParameter layer_param;
+  LayoutLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_middle_vec_);
+  EXPECT_EQ(this->blob_middle_->shape(), this->blob_bottom_->shape());
+  EXPECT_EQ(this->blob_middle_->layout(), NHWC);
+  layer.Forward(this->blob_bottom_vec_, this->blob_middle_vec_);
+  const int num = 2, channels = 40, height = 5, width = 7;
+  const TypeParam* data = this->blob_middle_->cpu_data();
+  for (int n = 0; n < num; ++n) {
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; ++w) {
+          EXPECT_EQ(this->blob_bottom_->data_at(n, c, h, w),
+              data[((n * height + h) * width + w) * channels + c]);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(LayoutLayerTest, TestRoundTrip) {
+  LayerParameter to_nhwc_param;
+  LayoutLayer<TypeParam> to_nhwc(to_nhwc_param);
+  to_nhwc.SetUp(this->blob_bottom_vec_, this->blob_middle_vec_);
+  LayerParameter to_nchw_param;
+  to_nchw_param.mutable_layout_param()->set_layout(NCHW);
+  LayoutLayer<TypeParam> to_nchw(to_nchw_param);
+  to_nchw.SetUp(this->blob_middle_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->layout(), NCHW);
+  to_nhwc.Forward(this->blob_bottom_vec_, this->blob_middle_vec_);
+  to_nchw.Forward(this->blob_middle_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+              this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(LayoutLayerTest, TestGradient) {
+  this->blob_bottom_->Reshape(2, 3, 2, 3);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  LayoutLayer<TypeParam> layer(layer_param);
+  GradientChecker<TypeParam> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_middle_vec_);
+}
+
+}  // namespace caffe
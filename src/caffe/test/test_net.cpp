@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -771,6 +775,166 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  // Three branches on the data, two of them sharing weights, merged again
+  // before the loss. The layers are large enough for the branches to overlap.
+  virtual void InitBranchedNet(const bool concurrent_branches) {
+    string proto =
+        "name: 'BranchedNetwork' "
+        "force_backward: true "
+        "layer { name: 'data' type: 'Input' top: 'data' top: 'label' "
+        "  input_param { shape { dim: 2 dim: 8 dim: 16 dim: 16 } "
+        "                shape { dim: 2 dim: 2 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+        "  convolution_param { num_output: 8 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'data' top: 'conv2' "
+        "  param { name: 'shared' } "
+        "  convolution_param { num_output: 8 kernel_size: 3 pad: 1 "
+        "    bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'conv3' type: 'Convolution' bottom: 'data' top: 'conv3' "
+        "  param { name: 'shared' } "
+        "  convolution_param { num_output: 8 kernel_size: 3 pad: 1 "
+        "    bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'sum' type: 'Eltwise' bottom: 'conv2' bottom: 'conv3' "
+        "  top: 'sum' } "
+        "layer { name: 'tanh' type: 'TanH' bottom: 'sum' top: 'sum' } "
+        "layer { name: 'concat' type: 'Concat' bottom: 'conv1' bottom: 'sum' "
+        "  top: 'concat' } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'concat' top: 'ip' "
+        "  inner_product_param { num_output: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.01 } } } "
+        "layer { name: 'loss' type: 'EuclideanLoss' bottom: 'ip' "
+        "  bottom: 'label' top: 'loss' } ";
+    if (concurrent_branches) {
+      proto += "concurrent_branches: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  // A TEST net chaining convolutions and element-wise layers.
+  virtual void InitChainNet(const bool share_activations,
+      const StoragePrecision weight_storage = FULL_PRECISION,
+      const float sparse_weights = 0) {
+    string proto =
+        "name: 'ChainNetwork' "
+        "state { phase: TEST } "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'relu1' } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'relu1' "
+        "  top: 'conv2' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'tanh2' type: 'TanH' bottom: 'conv2' top: 'tanh2' } "
+        "layer { name: 'conv3' type: 'Convolution' bottom: 'tanh2' "
+        "  top: 'conv3' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'flatten' type: 'Flatten' bottom: 'conv3' "
+        "  top: 'flatten' } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'flatten' top: 'ip' "
+        "  inner_product_param { num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } ";
+    if (share_activations) {
+      proto += "share_activations: true keep_blob: 'conv2' ";
+    }
+    if (weight_storage != FULL_PRECISION) {
+      proto += "weight_storage: " + StoragePrecision_Name(weight_storage);
+    }
+    if (sparse_weights > 0) {
+      std::ostringstream sparse;
+      sparse << "sparse_weights: " << sparse_weights << " ";
+      proto += sparse.str();
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  // A residual block and an inner product, each followed by element-wise
+  // layers that can run as epilogues.
+  virtual void InitResidualNet(const bool fuse_epilogues,
+                               const bool share_conv_workspace = false) {
+    string proto =
+        "name: 'ResidualNetwork' "
+        "force_backward: true "
+        "layer { name: 'data' type: 'Input' top: 'data' top: 'label' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+        "                shape { dim: 2 dim: 3 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'conv1' "
+        "  top: 'conv2' "
+        "  convolution_param { num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'sum' type: 'Eltwise' bottom: 'conv1' bottom: 'conv2' "
+        "  top: 'sum' eltwise_param { coeff: 0.5 coeff: 2 } } "
+        "layer { name: 'elu' type: 'ELU' bottom: 'sum' top: 'elu' "
+        "  elu_param { alpha: 0.5 } } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'elu' top: 'ip' "
+        "  inner_product_param { num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } } } "
+        "layer { name: 'sigmoid' type: 'Sigmoid' bottom: 'ip' top: 'ip' } "
+        "layer { name: 'loss' type: 'EuclideanLoss' bottom: 'ip' "
+        "  bottom: 'label' top: 'loss' } ";
+    if (fuse_epilogues) {
+      proto += "fuse_epilogues: true ";
+    }
+    if (share_conv_workspace) {
+      proto += "share_conv_workspace: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  // A TEST net of the layers that run in NHWC, with strided, dilated, grouped
+  // and 1 x 1 convolutions, both pooling methods, and an InnerProduct that
+  // needs its input back in NCHW.
+  virtual void InitLayoutNet(const BlobLayout layout) {
+    string proto =
+        "name: 'LayoutNetwork' "
+        "state { phase: TEST } "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 6 dim: 9 dim: 9 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' top: 'conv1' "
+        "  convolution_param { num_output: 8 kernel_size: 3 pad: 1 stride: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'conv1' "
+        "  batch_norm_param { use_global_stats: true } } "
+        "layer { name: 'scale1' type: 'Scale' bottom: 'conv1' top: 'conv1' "
+        "  scale_param { bias_term: true filler { type: 'gaussian' } "
+        "    bias_filler { type: 'gaussian' } } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'conv1' "
+        "  top: 'conv2' "
+        "  convolution_param { num_output: 8 kernel_size: 3 pad: 2 "
+        "    dilation: 2 group: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'conv3' type: 'Convolution' bottom: 'conv1' "
+        "  top: 'conv3' "
+        "  convolution_param { num_output: 8 kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'sum' type: 'Eltwise' bottom: 'conv2' bottom: 'conv3' "
+        "  top: 'sum' } "
+        "layer { name: 'pool1' type: 'Pooling' bottom: 'sum' top: 'pool1' "
+        "  pooling_param { pool: MAX kernel_size: 3 stride: 2 } } "
+        "layer { name: 'pool2' type: 'Pooling' bottom: 'sum' top: 'pool2' "
+        "  pooling_param { pool: AVE kernel_size: 3 stride: 2 pad: 1 } } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'pool2' top: 'ip' "
+        "  inner_product_param { num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'prob' type: 'Softmax' bottom: 'pool1' top: 'prob' } ";
+    proto += "layout: " + BlobLayout_Name(layout);
+    InitNetFromProtoString(proto);
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -1389,6 +1553,294 @@ TYPED_TEST(NetTest, TestFromTo) {
   }
 }
 
+TYPED_TEST(NetTest, TestConcurrentBranches) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int cpu_threads = Caffe::cpu_threads();
+  Caffe::set_cpu_threads(3);
+  Dtype loss[2];
+  vector<shared_ptr<Blob<Dtype> > > blobs[2];
+  vector<shared_ptr<Blob<Dtype> > > params[2];
+  for (int concurrent = 0; concurrent < 2; ++concurrent) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitBranchedNet(concurrent);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->net_->blob_by_name("data").get());
+    filler.Fill(this->net_->blob_by_name("label").get());
+    this->net_->Forward(&loss[concurrent]);
+    this->net_->ClearParamDiffs();
+    this->net_->Backward();
+    this->CopyNetBlobs(true, &blobs[concurrent]);
+    this->CopyNetParams(true, &params[concurrent]);
+  }
+  Caffe::set_cpu_threads(cpu_threads);
+  // Conflicting layers keep their serial order, so the results are exact.
+  EXPECT_EQ(loss[0], loss[1]);
+  ASSERT_EQ(blobs[0].size(), blobs[1].size());
+  for (int i = 0; i < blobs[0].size(); ++i) {
+    for (int j = 0; j < blobs[0][i]->count(); ++j) {
+      EXPECT_EQ(blobs[0][i]->cpu_data()[j], blobs[1][i]->cpu_data()[j]);
+      EXPECT_EQ(blobs[0][i]->cpu_diff()[j], blobs[1][i]->cpu_diff()[j]);
+    }
+  }
+  ASSERT_EQ(params[0].size(), params[1].size());
+  for (int i = 0; i < params[0].size(); ++i) {
+    for (int j = 0; j < params[0][i]->count(); ++j) {
+      EXPECT_EQ(params[0][i]->cpu_data()[j], params[1][i]->cpu_data()[j]);
+      EXPECT_EQ(params[0][i]->cpu_diff()[j], params[1][i]->cpu_diff()[j]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestShareActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitChainNet(false);
+  shared_ptr<Net<Dtype> > unshared_net = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitChainNet(true);
+  EXPECT_TRUE(this->net_->share_activations());
+  // relu1 overwrites conv1, and tanh2 reuses the memory of relu1, which is
+  // dead by then; conv3 is computed from tanh2 so it needs other memory.
+  EXPECT_EQ(this->net_->blob_by_name("conv1")->data(),
+            this->net_->blob_by_name("relu1")->data());
+  EXPECT_EQ(this->net_->blob_by_name("relu1")->data(),
+            this->net_->blob_by_name("tanh2")->data());
+  EXPECT_NE(this->net_->blob_by_name("tanh2")->data(),
+            this->net_->blob_by_name("conv3")->data());
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      // The buffers are planned again for the new shapes.
+      unshared_net->blob_by_name("data")->Reshape(3, 3, 6, 6);
+      unshared_net->Reshape();
+      this->net_->blob_by_name("data")->Reshape(3, 3, 6, 6);
+      this->net_->Reshape();
+    }
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(unshared_net->blob_by_name("data").get());
+    this->net_->blob_by_name("data")->CopyFrom(
+        *unshared_net->blob_by_name("data"));
+    unshared_net->Forward();
+    this->net_->Forward();
+    const char* kept_blobs[] = { "conv2", "ip" };
+    for (int i = 0; i < 2; ++i) {
+      const Blob<Dtype>& expected = *unshared_net->blob_by_name(kept_blobs[i]);
+      const Blob<Dtype>& actual = *this->net_->blob_by_name(kept_blobs[i]);
+      ASSERT_EQ(expected.count(), actual.count());
+      for (int j = 0; j < expected.count(); ++j) {
+        EXPECT_EQ(expected.cpu_data()[j], actual.cpu_data()[j]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestFuseEpilogues) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitResidualNet(false);
+  shared_ptr<Net<Dtype> > unfused_net = this->net_;
+  Caffe::set_random_seed(this->seed_);
+  this->InitResidualNet(true);
+  shared_ptr<Net<Dtype> > net = this->net_;
+  const vector<string>& names = net->layer_names();
+  map<string, string> fused_into;
+  for (int i = 0; i < names.size(); ++i) {
+    if (net->fused_into(i) >= 0) {
+      fused_into[names[i]] = names[net->fused_into(i)];
+    }
+  }
+  EXPECT_EQ(4, fused_into.size());
+  EXPECT_EQ("conv1", fused_into["relu1"]);
+  EXPECT_EQ("conv2", fused_into["sum"]);
+  EXPECT_EQ("conv2", fused_into["elu"]);
+  EXPECT_EQ("ip", fused_into["sigmoid"]);
+
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 2; ++i) {
+    const string blob_name = (i == 0) ? "data" : "label";
+    filler.Fill(unfused_net->blob_by_name(blob_name).get());
+    net->blob_by_name(blob_name)->CopyFrom(
+        *unfused_net->blob_by_name(blob_name));
+  }
+  Dtype unfused_loss, loss;
+  unfused_net->Forward(&unfused_loss);
+  net->Forward(&loss);
+  EXPECT_NEAR(unfused_loss, loss, 1e-5);
+  unfused_net->Backward();
+  net->Backward();
+  const Blob<Dtype>& expected_diff = *unfused_net->blob_by_name("data");
+  const Blob<Dtype>& data_diff = *net->blob_by_name("data");
+  for (int i = 0; i < expected_diff.count(); ++i) {
+    EXPECT_NEAR(expected_diff.cpu_diff()[i], data_diff.cpu_diff()[i], 1e-5);
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+      unfused_net->params();
+  const vector<shared_ptr<Blob<Dtype> > >& params = net->params();
+  ASSERT_EQ(expected_params.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_NEAR(expected_params[i]->cpu_diff()[j], params[i]->cpu_diff()[j],
+                  1e-5) << "param " << i << " index " << j;
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestShareConvWorkspace) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitResidualNet(false);
+  shared_ptr<Net<Dtype> > unshared_net = this->net_;
+  EXPECT_FALSE(unshared_net->conv_workspace().get());
+  Caffe::set_random_seed(this->seed_);
+  this->InitResidualNet(false, true);
+  shared_ptr<Net<Dtype> > net = this->net_;
+  ASSERT_TRUE(net->conv_workspace().get());
+  // conv2 has the larger im2col buffer: 4 * 3 * 3 rows of 6 * 6 columns.
+  EXPECT_EQ(4 * 3 * 3 * 6 * 6, net->conv_workspace()->count());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 2; ++i) {
+    const string blob_name = (i == 0) ? "data" : "label";
+    filler.Fill(unshared_net->blob_by_name(blob_name).get());
+    net->blob_by_name(blob_name)->CopyFrom(
+        *unshared_net->blob_by_name(blob_name));
+  }
+  Dtype unshared_loss, loss;
+  unshared_net->Forward(&unshared_loss);
+  net->Forward(&loss);
+  EXPECT_EQ(unshared_loss, loss);
+  unshared_net->Backward();
+  net->Backward();
+  const Blob<Dtype>& expected_diff = *unshared_net->blob_by_name("data");
+  const Blob<Dtype>& data_diff = *net->blob_by_name("data");
+  for (int i = 0; i < expected_diff.count(); ++i) {
+    EXPECT_EQ(expected_diff.cpu_diff()[i], data_diff.cpu_diff()[i]);
+  }
+  const vector<shared_ptr<Blob<Dtype> > >& expected_params =
+      unshared_net->params();
+  const vector<shared_ptr<Blob<Dtype> > >& params = net->params();
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_EQ(expected_params[i]->cpu_diff()[j], params[i]->cpu_diff()[j]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestWeightStorage) {
+  typedef typename TypeParam::Dtype Dtype;
+  const StoragePrecision precisions[] = { BFLOAT16, FLOAT16 };
+  for (int p = 0; p < 2; ++p) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitChainNet(false);
+    shared_ptr<Net<Dtype> > full_net = this->net_;
+    Caffe::set_random_seed(this->seed_);
+    this->InitChainNet(false, precisions[p]);
+    for (int pass = 0; pass < 2; ++pass) {
+      if (pass == 1) {
+        // The layers multiply with the new weights, not their stale copies.
+        caffe_scal(full_net->params()[0]->count(), Dtype(2),
+                   full_net->params()[0]->mutable_cpu_data());
+        this->net_->ShareTrainedLayersWith(full_net.get());
+      }
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(full_net->blob_by_name("data").get());
+      this->net_->blob_by_name("data")->CopyFrom(
+          *full_net->blob_by_name("data"));
+      full_net->Forward();
+      this->net_->Forward();
+      const Blob<Dtype>& expected = *full_net->blob_by_name("ip");
+      const Blob<Dtype>& actual = *this->net_->blob_by_name("ip");
+      Dtype amax = 0;
+      for (int i = 0; i < expected.count(); ++i) {
+        amax = std::max(amax, std::abs(expected.cpu_data()[i]));
+      }
+      // bfloat16 rounds each weight by up to 2^-9 of it, float16 by 2^-12.
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 0.02 * amax);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestSparseWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitChainNet(false);
+  shared_ptr<Net<Dtype> > dense_net = this->net_;
+  this->InitChainNet(false, FULL_PRECISION, 0.4);
+  // Prune the weights to about 60% zeros, then let the layers of the sparse
+  // net take them up.
+  for (int i = 0; i < dense_net->layers().size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        dense_net->layers()[i]->blobs();
+    if (blobs.empty()) {
+      continue;
+    }
+    Dtype* weights = blobs[0]->mutable_cpu_data();
+    for (int j = 0; j < blobs[0]->count(); ++j) {
+      if (std::abs(weights[j]) <= Dtype(0.4)) {
+        weights[j] = 0;
+      }
+    }
+  }
+  this->net_->ShareTrainedLayersWith(dense_net.get());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(dense_net->blob_by_name("data").get());
+  this->net_->blob_by_name("data")->CopyFrom(
+      *dense_net->blob_by_name("data"));
+  dense_net->Forward();
+  this->net_->Forward();
+  const Blob<Dtype>& expected = *dense_net->blob_by_name("ip");
+  const Blob<Dtype>& actual = *this->net_->blob_by_name("ip");
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestLayout) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitLayoutNet(NCHW);
+  shared_ptr<Net<Dtype> > nchw_net = this->net_;
+  this->InitLayoutNet(NHWC);
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_TRUE(this->net_->has_layer("data_to_nhwc"));
+    EXPECT_TRUE(this->net_->has_layer("pool2_to_nchw"));
+    EXPECT_TRUE(this->net_->has_layer("prob_to_nchw"));
+    EXPECT_EQ(NHWC, this->net_->blob_by_name("sum_nhwc")->layout());
+  }
+  // Give BatchNorm statistics other than its zero defaults.
+  vector<shared_ptr<Blob<Dtype> > >& bn_blobs =
+      nchw_net->layer_by_name("bn1")->blobs();
+  caffe_rng_gaussian<Dtype>(bn_blobs[0]->count(), 0, 1,
+                            bn_blobs[0]->mutable_cpu_data());
+  caffe_rng_uniform<Dtype>(bn_blobs[1]->count(), 0.5, 2,
+                           bn_blobs[1]->mutable_cpu_data());
+  bn_blobs[2]->mutable_cpu_data()[0] = 1;
+  this->net_->ShareTrainedLayersWith(nchw_net.get());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(nchw_net->blob_by_name("data").get());
+  this->net_->blob_by_name("data")->CopyFrom(*nchw_net->blob_by_name("data"));
+  nchw_net->Forward();
+  this->net_->Forward();
+  const char* outputs[] = { "ip", "prob" };
+  for (int j = 0; j < 2; ++j) {
+    const Blob<Dtype>& expected = *nchw_net->blob_by_name(outputs[j]);
+    const Blob<Dtype>& actual = *this->net_->blob_by_name(outputs[j]);
+    ASSERT_EQ(expected.shape(), actual.shape());
+    EXPECT_EQ(NCHW, actual.layout());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i],
+                  1e-4 * std::max(Dtype(1), std::abs(expected.cpu_data()[i])))
+          << outputs[j] << " index " << i;
+    }
+  }
+}
+
 class FilterNetTest : public ::testing::Test {
  protected:
   void RunFilterNetTest(
@@ -0,0 +1,145 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_session.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class NetSessionTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitNetFromProtoString(const string& proto) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+    session_.reset(new NetSession<Dtype>(net_));
+  }
+
+  // An expensive trunk on the image, concatenated with the scribbles.
+  virtual void InitClickNet() {
+    const string& proto =
+        "name: 'ClickNetwork' "
+        "layer { name: 'image' type: 'Input' top: 'image' "
+        "  input_param { shape: { dim: 1 dim: 2 dim: 5 dim: 5 } } } "
+        "layer { name: 'scribble' type: 'Input' top: 'scribble' "
+        "  input_param { shape: { dim: 1 dim: 1 dim: 5 dim: 5 } } } "
+        "layer { name: 'trunk' type: 'Convolution' "
+        "  bottom: 'image' top: 'trunk' "
+        "  convolution_param { num_output: 3 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'relu' type: 'ReLU' bottom: 'trunk' top: 'trunk' } "
+        "layer { name: 'concat' type: 'Concat' "
+        "  bottom: 'trunk' bottom: 'scribble' top: 'concat' } "
+        "layer { name: 'head' type: 'Convolution' "
+        "  bottom: 'concat' top: 'head' "
+        "  convolution_param { num_output: 2 kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } ";
+    InitNetFromProtoString(proto);
+  }
+
+  // The gain is applied in place on the trunk output.
+  virtual void InitInPlaceNet() {
+    const string& proto =
+        "name: 'InPlaceNetwork' "
+        "layer { name: 'image' type: 'Input' top: 'image' "
+        "  input_param { shape: { dim: 1 dim: 2 dim: 5 dim: 5 } } } "
+        "layer { name: 'gain' type: 'Input' top: 'gain' "
+        "  input_param { shape: { dim: 3 } } } "
+        "layer { name: 'trunk' type: 'Convolution' "
+        "  bottom: 'image' top: 'trunk' "
+        "  convolution_param { num_output: 3 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } } } "
+        "layer { name: 'scale' type: 'Scale' "
+        "  bottom: 'trunk' bottom: 'gain' top: 'trunk' } ";
+    InitNetFromProtoString(proto);
+  }
+
+  void FillBlob(const string& name) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(net_->blob_by_name(name).get());
+  }
+
+  // Checks the session output against a full forward pass of the net.
+  void CheckAgainstFullForward(const string& output) {
+    Blob<Dtype> cached;
+    cached.CopyFrom(*net_->blob_by_name(output), false, true);
+    net_->Forward();
+    const Blob<Dtype>* expected = net_->blob_by_name(output).get();
+    for (int i = 0; i < expected->count(); ++i) {
+      EXPECT_EQ(expected->cpu_data()[i], cached.cpu_data()[i]);
+    }
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+  shared_ptr<NetSession<Dtype> > session_;
+};
+
+TYPED_TEST_CASE(NetSessionTest, TestDtypesAndDevices);
+
+TYPED_TEST(NetSessionTest, TestRunsOnlyChangedBranch) {
+  this->InitClickNet();
+  this->FillBlob("image");
+  this->FillBlob("scribble");
+  this->session_->Forward();
+  EXPECT_EQ(6, this->session_->last_run_layers().size());
+  this->CheckAgainstFullForward("head");
+
+  // Nothing changed: nothing runs.
+  this->session_->Forward();
+  EXPECT_EQ(0, this->session_->last_run_layers().size());
+
+  this->FillBlob("scribble");
+  this->session_->Forward();
+  const vector<int>& run = this->session_->last_run_layers();
+  ASSERT_EQ(2, run.size());
+  EXPECT_EQ("concat", this->net_->layer_names()[run[0]]);
+  EXPECT_EQ("head", this->net_->layer_names()[run[1]]);
+  this->CheckAgainstFullForward("head");
+
+  // Full forward left the activations intact; a new image reruns the trunk.
+  this->FillBlob("image");
+  this->session_->Forward();
+  EXPECT_EQ(4, this->session_->last_run_layers().size());
+  this->CheckAgainstFullForward("head");
+}
+
+TYPED_TEST(NetSessionTest, TestMarkChangedAndInvalidate) {
+  this->InitClickNet();
+  this->FillBlob("image");
+  this->FillBlob("scribble");
+  this->session_->Forward();
+  this->session_->MarkChanged("concat");
+  this->session_->Forward();
+  ASSERT_EQ(1, this->session_->last_run_layers().size());
+  EXPECT_EQ("head", this->net_->layer_names()[
+      this->session_->last_run_layers()[0]]);
+  this->session_->Invalidate();
+  this->session_->Forward();
+  EXPECT_EQ(6, this->session_->last_run_layers().size());
+}
+
+TYPED_TEST(NetSessionTest, TestInPlaceOverUnchangedBlob) {
+  this->InitInPlaceNet();
+  this->FillBlob("image");
+  this->FillBlob("gain");
+  this->session_->Forward();
+  this->FillBlob("gain");
+  this->session_->Forward();
+  // The scale overwrote the trunk output, so the trunk has to run again.
+  EXPECT_EQ(2, this->session_->last_run_layers().size());
+  this->CheckAgainstFullForward("trunk");
+}
+
+}  // namespace caffe
@@ -0,0 +1,131 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/quantize.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class GemmS8Test : public ::testing::Test {};
+
+TEST_F(GemmS8Test, TestGemm) {
+  // More columns than one block of the kernel, and a partial row block.
+  const int M = 6, N = 300, K = 7;
+  vector<int8_t> A(M * K), B(K * N), B_transposed(N * K);
+  for (int i = 0; i < A.size(); ++i) {
+    A[i] = static_cast<int8_t>((i * 37) % 255 - 127);
+  }
+  for (int k = 0; k < K; ++k) {
+    for (int n = 0; n < N; ++n) {
+      B[k * N + n] = static_cast<int8_t>((k * 101 + n * 13) % 255 - 127);
+      B_transposed[n * K + k] = B[k * N + n];
+    }
+  }
+  vector<int32_t> C(M * N), C_transposed(M * N);
+  caffe_cpu_gemm_s8(CblasNoTrans, M, N, K, &A[0], &B[0], &C[0]);
+  caffe_cpu_gemm_s8(CblasTrans, M, N, K, &A[0], &B_transposed[0],
+                    &C_transposed[0]);
+  for (int m = 0; m < M; ++m) {
+    for (int n = 0; n < N; ++n) {
+      int32_t expected = 0;
+      for (int k = 0; k < K; ++k) {
+        expected += A[m * K + k] * B[k * N + n];
+      }
+      EXPECT_EQ(expected, C[m * N + n]);
+      EXPECT_EQ(expected, C_transposed[m * N + n]);
+    }
+  }
+}
+
+template <typename TypeParam>
+class QuantizeTest : public CPUDeviceTest<TypeParam> {};
+
+TYPED_TEST_CASE(QuantizeTest, TestDtypes);
+
+TYPED_TEST(QuantizeTest, TestQuantizeRows) {
+  const int rows = 3, cols = 50;
+  vector<TypeParam> w(rows * cols);
+  for (int j = 0; j < cols; ++j) {
+    w[j] = std::sin(TypeParam(j));
+    w[cols + j] = 100 * std::cos(TypeParam(j));
+    w[2 * cols + j] = 0;
+  }
+  vector<int8_t> q(rows * cols);
+  vector<TypeParam> scales(rows);
+  caffe_cpu_quantize_rows(rows, cols, &w[0], &q[0], &scales[0]);
+  for (int i = 0; i < 2; ++i) {
+    const TypeParam amax = caffe_cpu_amax(cols, &w[i * cols]);
+    EXPECT_NEAR(amax / kInt8Max, scales[i], 1e-6 * amax);
+    int qmax = 0;
+    for (int j = 0; j < cols; ++j) {
+      qmax = std::max(qmax, std::abs(static_cast<int>(q[i * cols + j])));
+      // Rounding errs by at most half a step.
+      EXPECT_NEAR(w[i * cols + j], scales[i] * q[i * cols + j],
+          scales[i] * 0.5001);
+    }
+    EXPECT_EQ(kInt8Max, qmax);
+  }
+  EXPECT_EQ(0, scales[2]);
+  for (int j = 0; j < cols; ++j) {
+    EXPECT_EQ(0, q[2 * cols + j]);
+  }
+}
+
+TYPED_TEST(QuantizeTest, TestQuantizeClips) {
+  const TypeParam x[] = { -3, -1, -0.26, 0, 0.26, 1, 3 };
+  int8_t q[7];
+  caffe_cpu_quantize(7, TypeParam(kInt8Max), x, q);
+  const int expected[] = { -127, -127, -33, 0, 33, 127, 127 };
+  for (int i = 0; i < 7; ++i) {
+    EXPECT_EQ(expected[i], q[i]);
+  }
+}
+
+TYPED_TEST(QuantizeTest, TestCalibrate) {
+  typedef TypeParam Dtype;
+  const string proto =
+      "name: 'TinyNet' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 5 dim: 5 } } } "
+      "layer { name: 'conv' type: 'Convolution' bottom: 'data' top: 'conv' "
+      "  convolution_param { num_output: 4 kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' } } } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'conv' top: 'conv' } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv' top: 'ip' "
+      "  inner_product_param { num_output: 2 "
+      "    weight_filler { type: 'gaussian' } } } ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* data = net.blob_by_name("data").get();
+  filler.Fill(data);
+  NetParameter param_calibrated;
+  EXPECT_EQ(2, CalibrateQuantization(param, &net, 2, &param_calibrated));
+  ASSERT_EQ(4, param_calibrated.layer_size());
+  EXPECT_FALSE(param_calibrated.layer(0).has_quantization_param());
+  EXPECT_FLOAT_EQ(caffe_cpu_amax(data->count(), data->cpu_data()),
+      param_calibrated.layer(1).quantization_param().input_range());
+  EXPECT_FALSE(param_calibrated.layer(2).has_quantization_param());
+  // The inner product reads the convolution after the ReLU.
+  const Blob<Dtype>* conv = net.blob_by_name("conv").get();
+  EXPECT_FLOAT_EQ(caffe_cpu_amax(conv->count(), conv->cpu_data()),
+      param_calibrated.layer(3).quantization_param().input_range());
+  for (int i = 0; i < conv->count(); ++i) {
+    EXPECT_GE(conv->cpu_data()[i], 0);
+  }
+}
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -74,6 +75,45 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Several tiles of positions with a partial one, a single position per
+  // row of channels, and a single channel.
+  const int shapes[][3] = { { 2, 5, 700 }, { 300, 7, 1 }, { 3, 1, 4 } };
+  for (int s = 0; s < 3; ++s) {
+    vector<int> shape(shapes[s], shapes[s] + 3);
+    this->blob_bottom_->Reshape(shape);
+    FillerParameter filler_param;
+    filler_param.set_std(10);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    LayerParameter layer_param;
+    SoftmaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const int channels = shape[1], inner_num = shape[2];
+    for (int i = 0; i < shape[0]; ++i) {
+      for (int k = 0; k < inner_num; ++k) {
+        const int offset = i * channels * inner_num + k;
+        Dtype max = bottom_data[offset];
+        for (int j = 1; j < channels; ++j) {
+          max = std::max(max, bottom_data[offset + j * inner_num]);
+        }
+        Dtype sum = 0;
+        for (int j = 0; j < channels; ++j) {
+          sum += exp(bottom_data[offset + j * inner_num] - max);
+        }
+        for (int j = 0; j < channels; ++j) {
+          EXPECT_NEAR(exp(bottom_data[offset + j * inner_num] - max) / sum,
+                      top_data[offset + j * inner_num], 1e-6);
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(SoftmaxLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -83,6 +123,22 @@ TYPED_TEST(SoftmaxLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestGradientSinglePosition) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> shape(2);
+  shape[0] = 3;
+  shape[1] = 6;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  SoftmaxLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNSoftmaxLayerTest : public GPUDeviceTest<Dtype> {
@@ -0,0 +1,110 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/sparse.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class SparseTest : public CPUDeviceTest<TypeParam> {
+ protected:
+  // A rows x cols matrix of which about sparsity of the entries are zeros.
+  vector<TypeParam> RandomMatrix(int rows, int cols, TypeParam sparsity) {
+    vector<TypeParam> a(rows * cols), keep(rows * cols);
+    caffe_rng_gaussian<TypeParam>(a.size(), 0, 1, &a[0]);
+    caffe_rng_uniform<TypeParam>(keep.size(), 0, 1, &keep[0]);
+    for (int i = 0; i < a.size(); ++i) {
+      a[i] = keep[i] < sparsity ? TypeParam(0) : a[i];
+    }
+    return a;
+  }
+};
+
+TYPED_TEST_CASE(SparseTest, TestDtypes);
+
+TYPED_TEST(SparseTest, TestToSparse) {
+  const TypeParam a[] = { 0, 1, -0.25, 0,
+                          0, 0, 0, 0,
+                          3, 0, 0.5, -2 };
+  SparseMatrix<TypeParam> s;
+  caffe_cpu_to_sparse(3, 4, a, TypeParam(0.25), &s);
+  EXPECT_EQ(3, s.rows);
+  EXPECT_EQ(4, s.cols);
+  const int row_begin[] = { 0, 1, 1, 4 };
+  const int col[] = { 1, 0, 2, 3 };
+  const TypeParam values[] = { 1, 3, 0.5, -2 };
+  for (int r = 0; r <= 3; ++r) {
+    EXPECT_EQ(row_begin[r], s.row_begin[r]);
+  }
+  ASSERT_EQ(4, s.nnz());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(col[i], s.col[i]);
+    EXPECT_EQ(values[i], s.values[i]);
+  }
+  EXPECT_NEAR(8. / 12, s.sparsity(), 1e-12);
+}
+
+TYPED_TEST(SparseTest, TestGemm) {
+  const int M = 37, N = 45, K = 60;
+  const vector<TypeParam> A = this->RandomMatrix(M, K, 0.8);
+  const vector<TypeParam> B = this->RandomMatrix(K, N, 0);
+  SparseMatrix<TypeParam> sparse_A;
+  caffe_cpu_to_sparse(M, K, &A[0], TypeParam(0), &sparse_A);
+  vector<TypeParam> expected(M * N), C(M * N, TypeParam(7));
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasNoTrans, M, N, K, 1., &A[0],
+                            &B[0], 0., &expected[0]);
+  caffe_cpu_sparse_gemm(sparse_A, N, &B[0], &C[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected[i], C[i], 1e-4);
+  }
+}
+
+TYPED_TEST(SparseTest, TestGemmTrans) {
+  const int M = 5, N = 33, K = 70;
+  const vector<TypeParam> A = this->RandomMatrix(N, K, 0.9);
+  const vector<TypeParam> B = this->RandomMatrix(M, K, 0);
+  SparseMatrix<TypeParam> sparse_A;
+  caffe_cpu_to_sparse(N, K, &A[0], TypeParam(0), &sparse_A);
+  vector<TypeParam> expected(M * N), C(M * N, TypeParam(7));
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasTrans, M, N, K, 1., &B[0],
+                            &A[0], 0., &expected[0]);
+  caffe_cpu_sparse_gemm_trans(M, &B[0], sparse_A, &C[0]);
+  for (int i = 0; i < M * N; ++i) {
+    EXPECT_NEAR(expected[i], C[i], 1e-4);
+  }
+}
+
+TYPED_TEST(SparseTest, TestSparsifyBlobProto) {
+  const TypeParam sparsities[] = { 0.9, 0, 1 };
+  for (int s = 0; s < 3; ++s) {
+    vector<int> shape(2);
+    shape[0] = 20;
+    shape[1] = 30;
+    Blob<TypeParam> blob(shape);
+    const vector<TypeParam> data =
+        this->RandomMatrix(shape[0], shape[1], sparsities[s]);
+    caffe_copy(blob.count(), &data[0], blob.mutable_cpu_data());
+    BlobProto proto;
+    blob.ToProto(&proto);
+    const int dense_size = proto.ByteSize();
+    SparsifyBlobProto(&proto);
+    // Dense values stay as they are; mostly zeros take less space.
+    EXPECT_EQ(s != 1, proto.zero_run_size() > 0);
+    EXPECT_LE(proto.ByteSize(), s == 1 ? dense_size : dense_size / 4);
+    Blob<TypeParam> copy;
+    copy.FromProto(proto);
+    ASSERT_TRUE(copy.shape() == blob.shape());
+    for (int i = 0; i < blob.count(); ++i) {
+      EXPECT_EQ(blob.cpu_data()[i], copy.cpu_data()[i]);
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,99 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  ThreadPoolTest() : initial_threads_(Caffe::cpu_threads()) {}
+  virtual ~ThreadPoolTest() { Caffe::set_cpu_threads(initial_threads_); }
+
+  const int initial_threads_;
+};
+
+// Counts the visits of every index in its chunk.
+struct CountVisits {
+  std::vector<int>* visits;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      ++(*visits)[i];
+    }
+  }
+};
+
+// Sums 1 / (i + 1), which rounds differently in every order of summation.
+struct SumReciprocals {
+  float operator()(int begin, int end) const {
+    float sum = 0;
+    for (int i = begin; i < end; ++i) {
+      sum += 1.f / (i + 1);
+    }
+    return sum;
+  }
+};
+
+struct Add {
+  float operator()(float a, float b) const { return a + b; }
+};
+
+// Runs an inner parallel loop over the row of every index.
+struct NestedLoop {
+  int width;
+  std::vector<int>* visits;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      std::vector<int> row(width, 0);
+      const CountVisits inner = { &row };
+      parallel_for(0, width, 1, inner);
+      for (int j = 0; j < width; ++j) {
+        (*visits)[i * width + j] += row[j];
+      }
+    }
+  }
+};
+
+TEST_F(ThreadPoolTest, TestParallelForCoversRange) {
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    Caffe::set_cpu_threads(num_threads);
+    std::vector<int> visits(1003, 0);
+    const CountVisits body = { &visits };
+    parallel_for(3, 1000, 7, body);
+    for (int i = 0; i < visits.size(); ++i) {
+      EXPECT_EQ(i >= 3 && i < 1000 ? 1 : 0, visits[i])
+          << "index " << i << " with " << num_threads << " threads";
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestParallelReduceIsDeterministic) {
+  Caffe::set_cpu_threads(1);
+  const float expected =
+      parallel_reduce(0, 100000, 1000, 0.f, SumReciprocals(), Add());
+  for (int num_threads = 2; num_threads <= 4; ++num_threads) {
+    Caffe::set_cpu_threads(num_threads);
+    EXPECT_EQ(expected,
+        parallel_reduce(0, 100000, 1000, 0.f, SumReciprocals(), Add()));
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNestedParallelFor) {
+  Caffe::set_cpu_threads(3);
+  const int height = 17;
+  const int width = 23;
+  std::vector<int> visits(height * width, 0);
+  const NestedLoop body = { width, &visits };
+  parallel_for(0, height, 1, body);
+  for (int i = 0; i < visits.size(); ++i) {
+    EXPECT_EQ(1, visits[i]) << "index " << i;
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,139 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class VectorMathTest : public ::testing::Test {
+ protected:
+  VectorMathTest() : initial_isa_(caffe_simd_isa()) {
+    // Values across the whole range, with a length that leaves a tail.
+    for (int i = -400; i <= 400; ++i) {
+      x_.push_back(i / 4.f + 0.013f * (i % 7));
+    }
+    for (int i = -38; i <= 38; ++i) {
+      x_.push_back(3.7f * std::pow(10.f, i));
+    }
+    const float kSpecial[] = { 0.f, -0.f, 1.f, -1.f, 88.7f, -87.3f, 89.f,
+        -104.f, 1e-40f, std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity() };
+    x_.insert(x_.end(), kSpecial, kSpecial + sizeof(kSpecial) / sizeof(float));
+  }
+  virtual ~VectorMathTest() {
+    caffe_simd_set_isa(initial_isa_);
+  }
+
+  // Checks f against ref for every element within max_ulp units in the last
+  // place, for every instruction set, and that each element comes out the
+  // same whether it is computed alone or with the others.
+  void Check(void (*f)(const int, const float*, float*),
+      double (*ref)(double), double max_ulp) {
+    const int n = x_.size();
+    const SimdIsa isas[] = { SIMD_AVX512, SIMD_AVX2, SIMD_BASE };
+    for (int k = 0; k < 3; ++k) {
+      caffe_simd_set_isa(isas[k]);
+      vector<float> y(n);
+      f(n, &x_[0], &y[0]);
+      for (int i = 0; i < n; ++i) {
+        const double expected = ref(x_[i]);
+        if (std::isnan(expected)) {
+          EXPECT_TRUE(std::isnan(y[i])) << x_[i];
+        } else if (std::isinf(static_cast<float>(expected))) {
+          EXPECT_EQ(static_cast<float>(expected), y[i]) << x_[i];
+        } else {
+          int exponent;
+          std::frexp(expected, &exponent);
+          const double ulp = std::ldexp(1., std::max(exponent - 24, -149));
+          EXPECT_LE(std::fabs(y[i] - expected), max_ulp * ulp)
+              << x_[i] << " with " << caffe_simd_isa_name(caffe_simd_isa());
+        }
+        float alone;
+        f(1, &x_[i], &alone);
+        if (!std::isnan(y[i])) {
+          EXPECT_EQ(y[i], alone);
+        }
+      }
+    }
+  }
+
+  const SimdIsa initial_isa_;
+  vector<float> x_;
+};
+
+static double reference_exp(double x) { return std::exp(x); }
+static double reference_log(double x) { return std::log(x); }
+static double reference_tanh(double x) { return std::tanh(x); }
+static double reference_sigmoid(double x) { return 1. / (1. + std::exp(-x)); }
+static double reference_powx(double x) { return std::pow(x, -0.75); }
+static void powx(const int n, const float* x, float* y) {
+  caffe_simd_powx(n, x, -0.75f, y);
+}
+
+TEST_F(VectorMathTest, TestExp) {
+  Check(caffe_simd_exp, reference_exp, 2);
+}
+
+TEST_F(VectorMathTest, TestLog) {
+  Check(caffe_simd_log, reference_log, 2);
+}
+
+TEST_F(VectorMathTest, TestTanh) {
+  Check(caffe_simd_tanh, reference_tanh, 3);
+}
+
+TEST_F(VectorMathTest, TestSigmoid) {
+  Check(caffe_simd_sigmoid, reference_sigmoid, 3);
+}
+
+TEST_F(VectorMathTest, TestPowx) {
+  // |b ln(x)| reaches 66 here.
+  Check(powx, reference_powx, 2 * (1 + 66));
+}
+
+TEST_F(VectorMathTest, TestPowxSpecialCases) {
+  const float x[] = { -2.f, -0.5f, 0.f, 3.f };
+  float y[4];
+  caffe_simd_powx(4, x, 3.f, y);
+  EXPECT_FLOAT_EQ(-8.f, y[0]);
+  EXPECT_FLOAT_EQ(-0.125f, y[1]);
+  EXPECT_EQ(0.f, y[2]);
+  EXPECT_FLOAT_EQ(27.f, y[3]);
+  caffe_simd_powx(4, x, -2.f, y);
+  EXPECT_FLOAT_EQ(0.25f, y[0]);
+  EXPECT_FLOAT_EQ(4.f, y[1]);
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), y[2]);
+  // Negative numbers have no fractional powers.
+  caffe_simd_powx(4, x, 1.5f, y);
+  EXPECT_TRUE(std::isnan(y[0]));
+  EXPECT_TRUE(std::isnan(y[1]));
+  EXPECT_EQ(0.f, y[2]);
+  // The common powers are exact.
+  caffe_simd_powx(4, x, 2.f, y);
+  EXPECT_EQ(4.f, y[0]);
+  EXPECT_EQ(9.f, y[3]);
+  caffe_simd_powx(4, x, 0.5f, y);
+  EXPECT_EQ(std::sqrt(3.f), y[3]);
+  caffe_simd_powx(4, x, 0.f, y);
+  EXPECT_EQ(1.f, y[0]);
+  EXPECT_EQ(1.f, y[2]);
+}
+
+TEST_F(VectorMathTest, TestInPlace) {
+  vector<float> y(x_);
+  caffe_exp(y.size(), &y[0], &y[0]);
+  vector<float> expected(x_.size());
+  caffe_exp(x_.size(), &x_[0], &expected[0]);
+  for (int i = 0; i < y.size(); ++i) {
+    EXPECT_EQ(expected[i], y[i]);
+  }
+}
+
+}  // namespace caffe
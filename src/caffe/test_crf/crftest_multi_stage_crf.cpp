@@ -0,0 +1,108 @@
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/crf_layers/multi_stage_crf_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class MultiStageCRFLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ public:
+  MultiStageCRFLayerTest()
+      : blob_image_(new Blob<Dtype>(1, 3, 6, 6)),
+    blob_unary_(new Blob<Dtype>(1, 3, 6, 6)),
+    blob_pre_pairwise_(new Blob<Dtype>(1, 3, 6, 6)) {};
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    filler_param.set_min(-1);
+    filler_param.set_max(1);
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_image_);
+    filler.Fill(blob_unary_);
+    filler.Fill(blob_pre_pairwise_);
+    blob_bottom_vec_.push_back(blob_image_);
+    blob_bottom_vec_.push_back(blob_unary_);
+    blob_bottom_vec_.push_back(blob_pre_pairwise_);
+  }
+
+  virtual ~MultiStageCRFLayerTest() {
+    delete blob_image_;
+    delete blob_unary_;
+    delete blob_pre_pairwise_;
+  }
+
+  // Runs forward and backward with a fixed top diff, then keeps copies of
+  // the output, the bottom diffs and the parameter diffs.
+  void RunForwardBackward(bool checkpoint, vector<shared_ptr<Blob<Dtype> > >* results)
+  {
+    LayerParameter layer_param;
+    MultiStageCRFParameter* crf_param = layer_param.mutable_multi_stage_crf_param();
+    crf_param->set_kernel_size(3);
+    crf_param->set_num_iterations(4);
+    crf_param->set_feature_length(3);
+    crf_param->set_pair_wise_potential_type(MultiStageCRFParameter_PairwisePotentialType_BILATERAL_GAUSSIAN);
+    crf_param->set_checkpoint_iterations(checkpoint);
+    Blob<Dtype> top;
+    vector<Blob<Dtype>*> top_vec(1, &top);
+    MultiStageCRFLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, top_vec);
+    layer.Forward(blob_bottom_vec_, top_vec);
+    Dtype* top_diff = top.mutable_cpu_diff();
+    for (int i = 0; i < top.count(); ++i) {
+      top_diff[i] = Dtype(i % 7) / 7 - Dtype(0.5);
+    }
+    for (int i = 0; i < blob_bottom_vec_.size(); ++i) {
+      caffe_set(blob_bottom_vec_[i]->count(), Dtype(0), blob_bottom_vec_[i]->mutable_cpu_diff());
+    }
+    vector<bool> propagate_down(3, true);
+    layer.Backward(top_vec, propagate_down, blob_bottom_vec_);
+
+    results->clear();
+    results->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    results->back()->CopyFrom(top, false, true);
+    for (int i = 0; i < 2; ++i) {
+      results->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      results->back()->CopyFrom(*blob_bottom_vec_[i], true, true);
+    }
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      results->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      results->back()->CopyFrom(*layer.blobs()[i], true, true);
+    }
+  }
+
+  Blob<Dtype>* const blob_image_;
+  Blob<Dtype>* const blob_unary_;
+  Blob<Dtype>* const blob_pre_pairwise_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+};
+
+TYPED_TEST_CASE(MultiStageCRFLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(MultiStageCRFLayerTest, TestCheckpointMatchesFullBackward) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<shared_ptr<Blob<Dtype> > > expected;
+  this->RunForwardBackward(false, &expected);
+  vector<shared_ptr<Blob<Dtype> > > checkpointed;
+  this->RunForwardBackward(true, &checkpointed);
+
+  ASSERT_EQ(expected.size(), checkpointed.size());
+  // the output, then the diffs of the image, the unaries and the parameters
+  for (int i = 0; i < expected.size(); ++i) {
+    const int count = expected[i]->count();
+    const Dtype* expected_values = (i == 0) ? expected[i]->cpu_data() : expected[i]->cpu_diff();
+    const Dtype* values = (i == 0) ? checkpointed[i]->cpu_data() : checkpointed[i]->cpu_diff();
+    for (int j = 0; j < count; ++j) {
+      EXPECT_NEAR(expected_values[j], values[j], 1e-5) << "blob " << i << " index " << j;
+    }
+  }
+}
+
+}  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/crf_layers/pairwise_function_freeform_layer.hpp"
+#include "caffe/util/io.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -171,6 +172,54 @@ TYPED_TEST(PairwiseFunctionFreeformLayerTest, PairwiseFuncionForward) {
 //    print_blob(this->blob_top_, false);
 }
 
+TYPED_TEST(PairwiseFunctionFreeformLayerTest, FusedForwardFromBinaryParams) {
+    typedef typename TypeParam::Dtype Dtype;
+    LayerParameter layer_param;
+    MultiStageCRFParameter* crf_param =
+    layer_param.mutable_multi_stage_crf_param();
+    crf_param->set_pair_wise_potential_type(MultiStageCRFParameter_PairwisePotentialType_FREEFORM_FUNCTION);
+    crf_param->mutable_pairwise_potential_net_size()->Add(4);
+    crf_param->mutable_pairwise_potential_net_size()->Add(64);
+    crf_param->mutable_pairwise_potential_net_size()->Add(32);
+    crf_param->mutable_pairwise_potential_net_size()->Add(1);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->GetBlobBottom());
+    
+    // reference: the TRAIN phase layer runs the convolution/ReLU stack
+    shared_ptr<Layer<Dtype> > layer(
+                                    new PairwiseFunctionFreeformLayer<Dtype>(layer_param));
+    layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> ref_top;
+    ref_top.CopyFrom(*this->GetBlobTop(), false, true);
+    
+    // store its parameters as binary protos and load them into a TEST
+    // phase layer, which runs the fused kernel
+    string param_dir;
+    MakeTempDir(&param_dir);
+    for(int i=0; i<3; i++)
+    {
+        std::ostringstream ss;
+        ss << i;
+        BlobProto w_proto, b_proto;
+        layer->blobs()[2*i]->ToProto(&w_proto);
+        layer->blobs()[2*i+1]->ToProto(&b_proto);
+        WriteProtoToBinaryFile(w_proto, param_dir + "/w" + ss.str() + ".binaryproto");
+        WriteProtoToBinaryFile(b_proto, param_dir + "/b" + ss.str() + ".binaryproto");
+    }
+    crf_param->set_pairwise_potential_net_param_path(param_dir);
+    layer_param.set_phase(TEST);
+    shared_ptr<Layer<Dtype> > fused_layer(
+                                    new PairwiseFunctionFreeformLayer<Dtype>(layer_param));
+    fused_layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    fused_layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for(int i=0; i<ref_top.count(); i++)
+    {
+        EXPECT_NEAR(this->GetBlobTop()->cpu_data()[i], ref_top.cpu_data()[i], 1e-4);
+    }
+}
+
 //TYPED_TEST(PairwiseFeatureLayerTest, PairwiseFeatureBackward) {
 //    typedef typename TypeParam::Dtype Dtype;
 //    LayerParameter layer_param;
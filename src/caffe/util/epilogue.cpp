@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/epilogue.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Elements whose exponentials are taken at once, in a buffer on the stack.
+const int kEpilogueBlock = 256;
+
+template <typename Dtype>
+Epilogue<Dtype>::Epilogue()
+    : residual_(NULL), coeff_(1), residual_coeff_(1),
+      propagate_residual_(false), activation_type_(NONE), slope_(0),
+      channels_(1), dim_(1) {}
+
+template <typename Dtype>
+bool Epilogue<Dtype>::CanFuseActivation(const LayerParameter& param,
+    bool backward) {
+  if (param.bottom_size() != 1 || param.top_size() != 1 ||
+      param.loss_weight_size() > 0) {
+    return false;
+  }
+  const string& type = param.type();
+  if (type == "ReLU") {
+    return !backward || param.relu_param().negative_slope() >= 0;
+  }
+  if (type == "ELU") {
+    return !backward || param.elu_param().alpha() >= 0;
+  }
+  if (type == "PReLU") {
+    return !backward;
+  }
+  return type == "Sigmoid" || type == "TanH";
+}
+
+template <typename Dtype>
+void Epilogue<Dtype>::set_residual(Blob<Dtype>* residual, Dtype coeff,
+    Dtype residual_coeff, bool propagate_down) {
+  residual_ = residual;
+  coeff_ = coeff;
+  residual_coeff_ = residual_coeff;
+  propagate_residual_ = propagate_down;
+}
+
+template <typename Dtype>
+void Epilogue<Dtype>::set_activation(
+    const shared_ptr<Layer<Dtype> >& activation) {
+  activation_ = activation;
+  const string type = activation->type();
+  if (type == "ReLU") {
+    activation_type_ = RELU;
+    slope_ = activation->layer_param().relu_param().negative_slope();
+  } else if (type == "ELU") {
+    activation_type_ = ELU;
+    slope_ = activation->layer_param().elu_param().alpha();
+  } else if (type == "PReLU") {
+    activation_type_ = PRELU;
+  } else if (type == "Sigmoid") {
+    activation_type_ = SIGMOID;
+  } else if (type == "TanH") {
+    activation_type_ = TANH;
+  } else {
+    LOG(FATAL) << "Activation " << type << " cannot run in an epilogue.";
+  }
+}
+
+template <typename Dtype>
+void Epilogue<Dtype>::Reshape(const Blob<Dtype>& top) {
+  if (residual_) {
+    CHECK(residual_->shape() == top.shape())
+        << "The residual must have the shape of the output, "
+        << top.shape_string() << " but got " << residual_->shape_string();
+  }
+  channels_ = top.num_axes() > 1 ? top.shape(1) : 1;
+  dim_ = top.count(std::min(2, top.num_axes()));
+}
+
+template <typename Dtype>
+void Epilogue<Dtype>::Forward_cpu(int offset, int count,
+    Dtype* top_data) const {
+  if (residual_) {
+    const Dtype* residual_data = residual_->cpu_data() + offset;
+    for (int i = 0; i < count; ++i) {
+      top_data[i] = coeff_ * top_data[i] + residual_coeff_ * residual_data[i];
+    }
+  }
+  switch (activation_type_) {
+  case RELU:
+    for (int i = 0; i < count; ++i) {
+      top_data[i] = std::max(top_data[i], Dtype(0))
+          + slope_ * std::min(top_data[i], Dtype(0));
+    }
+    break;
+  case PRELU: {
+    const Dtype* slope_data = activation_->blobs()[0]->cpu_data();
+    const bool channel_shared = activation_->blobs()[0]->count() == 1;
+    for (int i = 0; i < count; ++i) {
+      const int c = channel_shared ? 0 : (offset + i) / dim_ % channels_;
+      top_data[i] = std::max(top_data[i], Dtype(0))
+          + slope_data[c] * std::min(top_data[i], Dtype(0));
+    }
+    break;
+  }
+  case ELU: {
+    // As ELULayer computes it, so that fusing does not change the output.
+    Dtype exp_negative[kEpilogueBlock];
+    for (int begin = 0; begin < count; begin += kEpilogueBlock) {
+      const int n = std::min(kEpilogueBlock, count - begin);
+      Dtype* y = top_data + begin;
+      for (int i = 0; i < n; ++i) {
+        exp_negative[i] = std::min(y[i], Dtype(0));
+      }
+      caffe_exp(n, exp_negative, exp_negative);
+      for (int i = 0; i < n; ++i) {
+        y[i] = std::max(y[i], Dtype(0))
+            + slope_ * (exp_negative[i] - Dtype(1));
+      }
+    }
+    break;
+  }
+  case SIGMOID:
+    caffe_sigmoid(count, top_data, top_data);
+    break;
+  case TANH:
+    caffe_tanh(count, top_data, top_data);
+    break;
+  case NONE:
+    break;
+  }
+}
+
+template <typename Dtype>
+void Epilogue<Dtype>::Backward_cpu(Blob<Dtype>* top) const {
+  const int count = top->count();
+  const Dtype* top_data = top->cpu_data();
+  Dtype* top_diff = top->mutable_cpu_diff();
+  switch (activation_type_) {
+  case RELU:
+    for (int i = 0; i < count; ++i) {
+      top_diff[i] *= (top_data[i] > 0) + slope_ * (top_data[i] <= 0);
+    }
+    break;
+  case ELU:
+    for (int i = 0; i < count; ++i) {
+      top_diff[i] *= (top_data[i] > 0) + (slope_ + top_data[i])
+          * (top_data[i] <= 0);
+    }
+    break;
+  case SIGMOID:
+    for (int i = 0; i < count; ++i) {
+      top_diff[i] *= top_data[i] * (1. - top_data[i]);
+    }
+    break;
+  case TANH:
+    for (int i = 0; i < count; ++i) {
+      top_diff[i] *= 1 - top_data[i] * top_data[i];
+    }
+    break;
+  case PRELU:
+    LOG(FATAL) << "A PReLU epilogue has no backward.";
+    break;
+  case NONE:
+    break;
+  }
+  if (residual_) {
+    if (propagate_residual_) {
+      caffe_cpu_scale(count, residual_coeff_, top_diff,
+                      residual_->mutable_cpu_diff());
+    }
+    if (coeff_ != Dtype(1)) {
+      caffe_scal(count, coeff_, top_diff);
+    }
+  }
+}
+
+#ifndef CPU_ONLY
+template <typename Dtype>
+void Epilogue<Dtype>::Forward_gpu(Blob<Dtype>* top) const {
+  if (residual_) {
+    caffe_gpu_axpby(top->count(), residual_coeff_, residual_->gpu_data(),
+                    coeff_, top->mutable_gpu_data());
+  }
+  if (activation_) {
+    const vector<Blob<Dtype>*> top_vec(1, top);
+    activation_->Forward(top_vec, top_vec);
+  }
+}
+
+template <typename Dtype>
+void Epilogue<Dtype>::Backward_gpu(Blob<Dtype>* top) const {
+  if (activation_) {
+    CHECK_NE(activation_type_, PRELU) << "A PReLU epilogue has no backward.";
+    const vector<Blob<Dtype>*> top_vec(1, top);
+    activation_->Backward(top_vec, vector<bool>(1, true), top_vec);
+  }
+  if (residual_) {
+    const int count = top->count();
+    if (propagate_residual_) {
+      caffe_gpu_scale(count, residual_coeff_, top->gpu_diff(),
+                      residual_->mutable_gpu_diff());
+    }
+    if (coeff_ != Dtype(1)) {
+      caffe_gpu_scal(count, coeff_, top->mutable_gpu_diff());
+    }
+  }
+}
+#else
+template <typename Dtype>
+void Epilogue<Dtype>::Forward_gpu(Blob<Dtype>* top) const { NO_GPU; }
+
+template <typename Dtype>
+void Epilogue<Dtype>::Backward_gpu(Blob<Dtype>* top) const { NO_GPU; }
+#endif
+
+INSTANTIATE_CLASS(Epilogue);
+
+}  // namespace caffe
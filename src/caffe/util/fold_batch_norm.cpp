@@ -0,0 +1,204 @@
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fold_batch_norm.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Whether the outputs of the layer are a linear map of its input with a
+// per-channel bias along axis 1, which a following affine map can fold into.
+static bool IsFoldTarget(const LayerParameter& layer) {
+  if (layer.top_size() != 1 || layer.loss_weight_size() > 0) {
+    return false;
+  }
+  // Shared weights would change for the other owners too.
+  for (int i = 0; i < layer.param_size(); ++i) {
+    if (!layer.param(i).name().empty()) { return false; }
+  }
+  if (layer.type() == "Convolution") {
+    return layer.convolution_param().axis() == 1;
+  }
+  if (layer.type() == "InnerProduct") {
+    return layer.inner_product_param().axis() == 1;
+  }
+  return false;
+}
+
+// Whether the layer computes top = a[c] * bottom + b[c] along axis 1 from its
+// own weights.
+static bool IsChannelAffine(const LayerParameter& layer) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1 ||
+      layer.loss_weight_size() > 0) {
+    return false;
+  }
+  if (layer.type() == "BatchNorm") {
+    const BatchNormParameter& bn_param = layer.batch_norm_param();
+    return !bn_param.has_use_global_stats() || bn_param.use_global_stats();
+  }
+  if (layer.type() == "Scale") {
+    return layer.scale_param().axis() == 1 &&
+        layer.scale_param().num_axes() == 1;
+  }
+  if (layer.type() == "Bias") {
+    return layer.bias_param().axis() == 1 &&
+        layer.bias_param().num_axes() == 1;
+  }
+  return false;
+}
+
+// Reads the per-channel factors a and offsets b of an affine layer.
+template <typename Dtype>
+static void GetChannelAffine(const LayerParameter& layer,
+    const vector<shared_ptr<Blob<Dtype> > >& blobs, vector<double>* a,
+    vector<double>* b) {
+  const int channels = blobs[0]->count();
+  a->assign(channels, 1.);
+  b->assign(channels, 0.);
+  const Dtype* data = blobs[0]->cpu_data();
+  if (layer.type() == "BatchNorm") {
+    const double moving_average = blobs[2]->cpu_data()[0];
+    const double factor = moving_average == 0 ? 0 : 1. / moving_average;
+    const Dtype* variance = blobs[1]->cpu_data();
+    for (int c = 0; c < channels; ++c) {
+      (*a)[c] = 1. / std::sqrt(variance[c] * factor +
+                               layer.batch_norm_param().eps());
+      (*b)[c] = -data[c] * factor * (*a)[c];
+    }
+  } else if (layer.type() == "Scale") {
+    for (int c = 0; c < channels; ++c) {
+      (*a)[c] = data[c];
+      if (layer.scale_param().bias_term()) {
+        (*b)[c] = blobs[1]->cpu_data()[c];
+      }
+    }
+  } else {
+    for (int c = 0; c < channels; ++c) {
+      (*b)[c] = data[c];
+    }
+  }
+}
+
+// Replaces the outputs y[c] of a Convolution or InnerProduct layer by
+// a[c] * y[c] + b[c], adding a bias if it has none.
+template <typename Dtype>
+static void FoldChannelAffine(const vector<double>& a,
+    const vector<double>& b, LayerParameter* layer,
+    vector<shared_ptr<Blob<Dtype> > >* blobs) {
+  const int channels = a.size();
+  Blob<Dtype>* weights = (*blobs)[0].get();
+  Dtype* weight_data = weights->mutable_cpu_data();
+  if (layer->type() == "InnerProduct" &&
+      layer->inner_product_param().transpose()) {
+    // The weights are stored K x N.
+    for (int i = 0; i < weights->count(); ++i) {
+      weight_data[i] *= a[i % channels];
+    }
+  } else {
+    const int size = weights->count() / channels;
+    for (int i = 0; i < weights->count(); ++i) {
+      weight_data[i] *= a[i / size];
+    }
+  }
+  if (blobs->size() == 1) {
+    blobs->push_back(shared_ptr<Blob<Dtype> >(
+        new Blob<Dtype>(vector<int>(1, channels))));
+    caffe_set(channels, Dtype(0), blobs->back()->mutable_cpu_data());
+    if (layer->type() == "Convolution") {
+      layer->mutable_convolution_param()->set_bias_term(true);
+    } else {
+      layer->mutable_inner_product_param()->set_bias_term(true);
+    }
+  }
+  Dtype* bias_data = (*blobs)[1]->mutable_cpu_data();
+  for (int c = 0; c < channels; ++c) {
+    bias_data[c] = a[c] * bias_data[c] + b[c];
+  }
+}
+
+template <typename Dtype>
+int FoldBatchNorm(const NetParameter& param, const Net<Dtype>& net,
+    NetParameter* param_folded) {
+  CHECK_EQ(net.phase(), TEST) << "Only TEST nets can be folded.";
+  NetParameter param_state(param);
+  param_state.mutable_state()->set_phase(TEST);
+  NetParameter filtered;
+  Net<Dtype>::FilterNet(param_state, &filtered);
+
+  // The index of the last layer reading each blob name.
+  map<string, int> last_reader;
+  for (int i = 0; i < filtered.layer_size(); ++i) {
+    for (int j = 0; j < filtered.layer(i).bottom_size(); ++j) {
+      last_reader[filtered.layer(i).bottom(j)] = i;
+    }
+  }
+  param_folded->CopyFrom(filtered);
+  param_folded->clear_layer();
+  // The weights of the kept layers, copied so that the net stays intact.
+  vector<vector<shared_ptr<Blob<Dtype> > > > weights;
+  // The kept layer whose output each blob holds, for the blobs that are the
+  // output of a fold target and were not read since.
+  map<string, int> target_of_blob;
+  int num_folded = 0;
+  for (int i = 0; i < filtered.layer_size(); ++i) {
+    const LayerParameter& layer = filtered.layer(i);
+    const vector<shared_ptr<Blob<Dtype> > >& layer_blobs =
+        net.layer_by_name(layer.name())->blobs();
+    if (IsChannelAffine(layer) && target_of_blob.count(layer.bottom(0))) {
+      const string& bottom = layer.bottom(0);
+      const int target = target_of_blob[bottom];
+      LayerParameter* target_layer = param_folded->mutable_layer(target);
+      const bool in_place = layer.top(0) == bottom;
+      const int num_output = target_layer->type() == "Convolution" ?
+          target_layer->convolution_param().num_output() :
+          target_layer->inner_product_param().num_output();
+      if (layer_blobs[0]->count() == num_output &&
+          (in_place || last_reader[bottom] == i)) {
+        vector<double> a, b;
+        GetChannelAffine(layer, layer_blobs, &a, &b);
+        FoldChannelAffine(a, b, target_layer, &weights[target]);
+        target_of_blob.erase(bottom);
+        target_layer->set_top(0, layer.top(0));
+        target_of_blob[layer.top(0)] = target;
+        ++num_folded;
+        LOG(INFO) << "Folded " << layer.type() << " layer " << layer.name()
+                  << " into " << target_layer->name();
+        continue;
+      }
+    }
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      target_of_blob.erase(layer.bottom(j));
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      target_of_blob.erase(layer.top(j));
+    }
+    LayerParameter* layer_folded = param_folded->add_layer();
+    layer_folded->CopyFrom(layer);
+    weights.push_back(vector<shared_ptr<Blob<Dtype> > >());
+    for (int j = 0; j < layer_blobs.size(); ++j) {
+      weights.back().push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      weights.back().back()->CopyFrom(*layer_blobs[j], false, true);
+    }
+    if (IsFoldTarget(layer)) {
+      target_of_blob[layer.top(0)] = param_folded->layer_size() - 1;
+    }
+  }
+  for (int i = 0; i < param_folded->layer_size(); ++i) {
+    LayerParameter* layer_folded = param_folded->mutable_layer(i);
+    layer_folded->clear_blobs();
+    for (int j = 0; j < weights[i].size(); ++j) {
+      weights[i][j]->ToProto(layer_folded->add_blobs());
+    }
+  }
+  return num_folded;
+}
+
+template int FoldBatchNorm<float>(const NetParameter& param,
+    const Net<float>& net, NetParameter* param_folded);
+template int FoldBatchNorm<double>(const NetParameter& param,
+    const Net<double>& net, NetParameter* param_folded);
+
+}  // namespace caffe
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Minimum number of elements per parallel chunk of the conversions.
+const int kHalfGrain = 16384;
+// Rows of W and columns of C that caffe_cpu_half_gemm keeps accumulating in
+// registers and L1 while streaming through B.
+const int kHalfGemmRows = 4;
+const int kHalfGemmColumns = 256;
+
+template <typename Dtype>
+static void to_half(StoragePrecision precision, const int n, const Dtype* x,
+    uint16_t* y) {
+  if (precision == BFLOAT16) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = float_to_bf16(static_cast<float>(x[i]));
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = float_to_fp16(static_cast<float>(x[i]));
+    }
+  }
+}
+
+template <typename Dtype>
+static void from_half(StoragePrecision precision, const int n,
+    const uint16_t* x, Dtype* y) {
+  if (precision == BFLOAT16) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = bf16_to_float(x[i]);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = fp16_to_float(x[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+struct ToHalfChunk {
+  StoragePrecision precision;
+  const Dtype* x;
+  uint16_t* y;
+
+  void operator()(int begin, int end) const {
+    to_half(precision, end - begin, x + begin, y + begin);
+  }
+};
+
+template <typename Dtype>
+struct FromHalfChunk {
+  StoragePrecision precision;
+  const uint16_t* x;
+  Dtype* y;
+
+  void operator()(int begin, int end) const {
+    from_half(precision, end - begin, x + begin, y + begin);
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_to_half(StoragePrecision precision, const int n,
+    const Dtype* x, uint16_t* y) {
+  CHECK_NE(precision, FULL_PRECISION);
+  const ToHalfChunk<Dtype> body = { precision, x, y };
+  parallel_for(0, n, kHalfGrain, body);
+}
+
+template void caffe_cpu_to_half<float>(StoragePrecision precision,
+    const int n, const float* x, uint16_t* y);
+template void caffe_cpu_to_half<double>(StoragePrecision precision,
+    const int n, const double* x, uint16_t* y);
+
+template <typename Dtype>
+void caffe_cpu_from_half(StoragePrecision precision, const int n,
+    const uint16_t* x, Dtype* y) {
+  CHECK_NE(precision, FULL_PRECISION);
+  const FromHalfChunk<Dtype> body = { precision, x, y };
+  parallel_for(0, n, kHalfGrain, body);
+}
+
+template void caffe_cpu_from_half<float>(StoragePrecision precision,
+    const int n, const uint16_t* x, float* y);
+template void caffe_cpu_from_half<double>(StoragePrecision precision,
+    const int n, const uint16_t* x, double* y);
+
+// Computes the row blocks [begin, end) of C = W * B, kHalfGemmRows rows each.
+// The rows of a block are widened into a packed panel first, so every weight
+// is converted once per call; then every row of B is read once per block and
+// multiplied into all its rows along contiguous columns, which vectorizes.
+template <typename Dtype>
+struct HalfGemm {
+  StoragePrecision precision;
+  int M, N, K;
+  const uint16_t* W;
+  const Dtype* B;
+  Dtype* C;
+
+  void operator()(int begin, int end) const {
+    vector<Dtype> panel(kHalfGemmRows * K);
+    Dtype acc[kHalfGemmRows][kHalfGemmColumns];
+    for (int m = begin * kHalfGemmRows; m < std::min(M, end * kHalfGemmRows);
+         m += kHalfGemmRows) {
+      const int rows = std::min(kHalfGemmRows, M - m);
+      for (int r = 0; r < rows; ++r) {
+        from_half(precision, K, W + (m + r) * K, &panel[r * K]);
+      }
+      for (int n = 0; n < N; n += kHalfGemmColumns) {
+        const int cols = std::min(kHalfGemmColumns, N - n);
+        for (int r = 0; r < rows; ++r) {
+          std::fill(acc[r], acc[r] + cols, Dtype(0));
+        }
+        for (int k = 0; k < K; ++k) {
+          const Dtype* b = B + k * N + n;
+          for (int r = 0; r < rows; ++r) {
+            const Dtype w = panel[r * K + k];
+            Dtype* c = acc[r];
+            for (int j = 0; j < cols; ++j) {
+              c[j] += w * b[j];
+            }
+          }
+        }
+        for (int r = 0; r < rows; ++r) {
+          std::copy(acc[r], acc[r] + cols, C + (m + r) * N + n);
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_half_gemm(StoragePrecision precision, const int M,
+    const int N, const int K, const uint16_t* W, const Dtype* B, Dtype* C) {
+  CHECK_NE(precision, FULL_PRECISION);
+  const HalfGemm<Dtype> body = { precision, M, N, K, W, B, C };
+  parallel_for(0, (M + kHalfGemmRows - 1) / kHalfGemmRows, 1, body);
+}
+
+template void caffe_cpu_half_gemm<float>(StoragePrecision precision,
+    const int M, const int N, const int K, const uint16_t* W, const float* B,
+    float* C);
+template void caffe_cpu_half_gemm<double>(StoragePrecision precision,
+    const int M, const int N, const int K, const uint16_t* W, const double* B,
+    double* C);
+
+// Computes the columns [begin, end) of C = A * W^T. Each row of W is widened
+// once and then dotted with every row of A; both are contiguous along K.
+template <typename Dtype>
+struct HalfGemmTrans {
+  StoragePrecision precision;
+  int M, N, K;
+  const Dtype* A;
+  const uint16_t* W;
+  Dtype* C;
+
+  void operator()(int begin, int end) const {
+    vector<Dtype> w(K);
+    for (int n = begin; n < end; ++n) {
+      from_half(precision, K, W + n * K, &w[0]);
+      for (int m = 0; m < M; ++m) {
+        const Dtype* a = A + m * K;
+        Dtype sum = 0;
+        for (int k = 0; k < K; ++k) {
+          sum += a[k] * w[k];
+        }
+        C[m * N + n] = sum;
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_gemm_half_trans(StoragePrecision precision, const int M,
+    const int N, const int K, const Dtype* A, const uint16_t* W, Dtype* C) {
+  CHECK_NE(precision, FULL_PRECISION);
+  const HalfGemmTrans<Dtype> body = { precision, M, N, K, A, W, C };
+  parallel_for(0, N, kHalfGrain / std::max(M * K, 1) + 1, body);
+}
+
+template void caffe_cpu_gemm_half_trans<float>(StoragePrecision precision,
+    const int M, const int N, const int K, const float* A, const uint16_t* W,
+    float* C);
+template void caffe_cpu_gemm_half_trans<double>(StoragePrecision precision,
+    const int M, const int N, const int K, const double* A,
+    const uint16_t* W, double* C);
+
+}  // namespace caffe
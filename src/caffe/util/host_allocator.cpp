@@ -0,0 +1,123 @@
+#include <boost/thread.hpp>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#include <stdlib.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+const size_t HostAllocator::kAlignment;
+const size_t HostAllocator::kHugePageSize;
+const size_t HostAllocator::kDefaultMaxCachedBytes;
+
+class HostAllocator::sync {
+ public:
+  mutable boost::mutex mutex_;
+};
+
+HostAllocator::HostAllocator(size_t max_cached_bytes, bool huge_pages)
+    : max_cached_bytes_(max_cached_bytes), huge_pages_(huge_pages),
+      sync_(new sync()) {
+  stats_.bytes_in_use = 0;
+  stats_.peak_bytes_in_use = 0;
+  stats_.bytes_cached = 0;
+  stats_.num_allocs = 0;
+  stats_.num_cache_hits = 0;
+}
+
+HostAllocator::~HostAllocator() {
+  ReleaseCache();
+}
+
+size_t HostAllocator::BlockSize(size_t size) const {
+  size_t step = kAlignment;
+  if (max_cached_bytes_ > 0) {
+    // Steps of a quarter of the power of two below size.
+    size_t power = kAlignment;
+    while (power * 2 < size) {
+      power *= 2;
+    }
+    step = std::max(kAlignment, power / 4);
+  }
+  return std::max(kAlignment, (size + step - 1) / step * step);
+}
+
+void* HostAllocator::SystemAllocate(size_t block_size) const {
+  const bool huge = huge_pages_ && block_size >= kHugePageSize;
+  void* ptr = NULL;
+  const int error = posix_memalign(&ptr, huge ? kHugePageSize : kAlignment,
+                                   block_size);
+  CHECK_EQ(0, error) << "host allocation of size " << block_size
+      << " failed";
+#ifdef MADV_HUGEPAGE
+  if (huge) {
+    // Only a hint: the memory works with or without huge pages.
+    madvise(ptr, block_size, MADV_HUGEPAGE);
+  }
+#endif
+  return ptr;
+}
+
+void* HostAllocator::Allocate(size_t size) {
+  const size_t block_size = BlockSize(size);
+  void* ptr = NULL;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    ++stats_.num_allocs;
+    stats_.bytes_in_use += block_size;
+    stats_.peak_bytes_in_use = std::max(stats_.peak_bytes_in_use,
+                                        stats_.bytes_in_use);
+    std::map<size_t, std::vector<void*> >::iterator it =
+        cache_.find(block_size);
+    if (it != cache_.end() && !it->second.empty()) {
+      ptr = it->second.back();
+      it->second.pop_back();
+      stats_.bytes_cached -= block_size;
+      ++stats_.num_cache_hits;
+      return ptr;
+    }
+  }
+  return SystemAllocate(block_size);
+}
+
+void HostAllocator::Free(void* ptr, size_t size) {
+  const size_t block_size = BlockSize(size);
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stats_.bytes_in_use -= block_size;
+    if (stats_.bytes_cached + block_size <= max_cached_bytes_) {
+      cache_[block_size].push_back(ptr);
+      stats_.bytes_cached += block_size;
+      return;
+    }
+  }
+  free(ptr);
+}
+
+void HostAllocator::ReleaseCache() {
+  std::map<size_t, std::vector<void*> > cache;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    cache.swap(cache_);
+    stats_.bytes_cached = 0;
+  }
+  for (std::map<size_t, std::vector<void*> >::iterator it = cache.begin();
+       it != cache.end(); ++it) {
+    for (int i = 0; i < it->second.size(); ++i) {
+      free(it->second[i]);
+    }
+  }
+}
+
+HostAllocator::Stats HostAllocator::stats() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return stats_;
+}
+
+}  // namespace caffe
@@ -1,7 +1,11 @@
+#include <stdint.h>
+
+#include <algorithm>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -15,6 +19,73 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
+// Minimum number of column elements per parallel chunk.
+const int kIm2colGrain = 16384;
+
+// Unrolls the channels [begin, end) of the image. The rows of the column
+// buffer belonging to one channel are contiguous, so the channels can be
+// processed independently. Each row of output_h * output_w columns starts
+// row_stride elements after the previous one.
+template <typename Dtype>
+struct Im2colChannels {
+  const Dtype* data_im;
+  int height, width, kernel_h, kernel_w, pad_h, pad_w;
+  int stride_h, stride_w, dilation_h, dilation_w, output_h, output_w;
+  int row_stride;
+  Dtype* data_col;
+
+  void operator()(int begin, int end) const {
+    const int channel_size = height * width;
+    const int row_gap = row_stride - output_h * output_w;
+    const Dtype* data_im = this->data_im + begin * channel_size;
+    Dtype* data_col = this->data_col + begin * kernel_h * kernel_w * row_stride;
+    for (int channel = end - begin; channel--; data_im += channel_size) {
+      for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++,
+             data_col += row_gap) {
+          int input_row = -pad_h + kernel_row * dilation_h;
+          for (int output_rows = output_h; output_rows; output_rows--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+              for (int output_cols = output_w; output_cols; output_cols--) {
+                *(data_col++) = 0;
+              }
+            } else {
+              int input_col = -pad_w + kernel_col * dilation_w;
+              for (int output_col = output_w; output_col; output_col--) {
+                if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                  *(data_col++) = data_im[input_row * width + input_col];
+                } else {
+                  *(data_col++) = 0;
+                }
+                input_col += stride_w;
+              }
+            }
+            input_row += stride_h;
+          }
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void im2col_strided_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int row_stride, Dtype* data_col) {
+  const int output_h = (height + 2 * pad_h -
+    (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+    (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const Im2colChannels<Dtype> body = { data_im, height, width,
+      kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+      dilation_h, dilation_w, output_h, output_w, row_stride, data_col };
+  const int col_size = kernel_h * kernel_w * output_h * output_w;
+  parallel_for(0, channels, kIm2colGrain / std::max(col_size, 1) + 1, body);
+}
+
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -26,35 +97,22 @@ void im2col_cpu(const Dtype* data_im, const int channels,
     (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-  const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
-            }
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                *(data_col++) = data_im[input_row * width + input_col];
-              } else {
-                *(data_col++) = 0;
-              }
-              input_col += stride_w;
-            }
-          }
-          input_row += stride_h;
-        }
-      }
-    }
-  }
+  im2col_strided_cpu(data_im, channels, height, width, kernel_h, kernel_w,
+      pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      output_h * output_w, data_col);
 }
 
 // Explicit instantiation
+template void im2col_strided_cpu<float>(const float* data_im,
+    const int channels, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_stride, float* data_col);
+template void im2col_strided_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_stride, double* data_col);
 template void im2col_cpu<float>(const float* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
     const int pad_h, const int pad_w, const int stride_h,
@@ -65,6 +123,12 @@ template void im2col_cpu<double>(const double* data_im, const int channels,
     const int pad_h, const int pad_w, const int stride_h,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_col);
+// For the int8 inputs of QuantizedConvolutionLayer.
+template void im2col_cpu<int8_t>(const int8_t* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    int8_t* data_col);
 
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
@@ -159,6 +223,68 @@ template void im2col_nd_cpu<double>(const double* data_im,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, double* data_col);
 
+// Accumulates the column buffer into the channels [begin, end) of the image,
+// which only receive contributions from their own rows of the buffer. Rows
+// are row_stride elements apart, as in Im2colChannels.
+template <typename Dtype>
+struct Col2imChannels {
+  const Dtype* data_col;
+  int height, width, kernel_h, kernel_w, pad_h, pad_w;
+  int stride_h, stride_w, dilation_h, dilation_w, output_h, output_w;
+  int row_stride;
+  Dtype* data_im;
+
+  void operator()(int begin, int end) const {
+    const int channel_size = height * width;
+    const int row_gap = row_stride - output_h * output_w;
+    const Dtype* data_col =
+        this->data_col + begin * kernel_h * kernel_w * row_stride;
+    Dtype* data_im = this->data_im + begin * channel_size;
+    caffe_set((end - begin) * channel_size, Dtype(0), data_im);
+    for (int channel = end - begin; channel--; data_im += channel_size) {
+      for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++,
+             data_col += row_gap) {
+          int input_row = -pad_h + kernel_row * dilation_h;
+          for (int output_rows = output_h; output_rows; output_rows--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+              data_col += output_w;
+            } else {
+              int input_col = -pad_w + kernel_col * dilation_w;
+              for (int output_col = output_w; output_col; output_col--) {
+                if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                  data_im[input_row * width + input_col] += *data_col;
+                }
+                data_col++;
+                input_col += stride_w;
+              }
+            }
+            input_row += stride_h;
+          }
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void col2im_strided_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    const int row_stride, Dtype* data_im) {
+  const int output_h = (height + 2 * pad_h -
+    (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+    (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const Col2imChannels<Dtype> body = { data_col, height, width,
+      kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+      dilation_h, dilation_w, output_h, output_w, row_stride, data_im };
+  const int col_size = kernel_h * kernel_w * output_h * output_w;
+  parallel_for(0, channels, kIm2colGrain / std::max(col_size, 1) + 1, body);
+}
+
 template <typename Dtype>
 void col2im_cpu(const Dtype* data_col, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -166,37 +292,26 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_h, const int stride_w,
     const int dilation_h, const int dilation_w,
     Dtype* data_im) {
-  caffe_set(height * width * channels, Dtype(0), data_im);
   const int output_h = (height + 2 * pad_h -
     (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-  const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            data_col += output_w;
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                data_im[input_row * width + input_col] += *data_col;
-              }
-              data_col++;
-              input_col += stride_w;
-            }
-          }
-          input_row += stride_h;
-        }
-      }
-    }
-  }
+  col2im_strided_cpu(data_col, channels, height, width, kernel_h, kernel_w,
+      pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+      output_h * output_w, data_im);
 }
 
 // Explicit instantiation
+template void col2im_strided_cpu<float>(const float* data_col,
+    const int channels, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_stride, float* data_im);
+template void col2im_strided_cpu<double>(const double* data_col,
+    const int channels, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, const int dilation_h, const int dilation_w,
+    const int row_stride, double* data_im);
 template void col2im_cpu<float>(const float* data_col, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
     const int pad_h, const int pad_w, const int stride_h,
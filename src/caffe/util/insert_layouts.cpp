@@ -0,0 +1,139 @@
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/insert_layouts.hpp"
+
+namespace caffe {
+
+bool LayerSupportsNHWC(const LayerParameter& param) {
+  const string& type = param.type();
+  if (type == "Convolution") {
+    const ConvolutionParameter& conv_param = param.convolution_param();
+    const ConvolutionParameter_Engine engine = conv_param.engine();
+    return !param.has_quantization_param() && conv_param.axis() == 1 &&
+        !conv_param.force_nd_im2col() &&
+        (engine == ConvolutionParameter_Engine_DEFAULT ||
+         engine == ConvolutionParameter_Engine_AUTO ||
+         engine == ConvolutionParameter_Engine_CAFFE);
+  } else if (type == "Pooling") {
+    const PoolingParameter& pool_param = param.pooling_param();
+    return param.top_size() == 1 &&
+        pool_param.engine() != PoolingParameter_Engine_CUDNN &&
+        (pool_param.pool() == PoolingParameter_PoolMethod_MAX ||
+         pool_param.pool() == PoolingParameter_PoolMethod_AVE);
+  } else if (type == "BatchNorm") {
+    return !param.batch_norm_param().has_use_global_stats() ||
+        param.batch_norm_param().use_global_stats();
+  } else if (type == "Scale") {
+    return param.bottom_size() == 1 && param.scale_param().axis() == 1 &&
+        param.scale_param().num_axes() == 1;
+  } else if (type == "Softmax") {
+    return param.softmax_param().axis() == 1;
+  }
+  return type == "ReLU" || type == "Sigmoid" || type == "TanH" ||
+      type == "ELU" || type == "Eltwise";
+}
+
+// Runs the layer on the CPU implementation, which has the NHWC code.
+static void UseCaffeEngine(LayerParameter* param) {
+  const string& type = param->type();
+  if (type == "Convolution") {
+    param->mutable_convolution_param()->set_engine(
+        ConvolutionParameter_Engine_CAFFE);
+  } else if (type == "Pooling") {
+    param->mutable_pooling_param()->set_engine(PoolingParameter_Engine_CAFFE);
+  } else if (type == "ReLU") {
+    param->mutable_relu_param()->set_engine(ReLUParameter_Engine_CAFFE);
+  } else if (type == "Sigmoid") {
+    param->mutable_sigmoid_param()->set_engine(SigmoidParameter_Engine_CAFFE);
+  } else if (type == "TanH") {
+    param->mutable_tanh_param()->set_engine(TanHParameter_Engine_CAFFE);
+  } else if (type == "Softmax") {
+    param->mutable_softmax_param()->set_engine(SoftmaxParameter_Engine_CAFFE);
+  }
+}
+
+static string NHWCBlobName(const string& blob_name) {
+  return blob_name + "_nhwc";
+}
+
+// Adds a Layout layer converting blob_name to layout.
+static void AddLayoutLayer(const string& blob_name, BlobLayout layout,
+    map<string, int>* conversion_counts, NetParameter* param_layout) {
+  const string nhwc_name = NHWCBlobName(blob_name);
+  std::ostringstream layer_name;
+  layer_name << blob_name << (layout == NHWC ? "_to_nhwc" : "_to_nchw");
+  const int count = (*conversion_counts)[layer_name.str()]++;
+  if (count > 0) {
+    layer_name << "_" << count;
+  }
+  LayerParameter* layer_param = param_layout->add_layer();
+  layer_param->set_name(layer_name.str());
+  layer_param->set_type("Layout");
+  layer_param->add_bottom(layout == NHWC ? blob_name : nhwc_name);
+  layer_param->add_top(layout == NHWC ? nhwc_name : blob_name);
+  layer_param->mutable_layout_param()->set_layout(layout);
+}
+
+void InsertLayouts(const NetParameter& param, NetParameter* param_layout) {
+  param_layout->CopyFrom(param);
+  param_layout->clear_layer();
+  // The blobs whose value was last written in NHWC, so that their NCHW copy
+  // is stale until converted, and those with an up-to-date NHWC copy.
+  set<string> stale_nchw;
+  set<string> nhwc;
+  // The blobs whose latest value no layer has read yet.
+  set<string> unread;
+  map<string, int> conversion_counts;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter layer_param = param.layer(i);
+    const string& type = layer_param.type();
+    bool run_nhwc = LayerSupportsNHWC(layer_param);
+    if (run_nhwc && type != "Convolution" && type != "Pooling") {
+      run_nhwc = layer_param.bottom_size() > 0 &&
+          nhwc.count(layer_param.bottom(0)) > 0;
+    }
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      const string blob_name = layer_param.bottom(j);
+      if (run_nhwc) {
+        if (!nhwc.count(blob_name)) {
+          AddLayoutLayer(blob_name, NHWC, &conversion_counts, param_layout);
+          nhwc.insert(blob_name);
+        }
+        layer_param.set_bottom(j, NHWCBlobName(blob_name));
+      } else if (stale_nchw.count(blob_name)) {
+        AddLayoutLayer(blob_name, NCHW, &conversion_counts, param_layout);
+        stale_nchw.erase(blob_name);
+      }
+      unread.erase(blob_name);
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      const string blob_name = layer_param.top(j);
+      if (run_nhwc) {
+        layer_param.set_top(j, NHWCBlobName(blob_name));
+        stale_nchw.insert(blob_name);
+        nhwc.insert(blob_name);
+      } else {
+        stale_nchw.erase(blob_name);
+        nhwc.erase(blob_name);
+      }
+      unread.insert(blob_name);
+    }
+    if (run_nhwc) {
+      UseCaffeEngine(&layer_param);
+    }
+    param_layout->add_layer()->CopyFrom(layer_param);
+  }
+  // The outputs of the net keep their names and layout.
+  for (set<string>::const_iterator it = unread.begin(); it != unread.end();
+       ++it) {
+    if (stale_nchw.count(*it)) {
+      AddLayoutLayer(*it, NCHW, &conversion_counts, param_layout);
+    }
+  }
+}
+
+}  // namespace caffe
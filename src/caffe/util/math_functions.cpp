@@ -6,9 +6,22 @@
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/vector_math.hpp"
+
+#ifdef USE_OPENBLAS
+extern "C" void openblas_set_num_threads(int num_threads);
+#endif
 
 namespace caffe {
 
+void caffe_set_blas_num_threads(const int num_threads) {
+#if defined(USE_MKL)
+  mkl_set_num_threads(num_threads);
+#elif defined(USE_OPENBLAS)
+  openblas_set_num_threads(num_threads);
+#endif
+}
+
 template<>
 void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -177,7 +190,11 @@ void caffe_div<double>(const int n, const double* a, const double* b,
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b,
     float* y) {
+#ifdef USE_MKL
   vsPowx(n, a, b, y);
+#else
+  caffe_simd_powx(n, a, b, y);
+#endif
 }
 
 template <>
@@ -198,7 +215,11 @@ void caffe_sqr<double>(const int n, const double* a, double* y) {
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
   vsExp(n, a, y);
+#else
+  caffe_simd_exp(n, a, y);
+#endif
 }
 
 template <>
@@ -208,7 +229,11 @@ void caffe_exp<double>(const int n, const double* a, double* y) {
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
   vsLn(n, a, y);
+#else
+  caffe_simd_log(n, a, y);
+#endif
 }
 
 template <>
@@ -216,6 +241,34 @@ void caffe_log<double>(const int n, const double* a, double* y) {
   vdLn(n, a, y);
 }
 
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  vsTanh(n, a, y);
+#else
+  caffe_simd_tanh(n, a, y);
+#endif
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = tanh(a[i]);
+  }
+}
+
+template <>
+void caffe_sigmoid<float>(const int n, const float* a, float* y) {
+  caffe_simd_sigmoid(n, a, y);
+}
+
+template <>
+void caffe_sigmoid<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 1. / (1. + exp(-a[i]));
+  }
+}
+
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
     vsAbs(n, a, y);
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Minimum number of elements per parallel chunk of the element-wise loops.
+const int kQuantizeGrain = 16384;
+// Rows of A and columns of C that caffe_cpu_gemm_s8 keeps accumulating in
+// registers and L1 while streaming through B.
+const int kGemmS8Rows = 4;
+const int kGemmS8Columns = 256;
+
+template <typename Dtype>
+struct AmaxChunk {
+  const Dtype* x;
+
+  Dtype operator()(int begin, int end) const {
+    Dtype amax = 0;
+    for (int i = begin; i < end; ++i) {
+      amax = std::max(amax, std::abs(x[i]));
+    }
+    return amax;
+  }
+};
+
+template <typename Dtype>
+struct Max {
+  Dtype operator()(Dtype a, Dtype b) const { return std::max(a, b); }
+};
+
+template <typename Dtype>
+Dtype caffe_cpu_amax(const int n, const Dtype* x) {
+  const AmaxChunk<Dtype> body = { x };
+  return parallel_reduce(0, n, kQuantizeGrain, Dtype(0), body, Max<Dtype>());
+}
+
+template float caffe_cpu_amax<float>(const int n, const float* x);
+template double caffe_cpu_amax<double>(const int n, const double* x);
+
+template <typename Dtype>
+static inline int8_t quantize(Dtype scale, Dtype x) {
+  const Dtype v = std::min(Dtype(kInt8Max), std::max(Dtype(-kInt8Max),
+                                                     scale * x));
+  return static_cast<int8_t>(v >= 0 ? int(v + Dtype(0.5))
+                                    : -int(-v + Dtype(0.5)));
+}
+
+template <typename Dtype>
+struct QuantizeChunk {
+  Dtype scale;
+  const Dtype* x;
+  int8_t* q;
+
+  void operator()(int begin, int end) const {
+    for (int i = begin; i < end; ++i) {
+      q[i] = quantize(scale, x[i]);
+    }
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_quantize(const int n, const Dtype scale, const Dtype* x,
+    int8_t* q) {
+  const QuantizeChunk<Dtype> body = { scale, x, q };
+  parallel_for(0, n, kQuantizeGrain, body);
+}
+
+template void caffe_cpu_quantize<float>(const int n, const float scale,
+    const float* x, int8_t* q);
+template void caffe_cpu_quantize<double>(const int n, const double scale,
+    const double* x, int8_t* q);
+
+template <typename Dtype>
+void caffe_cpu_quantize_rows(const int rows, const int cols, const Dtype* w,
+    int8_t* q, Dtype* scales) {
+  for (int i = 0; i < rows; ++i) {
+    const Dtype amax = caffe_cpu_amax(cols, w + i * cols);
+    scales[i] = amax / kInt8Max;
+    caffe_cpu_quantize(cols, amax > 0 ? kInt8Max / amax : Dtype(0),
+                       w + i * cols, q + i * cols);
+  }
+}
+
+template void caffe_cpu_quantize_rows<float>(const int rows, const int cols,
+    const float* w, int8_t* q, float* scales);
+template void caffe_cpu_quantize_rows<double>(const int rows, const int cols,
+    const double* w, int8_t* q, double* scales);
+
+// Computes the row blocks [begin, end) of C = A * B, kGemmS8Rows rows each.
+// Every row of B is read once per block and multiplied into all its rows;
+// the innermost loop runs along contiguous columns, which vectorizes.
+struct GemmS8NN {
+  int M, N, K;
+  const int8_t* A;
+  const int8_t* B;
+  int32_t* C;
+
+  void operator()(int begin, int end) const {
+    int32_t acc[kGemmS8Rows][kGemmS8Columns];
+    for (int m = begin * kGemmS8Rows; m < std::min(M, end * kGemmS8Rows);
+         m += kGemmS8Rows) {
+      const int rows = std::min(kGemmS8Rows, M - m);
+      for (int n = 0; n < N; n += kGemmS8Columns) {
+        const int cols = std::min(kGemmS8Columns, N - n);
+        for (int r = 0; r < rows; ++r) {
+          std::fill(acc[r], acc[r] + cols, 0);
+        }
+        for (int k = 0; k < K; ++k) {
+          const int8_t* b = B + k * N + n;
+          for (int r = 0; r < rows; ++r) {
+            const int16_t a = A[(m + r) * K + k];
+            int32_t* c = acc[r];
+            for (int j = 0; j < cols; ++j) {
+              c[j] += a * b[j];
+            }
+          }
+        }
+        for (int r = 0; r < rows; ++r) {
+          std::copy(acc[r], acc[r] + cols, C + (m + r) * N + n);
+        }
+      }
+    }
+  }
+};
+
+// Computes the columns [begin, end) of C = A * B^T as dot products of the
+// rows of A and B, which are both contiguous along K.
+struct GemmS8NT {
+  int M, N, K;
+  const int8_t* A;
+  const int8_t* B;
+  int32_t* C;
+
+  void operator()(int begin, int end) const {
+    for (int m = 0; m < M; ++m) {
+      const int8_t* a = A + m * K;
+      for (int n = begin; n < end; ++n) {
+        const int8_t* b = B + n * K;
+        int32_t sum = 0;
+        for (int k = 0; k < K; ++k) {
+          sum += int16_t(a[k]) * int16_t(b[k]);
+        }
+        C[m * N + n] = sum;
+      }
+    }
+  }
+};
+
+void caffe_cpu_gemm_s8(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const int8_t* A, const int8_t* B, int32_t* C) {
+  if (TransB == CblasNoTrans) {
+    const GemmS8NN body = { M, N, K, A, B, C };
+    const int blocks = (M + kGemmS8Rows - 1) / kGemmS8Rows;
+    const int block_size = kGemmS8Rows * std::max(N * K, 1);
+    parallel_for(0, blocks, kQuantizeGrain / block_size + 1, body);
+  } else {
+    // Inner products have few rows, as many as the batch: split the columns.
+    const GemmS8NT body = { M, N, K, A, B, C };
+    parallel_for(0, N, kQuantizeGrain / std::max(M * K, 1) + 1, body);
+  }
+}
+
+template <typename Dtype>
+int CalibrateQuantization(const NetParameter& param, Net<Dtype>* net,
+    int iterations, NetParameter* param_calibrated) {
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net->layers();
+  const vector<vector<Blob<Dtype>*> >& bottom_vecs = net->bottom_vecs();
+  vector<bool> quantizable(layers.size());
+  vector<Dtype> ranges(layers.size(), Dtype(0));
+  for (int i = 0; i < layers.size(); ++i) {
+    const string type = layers[i]->type();
+    quantizable[i] = type == "Convolution" || type == "InnerProduct";
+  }
+  for (int iter = 0; iter < iterations; ++iter) {
+    // Layer by layer, so that each input is measured before any layer
+    // running in place over it.
+    for (int i = 0; i < layers.size(); ++i) {
+      if (quantizable[i]) {
+        for (int j = 0; j < bottom_vecs[i].size(); ++j) {
+          const Blob<Dtype>* bottom = bottom_vecs[i][j];
+          ranges[i] = std::max(ranges[i],
+              caffe_cpu_amax(bottom->count(), bottom->cpu_data()));
+        }
+      }
+      net->ForwardFromTo(i, i);
+    }
+  }
+  std::map<string, Dtype> range_by_name;
+  for (int i = 0; i < layers.size(); ++i) {
+    if (quantizable[i]) {
+      range_by_name[net->layer_names()[i]] = ranges[i];
+    }
+  }
+  param_calibrated->CopyFrom(param);
+  int num_calibrated = 0;
+  for (int i = 0; i < param_calibrated->layer_size(); ++i) {
+    LayerParameter* layer = param_calibrated->mutable_layer(i);
+    typename std::map<string, Dtype>::const_iterator it =
+        range_by_name.find(layer->name());
+    if (it != range_by_name.end()) {
+      layer->mutable_quantization_param()->set_input_range(it->second);
+      ++num_calibrated;
+    }
+  }
+  return num_calibrated;
+}
+
+template int CalibrateQuantization<float>(const NetParameter& param,
+    Net<float>* net, int iterations, NetParameter* param_calibrated);
+template int CalibrateQuantization<double>(const NetParameter& param,
+    Net<double>* net, int iterations, NetParameter* param_calibrated);
+
+}  // namespace caffe
@@ -0,0 +1,187 @@
+#include <algorithm>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/softmax.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Positions per tile. A tile of channels x kSoftmaxTile values stays in L2
+// for the usual numbers of classes.
+const int kSoftmaxTile = 256;
+// Minimum number of values per parallel chunk.
+const int kSoftmaxGrain = 32768;
+
+// Softmax of the length positions starting at x and y, whose channels are
+// inner_num apart.
+template <typename Dtype>
+static void softmax_tile(const int channels, const int inner_num,
+    const int length, const Dtype* x, Dtype* y) {
+  Dtype max[kSoftmaxTile];
+  Dtype sum[kSoftmaxTile];
+  std::copy(x, x + length, max);
+  for (int c = 1; c < channels; ++c) {
+    const Dtype* x_c = x + c * inner_num;
+    for (int k = 0; k < length; ++k) {
+      max[k] = std::max(max[k], x_c[k]);
+    }
+  }
+  std::fill(sum, sum + length, Dtype(0));
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* x_c = x + c * inner_num;
+    Dtype* y_c = y + c * inner_num;
+    for (int k = 0; k < length; ++k) {
+      y_c[k] = x_c[k] - max[k];
+    }
+    caffe_exp(length, y_c, y_c);
+    for (int k = 0; k < length; ++k) {
+      sum[k] += y_c[k];
+    }
+  }
+  for (int k = 0; k < length; ++k) {
+    sum[k] = Dtype(1) / sum[k];
+  }
+  for (int c = 0; c < channels; ++c) {
+    Dtype* y_c = y + c * inner_num;
+    for (int k = 0; k < length; ++k) {
+      y_c[k] *= sum[k];
+    }
+  }
+}
+
+// Softmax of a row of contiguous channels, for a single position per outer
+// index.
+template <typename Dtype>
+static void softmax_row(const int channels, const Dtype* x, Dtype* y) {
+  const Dtype max = *std::max_element(x, x + channels);
+  for (int c = 0; c < channels; ++c) {
+    y[c] = x[c] - max;
+  }
+  caffe_exp(channels, y, y);
+  Dtype sum = 0;
+  for (int c = 0; c < channels; ++c) {
+    sum += y[c];
+  }
+  const Dtype scale = Dtype(1) / sum;
+  for (int c = 0; c < channels; ++c) {
+    y[c] *= scale;
+  }
+}
+
+template <typename Dtype>
+static void softmax_backward_tile(const int channels, const int inner_num,
+    const int length, const Dtype* y, const Dtype* y_diff, Dtype* x_diff) {
+  Dtype dot[kSoftmaxTile];
+  std::fill(dot, dot + length, Dtype(0));
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* y_c = y + c * inner_num;
+    const Dtype* y_diff_c = y_diff + c * inner_num;
+    for (int k = 0; k < length; ++k) {
+      dot[k] += y_diff_c[k] * y_c[k];
+    }
+  }
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* y_c = y + c * inner_num;
+    const Dtype* y_diff_c = y_diff + c * inner_num;
+    Dtype* x_diff_c = x_diff + c * inner_num;
+    for (int k = 0; k < length; ++k) {
+      x_diff_c[k] = (y_diff_c[k] - dot[k]) * y_c[k];
+    }
+  }
+}
+
+// The tiles of the positions: tiles_per_outer tiles cover the inner_num
+// positions of each outer index, with the last one possibly shorter.
+struct SoftmaxTiling {
+  int channels;
+  int inner_num;
+  int tiles_per_outer;
+
+  SoftmaxTiling(const int channels, const int inner_num)
+      : channels(channels), inner_num(inner_num),
+        tiles_per_outer((inner_num + kSoftmaxTile - 1) / kSoftmaxTile) {}
+
+  int offset(const int tile) const {
+    return tile / tiles_per_outer * channels * inner_num +
+        tile % tiles_per_outer * kSoftmaxTile;
+  }
+  int length(const int tile) const {
+    return std::min(kSoftmaxTile,
+                    inner_num - tile % tiles_per_outer * kSoftmaxTile);
+  }
+  int grain() const {
+    return kSoftmaxGrain / (channels * std::min(kSoftmaxTile, inner_num)) + 1;
+  }
+};
+
+template <typename Dtype>
+struct SoftmaxTiles {
+  SoftmaxTiling tiling;
+  const Dtype* x;
+  Dtype* y;
+
+  void operator()(int begin, int end) const {
+    for (int t = begin; t < end; ++t) {
+      const int offset = tiling.offset(t);
+      if (tiling.inner_num == 1) {
+        softmax_row(tiling.channels, x + offset, y + offset);
+      } else {
+        softmax_tile(tiling.channels, tiling.inner_num, tiling.length(t),
+                     x + offset, y + offset);
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+struct SoftmaxBackwardTiles {
+  SoftmaxTiling tiling;
+  const Dtype* y;
+  const Dtype* y_diff;
+  Dtype* x_diff;
+
+  void operator()(int begin, int end) const {
+    for (int t = begin; t < end; ++t) {
+      const int offset = tiling.offset(t);
+      softmax_backward_tile(tiling.channels, tiling.inner_num,
+          tiling.length(t), y + offset, y_diff + offset, x_diff + offset);
+    }
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_softmax(const int outer_num, const int channels,
+    const int inner_num, const Dtype* x, Dtype* y) {
+  if (outer_num == 0 || channels == 0 || inner_num == 0) {
+    return;
+  }
+  const SoftmaxTiling tiling(channels, inner_num);
+  const SoftmaxTiles<Dtype> body = { tiling, x, y };
+  parallel_for(0, outer_num * tiling.tiles_per_outer, tiling.grain(), body);
+}
+
+template void caffe_cpu_softmax<float>(const int outer_num,
+    const int channels, const int inner_num, const float* x, float* y);
+template void caffe_cpu_softmax<double>(const int outer_num,
+    const int channels, const int inner_num, const double* x, double* y);
+
+template <typename Dtype>
+void caffe_cpu_softmax_backward(const int outer_num, const int channels,
+    const int inner_num, const Dtype* y, const Dtype* y_diff, Dtype* x_diff) {
+  if (outer_num == 0 || channels == 0 || inner_num == 0) {
+    return;
+  }
+  const SoftmaxTiling tiling(channels, inner_num);
+  const SoftmaxBackwardTiles<Dtype> body = { tiling, y, y_diff, x_diff };
+  parallel_for(0, outer_num * tiling.tiles_per_outer, tiling.grain(), body);
+}
+
+template void caffe_cpu_softmax_backward<float>(const int outer_num,
+    const int channels, const int inner_num, const float* y,
+    const float* y_diff, float* x_diff);
+template void caffe_cpu_softmax_backward<double>(const int outer_num,
+    const int channels, const int inner_num, const double* y,
+    const double* y_diff, double* x_diff);
+
+}  // namespace caffe
@@ -0,0 +1,181 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/sparse.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Minimum number of multiply-adds per parallel chunk.
+const int kSparseGemmGrain = 32768;
+
+template <typename Dtype>
+void caffe_cpu_to_sparse(const int rows, const int cols, const Dtype* a,
+    const Dtype threshold, SparseMatrix<Dtype>* s) {
+  s->rows = rows;
+  s->cols = cols;
+  s->row_begin.resize(rows + 1);
+  s->col.clear();
+  s->values.clear();
+  for (int r = 0; r < rows; ++r) {
+    s->row_begin[r] = s->values.size();
+    for (int c = 0; c < cols; ++c) {
+      const Dtype value = a[r * cols + c];
+      if (std::abs(value) > threshold) {
+        s->col.push_back(c);
+        s->values.push_back(value);
+      }
+    }
+  }
+  s->row_begin[rows] = s->values.size();
+}
+
+template void caffe_cpu_to_sparse<float>(const int rows, const int cols,
+    const float* a, const float threshold, SparseMatrix<float>* s);
+template void caffe_cpu_to_sparse<double>(const int rows, const int cols,
+    const double* a, const double threshold, SparseMatrix<double>* s);
+
+// The grain of a loop over the rows of A doing work multiply-adds per
+// nonzero.
+template <typename Dtype>
+static int sparse_grain(const SparseMatrix<Dtype>& A, const int work) {
+  const double per_row = double(A.nnz()) / std::max(A.rows, 1) * work;
+  return static_cast<int>(kSparseGemmGrain / (per_row + 1)) + 1;
+}
+
+template <typename Dtype>
+struct SparseGemmRows {
+  const SparseMatrix<Dtype>* A;
+  int N;
+  const Dtype* B;
+  Dtype* C;
+
+  void operator()(int begin, int end) const {
+    for (int r = begin; r < end; ++r) {
+      Dtype* c = C + r * N;
+      std::fill(c, c + N, Dtype(0));
+      for (int i = A->row_begin[r]; i < A->row_begin[r + 1]; ++i) {
+        const Dtype a = A->values[i];
+        const Dtype* b = B + A->col[i] * N;
+        for (int j = 0; j < N; ++j) {
+          c[j] += a * b[j];
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_sparse_gemm(const SparseMatrix<Dtype>& A, const int N,
+    const Dtype* B, Dtype* C) {
+  const SparseGemmRows<Dtype> body = { &A, N, B, C };
+  parallel_for(0, A.rows, sparse_grain(A, N), body);
+}
+
+template void caffe_cpu_sparse_gemm<float>(const SparseMatrix<float>& A,
+    const int N, const float* B, float* C);
+template void caffe_cpu_sparse_gemm<double>(const SparseMatrix<double>& A,
+    const int N, const double* B, double* C);
+
+template <typename Dtype>
+struct SparseGemmTransRows {
+  int M;
+  const Dtype* B;
+  const SparseMatrix<Dtype>* A;
+  Dtype* C;
+
+  void operator()(int begin, int end) const {
+    const int K = A->cols, N = A->rows;
+    for (int n = begin; n < end; ++n) {
+      const int row_begin = A->row_begin[n], row_end = A->row_begin[n + 1];
+      for (int m = 0; m < M; ++m) {
+        const Dtype* b = B + m * K;
+        Dtype sum = 0;
+        for (int i = row_begin; i < row_end; ++i) {
+          sum += A->values[i] * b[A->col[i]];
+        }
+        C[m * N + n] = sum;
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void caffe_cpu_sparse_gemm_trans(const int M, const Dtype* B,
+    const SparseMatrix<Dtype>& A, Dtype* C) {
+  const SparseGemmTransRows<Dtype> body = { M, B, &A, C };
+  parallel_for(0, A.rows, sparse_grain(A, M), body);
+}
+
+template void caffe_cpu_sparse_gemm_trans<float>(const int M, const float* B,
+    const SparseMatrix<float>& A, float* C);
+template void caffe_cpu_sparse_gemm_trans<double>(const int M,
+    const double* B, const SparseMatrix<double>& A, double* C);
+
+// The bytes taking a varint of value in the wire format.
+static int varint_size(uint32_t value) {
+  int size = 1;
+  while (value >= 128) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+// Splits the values of data into their nonzeros and zero runs, and says
+// whether those take less space than the values.
+template <typename Value>
+static bool split_sparse(const google::protobuf::RepeatedField<Value>& data,
+    google::protobuf::RepeatedField<Value>* nonzeros,
+    google::protobuf::RepeatedField<uint32_t>* zero_runs) {
+  int64_t sparse_bytes = 0;
+  uint32_t run = 0;
+  for (int i = 0; i < data.size(); ++i) {
+    if (data.Get(i) == 0) {
+      ++run;
+    } else {
+      nonzeros->Add(data.Get(i));
+      zero_runs->Add(run);
+      sparse_bytes += sizeof(Value) + varint_size(run);
+      run = 0;
+    }
+  }
+  zero_runs->Add(run);
+  sparse_bytes += varint_size(run);
+  return sparse_bytes < int64_t(data.size()) * sizeof(Value);
+}
+
+void SparsifyBlobProto(BlobProto* proto) {
+  if (proto->zero_run_size() > 0 || proto->diff_size() > 0 ||
+      proto->double_diff_size() > 0) {
+    return;
+  }
+  google::protobuf::RepeatedField<uint32_t> zero_runs;
+  if (proto->double_data_size() > 0) {
+    google::protobuf::RepeatedField<double> nonzeros;
+    if (split_sparse(proto->double_data(), &nonzeros, &zero_runs)) {
+      proto->mutable_double_data()->Swap(&nonzeros);
+      proto->mutable_zero_run()->Swap(&zero_runs);
+    }
+  } else if (proto->data_size() > 0) {
+    google::protobuf::RepeatedField<float> nonzeros;
+    if (split_sparse(proto->data(), &nonzeros, &zero_runs)) {
+      proto->mutable_data()->Swap(&nonzeros);
+      proto->mutable_zero_run()->Swap(&zero_runs);
+    }
+  }
+}
+
+void SparsifyNetBlobs(NetParameter* param) {
+  for (int i = 0; i < param->layer_size(); ++i) {
+    LayerParameter* layer_param = param->mutable_layer(i);
+    for (int j = 0; j < layer_param->blobs_size(); ++j) {
+      SparsifyBlobProto(layer_param->mutable_blobs(j));
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,201 @@
+#include <boost/thread.hpp>
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  sync()
+      : task_(NULL), num_tasks_(0), next_task_(0), done_tasks_(0),
+        generation_(0), stop_(false) {}
+
+  boost::mutex mutex_;
+  // Signals the workers that a job was posted or that they should stop.
+  boost::condition_variable work_condition_;
+  // Signals the posting thread that the last task of its job is done.
+  boost::condition_variable done_condition_;
+  // Held by the thread whose job the workers are running.
+  boost::mutex run_mutex_;
+  boost::thread_group threads_;
+
+  const boost::function<void(int)>* task_;
+  int num_tasks_;
+  int next_task_;
+  int done_tasks_;
+  int generation_;
+  bool stop_;
+};
+
+// Whether the current thread is running pool tasks; nested loops run inline.
+static boost::thread_specific_ptr<bool> in_pool_task_;
+
+static bool& InPoolTask() {
+  if (!in_pool_task_.get()) {
+    in_pool_task_.reset(new bool(false));
+  }
+  return *in_pool_task_;
+}
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(num_threads), sync_(new sync()) {
+  CHECK_GE(num_threads_, 1);
+  for (int i = 1; i < num_threads_; ++i) {
+    sync_->threads_.create_thread(boost::bind(&ThreadPool::WorkerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_condition_.notify_all();
+  sync_->threads_.join_all();
+}
+
+void ThreadPool::Run(int num_tasks, const boost::function<void(int)>& task) {
+  if (num_tasks <= 0) { return; }
+  boost::unique_lock<boost::mutex> run_lock(sync_->run_mutex_,
+                                            boost::try_to_lock);
+  bool& in_task = InPoolTask();
+  if (num_threads_ == 1 || num_tasks == 1 || in_task ||
+      !run_lock.owns_lock()) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->task_ = &task;
+    sync_->num_tasks_ = num_tasks;
+    sync_->next_task_ = 0;
+    sync_->done_tasks_ = 0;
+    ++sync_->generation_;
+  }
+  sync_->work_condition_.notify_all();
+  in_task = true;
+  Work();
+  in_task = false;
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->done_tasks_ < sync_->num_tasks_) {
+    sync_->done_condition_.wait(lock);
+  }
+  sync_->task_ = NULL;
+}
+
+void ThreadPool::Work() {
+  for (;;) {
+    const boost::function<void(int)>* task;
+    int index;
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      if (sync_->task_ == NULL || sync_->next_task_ >= sync_->num_tasks_) {
+        return;
+      }
+      task = sync_->task_;
+      index = sync_->next_task_++;
+    }
+    (*task)(index);
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    if (++sync_->done_tasks_ == sync_->num_tasks_) {
+      sync_->done_condition_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  InPoolTask() = true;
+#ifdef USE_MKL
+  // BLAS calls made from inside a task must not fan out again.
+  mkl_set_num_threads_local(1);
+#endif
+  int generation = 0;
+  for (;;) {
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      while (!sync_->stop_ && sync_->generation_ == generation) {
+        sync_->work_condition_.wait(lock);
+      }
+      if (sync_->stop_) { return; }
+      generation = sync_->generation_;
+    }
+    Work();
+  }
+}
+
+// The progress of a parallel_dag() call, shared by the tasks running it.
+struct DagState {
+  boost::mutex mutex;
+  // Signals that nodes became ready or that the last node is done.
+  boost::condition_variable condition;
+  std::priority_queue<int, vector<int>, std::greater<int> > ready;
+  vector<vector<int> > successors;
+  vector<int> num_waiting;
+  int num_running;
+  int num_done;
+};
+
+// Runs ready nodes until none are ready or running, which means all nodes
+// are done unless the graph has a cycle.
+static void RunDagNodes(DagState* state,
+    const boost::function<void(int)>* task, int /* task index */) {
+  boost::mutex::scoped_lock lock(state->mutex);
+  for (;;) {
+    while (state->ready.empty() && state->num_running > 0) {
+      state->condition.wait(lock);
+    }
+    if (state->ready.empty()) { return; }
+    const int node = state->ready.top();
+    state->ready.pop();
+    ++state->num_running;
+    lock.unlock();
+    (*task)(node);
+    lock.lock();
+    --state->num_running;
+    ++state->num_done;
+    const vector<int>& successors = state->successors[node];
+    for (int i = 0; i < successors.size(); ++i) {
+      if (--state->num_waiting[successors[i]] == 0) {
+        state->ready.push(successors[i]);
+      }
+    }
+    state->condition.notify_all();
+  }
+}
+
+void parallel_dag(const vector<vector<int> >& predecessors,
+    const boost::function<void(int)>& task) {
+  const int num_nodes = predecessors.size();
+  if (num_nodes == 0) { return; }
+  DagState state;
+  state.successors.resize(num_nodes);
+  state.num_waiting.resize(num_nodes, 0);
+  state.num_running = 0;
+  state.num_done = 0;
+  for (int i = 0; i < num_nodes; ++i) {
+    for (int j = 0; j < predecessors[i].size(); ++j) {
+      const int predecessor = predecessors[i][j];
+      CHECK_GE(predecessor, 0);
+      CHECK_LT(predecessor, num_nodes);
+      state.successors[predecessor].push_back(i);
+      ++state.num_waiting[i];
+    }
+    if (state.num_waiting[i] == 0) {
+      state.ready.push(i);
+    }
+  }
+  const int num_tasks = std::min(Caffe::cpu_threads(), num_nodes);
+  Caffe::thread_pool().Run(num_tasks,
+      boost::bind(&RunDagNodes, &state, &task, _1));
+  CHECK_EQ(state.num_done, num_nodes) << "The graph has a cycle.";
+}
+
+}  // namespace caffe
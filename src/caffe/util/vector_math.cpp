@@ -0,0 +1,378 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "caffe/util/vector_math.hpp"
+
+// The kernels are written once with GCC vector extensions and compiled for
+// every vector width; functions with a target attribute inline them with
+// that instruction set.
+#if defined(__GNUC__)
+#define CAFFE_SIMD_VECTORS
+#define CAFFE_SIMD_INLINE inline __attribute__((always_inline))
+#if defined(__x86_64__) || defined(__i386__)
+#define CAFFE_SIMD_DISPATCH
+#endif
+#endif
+
+namespace caffe {
+
+#ifdef CAFFE_SIMD_VECTORS
+
+template <int W>
+struct Vectors {
+  typedef float Float __attribute__((vector_size(W * sizeof(float))));
+  typedef int32_t Int __attribute__((vector_size(W * sizeof(float))));
+};
+
+// 1.5 * 2^23: adding it rounds a float of magnitude below 2^22 to an integer
+// that sits in the low mantissa bits.
+const float kRoundMagic = 12582912.f;
+const int32_t kRoundMagicBits = 0x4b400000;
+
+// exp(x) = 2^n * exp(f) with n = round(x / ln 2) and |f| <= ln(2) / 2; ln 2
+// is split in two so that f is exact. The polynomial is the minimax one of
+// Cephes' expf. 2^n is applied as two halves so that n may reach 128 and
+// -150 without leaving the exponent range.
+template <int W>
+static CAFFE_SIMD_INLINE void exp_kernel(const typename Vectors<W>::Float& x,
+    typename Vectors<W>::Float* y) {
+  typedef typename Vectors<W>::Float F;
+  typedef typename Vectors<W>::Int I;
+  const F zero = F() + 0.f;
+  // Beyond these exp is 0 or infinity anyway; NaNs pass both tests.
+  F v = x < -104.f ? zero - 104.f : x;
+  v = v > 89.f ? zero + 89.f : v;
+  const F t = v * 1.44269504088896341f + kRoundMagic;
+  const I n = (I)t - kRoundMagicBits;
+  const F r = t - kRoundMagic;
+  F f = v - r * 0.693359375f;
+  f = f + r * 2.12194440e-4f;
+  F p = f * 1.9875691500e-4f + 1.3981999507e-3f;
+  p = p * f + 8.3334519073e-3f;
+  p = p * f + 4.1665795894e-2f;
+  p = p * f + 1.6666665459e-1f;
+  p = p * f + 5.0000001201e-1f;
+  p = p * (f * f) + f + 1.f;
+  const I n1 = n >> 1;
+  const I n2 = n - n1;
+  *y = p * (F)((n1 + 127) << 23) * (F)((n2 + 127) << 23);
+}
+
+// log(x) = e ln 2 + log(1 + m) with sqrt(1/2) <= 1 + m < sqrt(2), from the
+// exponent and mantissa bits; the polynomial is the one of Cephes' logf.
+template <int W>
+static CAFFE_SIMD_INLINE void log_kernel(const typename Vectors<W>::Float& x,
+    typename Vectors<W>::Float* y) {
+  typedef typename Vectors<W>::Float F;
+  typedef typename Vectors<W>::Int I;
+  const F zero = F() + 0.f;
+  // Scale subnormals into the normal range first.
+  const I subnormal = x < std::numeric_limits<float>::min();
+  const F v = subnormal ? x * 8388608.f : x;
+  const I bits = (I)v;
+  I e = ((bits >> 23) & 0xff) - 126 + (subnormal & -23);
+  // The mantissa in [0.5, 1).
+  F m = (F)((bits & 0x007fffff) | 0x3f000000);
+  const I below = m < 0.707106781186547524f;
+  e = e + below;
+  m = m - 1.f + (below ? m : zero);
+  const F fe = (F)(e + kRoundMagicBits) - kRoundMagic;
+  const F z = m * m;
+  F p = m * 7.0376836292e-2f - 1.1514610310e-1f;
+  p = p * m + 1.1676998740e-1f;
+  p = p * m - 1.2420140846e-1f;
+  p = p * m + 1.4249322787e-1f;
+  p = p * m - 1.6668057665e-1f;
+  p = p * m + 2.0000714765e-1f;
+  p = p * m - 2.4999993993e-1f;
+  p = p * m + 3.3333331174e-1f;
+  p = p * m * z;
+  p = p - fe * 2.12194440e-4f;
+  p = p - 0.5f * z;
+  F r = m + p;
+  r = r + fe * 0.693359375f;
+  const float inf = std::numeric_limits<float>::infinity();
+  r = x < 0.f ? zero + std::numeric_limits<float>::quiet_NaN() : r;
+  r = x == 0.f ? zero - inf : r;
+  r = x == inf ? zero + inf : r;
+  *y = x != x ? x : r;
+}
+
+// tanh(x) = 1 - 2 / (exp(2x) + 1) loses its relative precision near 0, so
+// below 0.625 the odd polynomial of Cephes' tanhf takes over.
+template <int W>
+static CAFFE_SIMD_INLINE void tanh_kernel(const typename Vectors<W>::Float& x,
+    typename Vectors<W>::Float* y) {
+  typedef typename Vectors<W>::Float F;
+  typedef typename Vectors<W>::Int I;
+  const I sign = (I)x & static_cast<int32_t>(0x80000000);
+  const F ax = (F)((I)x ^ sign);
+  F e;
+  exp_kernel<W>(ax + ax, &e);
+  const F large = (F)((I)(1.f - 2.f / (e + 1.f)) | sign);
+  const F z = x * x;
+  F p = z * -5.70498872745e-3f + 2.06390887954e-2f;
+  p = p * z - 5.37397155531e-2f;
+  p = p * z + 1.33314422036e-1f;
+  p = p * z - 3.33332819422e-1f;
+  const F small = p * z * x + x;
+  *y = ax < 0.625f ? small : large;
+}
+
+// sigmoid(x) = 1 / (1 + exp(-x)), or exp(x) / (1 + exp(x)) for negative x
+// where exp(-x) might overflow before the result underflows.
+template <int W>
+static CAFFE_SIMD_INLINE void sigmoid_kernel(
+    const typename Vectors<W>::Float& x, typename Vectors<W>::Float* y) {
+  typedef typename Vectors<W>::Float F;
+  typedef typename Vectors<W>::Int I;
+  const F negative_abs = (F)((I)x | static_cast<int32_t>(0x80000000));
+  F e;
+  exp_kernel<W>(negative_abs, &e);
+  const F s = 1.f / (1.f + e);
+  *y = x < 0.f ? e * s : s;
+}
+
+struct ExpOp {
+  template <int W>
+  CAFFE_SIMD_INLINE void apply(const typename Vectors<W>::Float& x,
+      typename Vectors<W>::Float* y) const {
+    exp_kernel<W>(x, y);
+  }
+};
+
+struct LogOp {
+  template <int W>
+  CAFFE_SIMD_INLINE void apply(const typename Vectors<W>::Float& x,
+      typename Vectors<W>::Float* y) const {
+    log_kernel<W>(x, y);
+  }
+};
+
+struct TanhOp {
+  template <int W>
+  CAFFE_SIMD_INLINE void apply(const typename Vectors<W>::Float& x,
+      typename Vectors<W>::Float* y) const {
+    tanh_kernel<W>(x, y);
+  }
+};
+
+struct SigmoidOp {
+  template <int W>
+  CAFFE_SIMD_INLINE void apply(const typename Vectors<W>::Float& x,
+      typename Vectors<W>::Float* y) const {
+    sigmoid_kernel<W>(x, y);
+  }
+};
+
+// |x|^b = exp(b log |x|); negative x take the sign of the integer power, or
+// have none.
+struct PowxOp {
+  float b;
+  float negative_factor;  // -1 for odd b, 1 for even b, NaN otherwise
+
+  template <int W>
+  CAFFE_SIMD_INLINE void apply(const typename Vectors<W>::Float& x,
+      typename Vectors<W>::Float* y) const {
+    typedef typename Vectors<W>::Float F;
+    typedef typename Vectors<W>::Int I;
+    const F ax = (F)((I)x & 0x7fffffff);
+    F l;
+    log_kernel<W>(ax, &l);
+    F p;
+    exp_kernel<W>(l * b, &p);
+    // -inf has every power, like +inf, with the sign of an odd b.
+    const float inf_factor = negative_factor == negative_factor ?
+        negative_factor : 1.f;
+    const F factor = x == -std::numeric_limits<float>::infinity() ?
+        inf_factor : negative_factor;
+    *y = x < 0.f ? p * factor : p;
+  }
+};
+
+// Runs op over whole vectors, then over the tail padded to a whole vector, so
+// every element gets the same arithmetic wherever it sits.
+template <int W, typename Op>
+static CAFFE_SIMD_INLINE void simd_loop(const Op& op, const int n,
+    const float* x, float* y) {
+  typedef typename Vectors<W>::Float F;
+  int i = 0;
+  for (; i + W <= n; i += W) {
+    F v, r;
+    memcpy(&v, x + i, sizeof(v));
+    op.template apply<W>(v, &r);
+    memcpy(y + i, &r, sizeof(r));
+  }
+  if (i < n) {
+    float tail[W];
+    std::fill(tail, tail + W, 0.f);
+    memcpy(tail, x + i, (n - i) * sizeof(float));
+    F v, r;
+    memcpy(&v, tail, sizeof(v));
+    op.template apply<W>(v, &r);
+    memcpy(y + i, &r, (n - i) * sizeof(float));
+  }
+}
+
+template <typename Op>
+static void run_base(const Op& op, const int n, const float* x, float* y) {
+  simd_loop<4>(op, n, x, y);
+}
+
+#ifdef CAFFE_SIMD_DISPATCH
+template <typename Op>
+__attribute__((target("avx2,fma")))
+static void run_avx2(const Op& op, const int n, const float* x, float* y) {
+  simd_loop<8>(op, n, x, y);
+}
+
+template <typename Op>
+__attribute__((target("avx512f,avx2,fma")))
+static void run_avx512(const Op& op, const int n, const float* x, float* y) {
+  simd_loop<16>(op, n, x, y);
+}
+#endif
+
+static SimdIsa supported_isa() {
+#ifdef CAFFE_SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SIMD_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return SIMD_AVX2;
+  }
+#endif
+  return SIMD_BASE;
+}
+
+#else  // CAFFE_SIMD_VECTORS
+
+// Without vector extensions every op is the libm call.
+struct ExpOp {
+  float operator()(float x) const { return std::exp(x); }
+};
+struct LogOp {
+  float operator()(float x) const { return std::log(x); }
+};
+struct TanhOp {
+  float operator()(float x) const { return std::tanh(x); }
+};
+struct SigmoidOp {
+  float operator()(float x) const { return 1.f / (1.f + std::exp(-x)); }
+};
+struct PowxOp {
+  float b;
+  float negative_factor;
+  float operator()(float x) const { return std::pow(x, b); }
+};
+
+template <typename Op>
+static void run_base(const Op& op, const int n, const float* x, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = op(x[i]);
+  }
+}
+
+static SimdIsa supported_isa() {
+  return SIMD_BASE;
+}
+
+#endif  // CAFFE_SIMD_VECTORS
+
+static SimdIsa& current_isa() {
+  static SimdIsa isa = supported_isa();
+  return isa;
+}
+
+SimdIsa caffe_simd_isa() {
+  return current_isa();
+}
+
+void caffe_simd_set_isa(SimdIsa isa) {
+  // The enum runs from the widest instruction set to the narrowest.
+  current_isa() = std::max(isa, supported_isa());
+}
+
+const char* caffe_simd_isa_name(SimdIsa isa) {
+  switch (isa) {
+  case SIMD_AVX512:
+    return "AVX-512";
+  case SIMD_AVX2:
+    return "AVX2";
+  default:
+    return "base";
+  }
+}
+
+template <typename Op>
+static void run(const Op& op, const int n, const float* x, float* y) {
+  switch (current_isa()) {
+#ifdef CAFFE_SIMD_DISPATCH
+  case SIMD_AVX512:
+    run_avx512(op, n, x, y);
+    break;
+  case SIMD_AVX2:
+    run_avx2(op, n, x, y);
+    break;
+#endif
+  default:
+    run_base(op, n, x, y);
+  }
+}
+
+void caffe_simd_exp(const int n, const float* x, float* y) {
+  run(ExpOp(), n, x, y);
+}
+
+void caffe_simd_log(const int n, const float* x, float* y) {
+  run(LogOp(), n, x, y);
+}
+
+void caffe_simd_tanh(const int n, const float* x, float* y) {
+  run(TanhOp(), n, x, y);
+}
+
+void caffe_simd_sigmoid(const int n, const float* x, float* y) {
+  run(SigmoidOp(), n, x, y);
+}
+
+void caffe_simd_powx(const int n, const float* x, const float b, float* y) {
+  // The common powers are exact.
+  if (b == 0) {
+    std::fill(y, y + n, 1.f);
+  } else if (b == 1) {
+    std::copy(x, x + n, y);
+  } else if (b == 2) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = x[i] * x[i];
+    }
+  } else if (b == -1) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = 1.f / x[i];
+    }
+  } else if (b == 0.5f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::sqrt(x[i]);
+    }
+  } else if (b == -0.5f) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = 1.f / std::sqrt(x[i]);
+    }
+  } else {
+    PowxOp op;
+    op.b = b;
+    if (std::floor(b) != b) {
+      op.negative_factor = std::numeric_limits<float>::quiet_NaN();
+    } else {
+      op.negative_factor = std::fmod(b, 2.f) == 0 ? 1.f : -1.f;
+    }
+    run(op, n, x, y);
+  }
+}
+
+}  // namespace caffe
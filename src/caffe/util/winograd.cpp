@@ -0,0 +1,286 @@
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/winograd.hpp"
+
+namespace caffe {
+
+// The transforms of F(2 x 2, 3 x 3) and F(4 x 4, 3 x 3), from Lavin & Gray,
+// "Fast Algorithms for Convolutional Neural Networks": the output tile is
+// A^T [(G g G^T) .* (B^T d B)] A for a filter g and an input tile d.
+static const double kInputTransform2[] = {
+  1,  0, -1,  0,
+  0,  1,  1,  0,
+  0, -1,  1,  0,
+  0,  1,  0, -1 };
+static const double kWeightTransform2[] = {
+  1,    0,   0,
+  0.5,  0.5, 0.5,
+  0.5, -0.5, 0.5,
+  0,    0,   1 };
+static const double kOutputTransform2[] = {
+  1, 1,  1,  0,
+  0, 1, -1, -1 };
+
+static const double kInputTransform4[] = {
+  4,  0, -5,  0, 1, 0,
+  0, -4, -4,  1, 1, 0,
+  0,  4, -4, -1, 1, 0,
+  0, -2, -1,  2, 1, 0,
+  0,  2, -1, -2, 1, 0,
+  0,  4,  0, -5, 0, 1 };
+static const double kWeightTransform4[] = {
+  1. / 4,          0,         0,
+  -1. / 6,   -1. / 6,   -1. / 6,
+  -1. / 6,    1. / 6,   -1. / 6,
+  1. / 24,   1. / 12,    1. / 6,
+  1. / 24,  -1. / 12,    1. / 6,
+  0,               0,         1 };
+static const double kOutputTransform4[] = {
+  1, 1,  1, 1,  1, 0,
+  0, 1, -1, 2, -2, 0,
+  0, 1,  1, 4,  4, 0,
+  0, 1, -1, 8, -8, 1 };
+
+// Output channels per thread pool task, and input channels per task of the
+// transforms.
+const int kWinogradChannelGrain = 4;
+
+// The matrices of one tile size.
+struct WinogradTransforms {
+  int tile;
+  int size;  // tile + 2, the side of the transform domain
+  const double* input;
+  const double* weight;
+  const double* output;
+
+  explicit WinogradTransforms(const int tile) : tile(tile), size(tile + 2) {
+    CHECK(tile == 2 || tile == 4) << "Winograd tiles are 2 x 2 or 4 x 4.";
+    input = (tile == 2) ? kInputTransform2 : kInputTransform4;
+    weight = (tile == 2) ? kWeightTransform2 : kWeightTransform4;
+    output = (tile == 2) ? kOutputTransform2 : kOutputTransform4;
+  }
+};
+
+static inline int num_tiles(const int tile, const int out_height,
+    const int out_width) {
+  return ((out_height + tile - 1) / tile) * ((out_width + tile - 1) / tile);
+}
+
+int winograd_weights_size(const int tile, const int out_channels,
+    const int in_channels) {
+  return (tile + 2) * (tile + 2) * out_channels * in_channels;
+}
+
+int winograd_input_buffer_size(const int tile, const int in_channels,
+    const int out_height, const int out_width) {
+  return (tile + 2) * (tile + 2) * in_channels *
+      num_tiles(tile, out_height, out_width);
+}
+
+int winograd_output_buffer_size(const int tile, const int out_channels,
+    const int out_height, const int out_width) {
+  return (tile + 2) * (tile + 2) * out_channels *
+      num_tiles(tile, out_height, out_width);
+}
+
+template <typename Dtype>
+void winograd_transform_weights_cpu(const int tile, const Dtype* weights,
+    const int out_channels, const int in_channels, const bool flip,
+    Dtype* transformed_weights) {
+  const WinogradTransforms transforms(tile);
+  const int size = transforms.size;
+  const int outputs = flip ? in_channels : out_channels;
+  const int inputs = flip ? out_channels : in_channels;
+  const int matrix_size = outputs * inputs;
+  for (int o = 0; o < outputs; ++o) {
+    for (int i = 0; i < inputs; ++i) {
+      const Dtype* filter = flip ? weights + (i * in_channels + o) * 9 :
+          weights + (o * in_channels + i) * 9;
+      double g[9];
+      for (int k = 0; k < 9; ++k) {
+        g[k] = flip ? filter[8 - k] : filter[k];
+      }
+      // G g, then (G g) G^T
+      double left[6 * 3];
+      for (int r = 0; r < size; ++r) {
+        for (int c = 0; c < 3; ++c) {
+          double sum = 0;
+          for (int k = 0; k < 3; ++k) {
+            sum += transforms.weight[r * 3 + k] * g[k * 3 + c];
+          }
+          left[r * 3 + c] = sum;
+        }
+      }
+      for (int r = 0; r < size; ++r) {
+        for (int c = 0; c < size; ++c) {
+          double sum = 0;
+          for (int k = 0; k < 3; ++k) {
+            sum += left[r * 3 + k] * transforms.weight[c * 3 + k];
+          }
+          transformed_weights[(r * size + c) * matrix_size + o * inputs + i] =
+              sum;
+        }
+      }
+    }
+  }
+}
+
+template void winograd_transform_weights_cpu<float>(const int tile,
+    const float* weights, const int out_channels, const int in_channels,
+    const bool flip, float* transformed_weights);
+template void winograd_transform_weights_cpu<double>(const int tile,
+    const double* weights, const int out_channels, const int in_channels,
+    const bool flip, double* transformed_weights);
+
+// Transforms the input tiles of the channels [begin, end) into the buffer,
+// laid out as (size * size) x channels x tiles.
+template <typename Dtype>
+struct WinogradInputTransform {
+  const WinogradTransforms* transforms;
+  const Dtype* data_im;
+  int channels, height, width, pad_h, pad_w, tiles_h, tiles_w;
+  Dtype* buffer;
+
+  void operator()(int begin, int end) const {
+    const int tile = transforms->tile;
+    const int size = transforms->size;
+    const double* bt = transforms->input;
+    const int num_tiles = tiles_h * tiles_w;
+    const int matrix_size = channels * num_tiles;
+    Dtype d[6 * 6];
+    Dtype left[6 * 6];
+    for (int c = begin; c < end; ++c) {
+      const Dtype* channel = data_im + c * height * width;
+      for (int th = 0; th < tiles_h; ++th) {
+        for (int tw = 0; tw < tiles_w; ++tw) {
+          const int h0 = th * tile - pad_h;
+          const int w0 = tw * tile - pad_w;
+          for (int r = 0; r < size; ++r) {
+            const int h = h0 + r;
+            for (int s = 0; s < size; ++s) {
+              const int w = w0 + s;
+              d[r * size + s] = (h >= 0 && h < height && w >= 0 && w < width)
+                  ? channel[h * width + w] : Dtype(0);
+            }
+          }
+          // B^T d, then (B^T d) B
+          for (int r = 0; r < size; ++r) {
+            for (int s = 0; s < size; ++s) {
+              Dtype sum = 0;
+              for (int k = 0; k < size; ++k) {
+                sum += bt[r * size + k] * d[k * size + s];
+              }
+              left[r * size + s] = sum;
+            }
+          }
+          Dtype* out = buffer + c * num_tiles + th * tiles_w + tw;
+          for (int r = 0; r < size; ++r) {
+            for (int s = 0; s < size; ++s) {
+              Dtype sum = 0;
+              for (int k = 0; k < size; ++k) {
+                sum += left[r * size + k] * bt[s * size + k];
+              }
+              out[(r * size + s) * matrix_size] = sum;
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+// Transforms the products of the output channels [begin, end) back into
+// output tiles.
+template <typename Dtype>
+struct WinogradOutputTransform {
+  const WinogradTransforms* transforms;
+  const Dtype* buffer;
+  int channels, out_height, out_width, tiles_h, tiles_w;
+  Dtype* output;
+
+  void operator()(int begin, int end) const {
+    const int tile = transforms->tile;
+    const int size = transforms->size;
+    const double* at = transforms->output;
+    const int num_tiles = tiles_h * tiles_w;
+    const int matrix_size = channels * num_tiles;
+    Dtype m[6 * 6];
+    Dtype left[4 * 6];
+    for (int o = begin; o < end; ++o) {
+      Dtype* channel = output + o * out_height * out_width;
+      for (int th = 0; th < tiles_h; ++th) {
+        for (int tw = 0; tw < tiles_w; ++tw) {
+          const Dtype* in = buffer + o * num_tiles + th * tiles_w + tw;
+          for (int k = 0; k < size * size; ++k) {
+            m[k] = in[k * matrix_size];
+          }
+          // A^T m, then (A^T m) A
+          for (int r = 0; r < tile; ++r) {
+            for (int s = 0; s < size; ++s) {
+              Dtype sum = 0;
+              for (int k = 0; k < size; ++k) {
+                sum += at[r * size + k] * m[k * size + s];
+              }
+              left[r * size + s] = sum;
+            }
+          }
+          const int h0 = th * tile;
+          const int w0 = tw * tile;
+          for (int r = 0; r < tile && h0 + r < out_height; ++r) {
+            for (int s = 0; s < tile && w0 + s < out_width; ++s) {
+              Dtype sum = 0;
+              for (int k = 0; k < size; ++k) {
+                sum += left[r * size + k] * at[s * size + k];
+              }
+              channel[(h0 + r) * out_width + w0 + s] = sum;
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+template <typename Dtype>
+void winograd_conv_cpu(const int tile, const Dtype* data_im,
+    const int in_channels, const int height, const int width,
+    const int pad_h, const int pad_w, const Dtype* transformed_weights,
+    const int out_channels, const int out_height, const int out_width,
+    Dtype* input_buffer, Dtype* output_buffer, Dtype* output) {
+  const WinogradTransforms transforms(tile);
+  const int size = transforms.size;
+  const int tiles_h = (out_height + tile - 1) / tile;
+  const int tiles_w = (out_width + tile - 1) / tile;
+  const int num_tiles = tiles_h * tiles_w;
+  const WinogradInputTransform<Dtype> input_transform = { &transforms,
+      data_im, in_channels, height, width, pad_h, pad_w, tiles_h, tiles_w,
+      input_buffer };
+  parallel_for(0, in_channels, kWinogradChannelGrain, input_transform);
+  // One product of out_channels x in_channels by in_channels x tiles per
+  // element of the transform domain.
+  for (int k = 0; k < size * size; ++k) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_channels, num_tiles,
+        in_channels, (Dtype)1.,
+        transformed_weights + k * out_channels * in_channels,
+        input_buffer + k * in_channels * num_tiles,
+        (Dtype)0., output_buffer + k * out_channels * num_tiles);
+  }
+  const WinogradOutputTransform<Dtype> output_transform = { &transforms,
+      output_buffer, out_channels, out_height, out_width, tiles_h, tiles_w,
+      output };
+  parallel_for(0, out_channels, kWinogradChannelGrain, output_transform);
+}
+
+template void winograd_conv_cpu<float>(const int tile, const float* data_im,
+    const int in_channels, const int height, const int width,
+    const int pad_h, const int pad_w, const float* transformed_weights,
+    const int out_channels, const int out_height, const int out_width,
+    float* input_buffer, float* output_buffer, float* output);
+template void winograd_conv_cpu<double>(const int tile, const double* data_im,
+    const int in_channels, const int height, const int width,
+    const int pad_h, const int pad_w, const double* transformed_weights,
+    const int out_channels, const int out_height, const int out_width,
+    double* input_buffer, double* output_buffer, double* output);
+
+}  // namespace caffe
@@ -0,0 +1,50 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "caffe/util/workspace.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class Workspace<Dtype>::sync {
+ public:
+  boost::mutex mutex_;
+  std::map<boost::thread::id, shared_ptr<Blob<Dtype> > > buffers_;
+};
+
+template <typename Dtype>
+Workspace<Dtype>::Workspace() : count_(0), sync_(new sync()) {}
+
+template <typename Dtype>
+void Workspace<Dtype>::Reserve(int count) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  count_ = std::max(count_, count);
+}
+
+template <typename Dtype>
+Blob<Dtype>* Workspace<Dtype>::buffer() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  shared_ptr<Blob<Dtype> >& buffer =
+      sync_->buffers_[boost::this_thread::get_id()];
+  if (!buffer) {
+    buffer.reset(new Blob<Dtype>());
+  }
+  // Only ever grows, so the memory is allocated once per thread.
+  if (buffer->count() < count_) {
+    buffer->Reshape(vector<int>(1, count_));
+  }
+  return buffer.get();
+}
+
+template <typename Dtype>
+int Workspace<Dtype>::num_buffers() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return sync_->buffers_.size();
+}
+
+INSTANTIATE_CLASS(Workspace);
+
+}  // namespace caffe
@@ -47,6 +47,9 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the number of threads for the CPU layers and BLAS. "
+    "Defaults to $CAFFE_NUM_THREADS or the number of cores.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -401,6 +404,9 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_cpu_threads > 0) {
+    caffe::Caffe::set_cpu_threads(FLAGS_cpu_threads);
+  }
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
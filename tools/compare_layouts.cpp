@@ -0,0 +1,84 @@
+// This is a script to report how a network runs with its convolutions and the
+// layers around them in the NHWC layout, compared with NCHW.
+// Usage:
+//    compare_layouts net_proto_file [weights_file] [iterations]
+// The network takes its inputs from Input layers, as the deploy nets of
+// models/*/deploy.prototxt do; both layouts run the same iterations batches
+// (10 by default) of random inputs at TEST phase on the CPU, with the same
+// weights, random ones if the weights file is missing or "".
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc < 2 || argc > 4) {
+    LOG(ERROR) << "Usage: compare_layouts net_proto_file [weights_file] "
+               << "[iterations]";
+    return 1;
+  }
+  const int iterations = argc == 4 ? atoi(argv[3]) : 10;
+  CHECK_GT(iterations, 0) << "Need at least one iteration.";
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &param);
+  param.mutable_state()->set_phase(TEST);
+  const BlobLayout layouts[] = { NCHW, NHWC };
+  const int num_layouts = 2;
+  vector<boost::shared_ptr<Net<float> > > nets;
+  for (int l = 0; l < num_layouts; ++l) {
+    param.set_layout(layouts[l]);
+    nets.push_back(boost::shared_ptr<Net<float> >(new Net<float>(param)));
+  }
+  if (argc >= 3 && argv[2][0] != '\0') {
+    nets[0]->CopyTrainedLayersFrom(string(argv[2]));
+  }
+  nets[1]->ShareTrainedLayersWith(nets[0].get());
+  const int num_outputs = nets[0]->num_outputs();
+  vector<double> max_differences(num_outputs, 0);
+  vector<double> times(num_layouts, 0);
+  Timer timer;
+  for (int iter = 0; iter < iterations; ++iter) {
+    for (int j = 0; j < nets[0]->num_inputs(); ++j) {
+      Blob<float>* input = nets[0]->input_blobs()[j];
+      caffe_rng_gaussian<float>(input->count(), 0, 1,
+                                input->mutable_cpu_data());
+      nets[1]->input_blobs()[j]->CopyFrom(*input);
+    }
+    for (int l = 0; l < num_layouts; ++l) {
+      timer.Start();
+      nets[l]->Forward();
+      times[l] += timer.MilliSeconds();
+    }
+    for (int j = 0; j < num_outputs; ++j) {
+      const float* expected = nets[0]->output_blobs()[j]->cpu_data();
+      const float* data = nets[1]->output_blobs()[j]->cpu_data();
+      for (int k = 0; k < nets[0]->output_blobs()[j]->count(); ++k) {
+        max_differences[j] = std::max<double>(max_differences[j],
+            std::fabs(data[k] - expected[k]));
+      }
+    }
+  }
+  for (int j = 0; j < num_outputs; ++j) {
+    LOG(INFO) << nets[0]->blob_names()[nets[0]->output_blob_indices()[j]]
+        << ": largest difference " << max_differences[j];
+  }
+  for (int l = 0; l < num_layouts; ++l) {
+    LOG(INFO) << BlobLayout_Name(layouts[l]) << " average Forward pass: "
+        << times[l] / iterations << " ms.";
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// This is a script to report how a trained network runs with the weights of
+// its Convolution and InnerProduct layers stored in bfloat16 and float16,
+// compared with full precision.
+// Usage:
+//    compare_precision net_proto_file weights_file [iterations]
+// The network reads its inputs from data layers; every precision runs the
+// same iterations batches (50 by default) at TEST phase on the CPU.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/shared_ptr.hpp"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 3 && argc != 4) {
+    LOG(ERROR) << "Usage: compare_precision net_proto_file weights_file "
+               << "[iterations]";
+    return 1;
+  }
+  const int iterations = argc == 4 ? atoi(argv[3]) : 50;
+  CHECK_GT(iterations, 0) << "Need at least one iteration.";
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &param);
+  param.mutable_state()->set_phase(TEST);
+  const StoragePrecision precisions[] = {
+      FULL_PRECISION, BFLOAT16, FLOAT16 };
+  const int num_precisions = 3;
+  vector<boost::shared_ptr<Net<float> > > nets;
+  for (int p = 0; p < num_precisions; ++p) {
+    param.set_weight_storage(precisions[p]);
+    nets.push_back(boost::shared_ptr<Net<float> >(new Net<float>(param)));
+    nets.back()->CopyTrainedLayersFrom(string(argv[2]));
+  }
+  const int num_outputs = nets[0]->num_outputs();
+  // For each precision and output, the sum of the outputs and the largest
+  // difference from full precision.
+  vector<vector<double> > scores(num_precisions,
+                                 vector<double>(num_outputs, 0));
+  vector<vector<double> > max_differences(num_precisions,
+                                          vector<double>(num_outputs, 0));
+  vector<double> times(num_precisions, 0);
+  Timer timer;
+  for (int iter = 0; iter < iterations; ++iter) {
+    for (int p = 0; p < num_precisions; ++p) {
+      timer.Start();
+      nets[p]->Forward();
+      times[p] += timer.MilliSeconds();
+    }
+    for (int j = 0; j < num_outputs; ++j) {
+      const Blob<float>* expected = nets[0]->output_blobs()[j];
+      for (int p = 0; p < num_precisions; ++p) {
+        const float* data = nets[p]->output_blobs()[j]->cpu_data();
+        for (int k = 0; k < expected->count(); ++k) {
+          scores[p][j] += data[k];
+          max_differences[p][j] = std::max<double>(max_differences[p][j],
+              std::fabs(data[k] - expected->cpu_data()[k]));
+        }
+      }
+    }
+  }
+  for (int p = 0; p < num_precisions; ++p) {
+    const string name = StoragePrecision_Name(precisions[p]);
+    for (int j = 0; j < num_outputs; ++j) {
+      const string& output_name =
+          nets[0]->blob_names()[nets[0]->output_blob_indices()[j]];
+      const int count = nets[0]->output_blobs()[j]->count();
+      LOG(INFO) << name << " " << output_name << " = "
+          << scores[p][j] / iterations / count
+          << " (largest difference " << max_differences[p][j] << ")";
+    }
+    LOG(INFO) << name << " average Forward pass: " << times[p] / iterations
+        << " ms.";
+  }
+  return 0;
+}
@@ -11,6 +11,7 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
@@ -94,14 +95,23 @@ int feature_extraction_pipeline(int argc, char** argv) {
    }
    */
   std::string feature_extraction_proto(argv[++arg_pos]);
-  boost::shared_ptr<Net<Dtype> > feature_extraction_net(
-      new Net<Dtype>(feature_extraction_proto, caffe::TEST));
-  feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
-
   std::string extract_feature_blob_names(argv[++arg_pos]);
   std::vector<std::string> blob_names;
   boost::split(blob_names, extract_feature_blob_names, boost::is_any_of(","));
 
+  // Only the extracted features have to outlive Forward.
+  caffe::NetParameter feature_extraction_param;
+  caffe::ReadNetParamsFromTextFileOrDie(feature_extraction_proto,
+                                        &feature_extraction_param);
+  feature_extraction_param.mutable_state()->set_phase(caffe::TEST);
+  feature_extraction_param.set_share_activations(true);
+  for (size_t i = 0; i < blob_names.size(); ++i) {
+    feature_extraction_param.add_keep_blob(blob_names[i]);
+  }
+  boost::shared_ptr<Net<Dtype> > feature_extraction_net(
+      new Net<Dtype>(feature_extraction_param));
+  feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
+
   std::string save_feature_dataset_names(argv[++arg_pos]);
   std::vector<std::string> dataset_names;
   boost::split(dataset_names, save_feature_dataset_names,
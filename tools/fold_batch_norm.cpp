@@ -0,0 +1,42 @@
+// This is a script to fold the BatchNorm, Scale and Bias layers of a trained
+// network into the Convolution and InnerProduct layers before them.
+// Usage:
+//    fold_batch_norm net_proto_file_in weights_file_in
+//        net_proto_file_out weights_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/fold_batch_norm.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: fold_batch_norm net_proto_file_in weights_file_in "
+               << "net_proto_file_out weights_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  net_param.mutable_state()->set_phase(TEST);
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+
+  NetParameter folded_param;
+  const int num_folded = FoldBatchNorm(net_param, net, &folded_param);
+  LOG(INFO) << "Folded " << num_folded << " layers.";
+
+  WriteProtoToBinaryFile(folded_param, argv[4]);
+  for (int i = 0; i < folded_param.layer_size(); ++i) {
+    folded_param.mutable_layer(i)->clear_blobs();
+  }
+  WriteProtoToTextFile(folded_param, argv[3]);
+  LOG(INFO) << "Wrote folded network to " << argv[3] << " and " << argv[4];
+  return 0;
+}
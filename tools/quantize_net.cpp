@@ -0,0 +1,97 @@
+// This is a script to calibrate the int8 inference of the Convolution and
+// InnerProduct layers of a trained network, and to report how the quantized
+// network compares with the float one.
+// Usage:
+//    quantize_net net_proto_file_in weights_file net_proto_file_out
+//        [iterations]
+// The network reads its inputs from data layers; both calibration and the
+// report run iterations batches (50 by default). The weights file serves the
+// quantized network as it is.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/quantize.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 4 && argc != 5) {
+    LOG(ERROR) << "Usage: quantize_net net_proto_file_in weights_file "
+               << "net_proto_file_out [iterations]";
+    return 1;
+  }
+  const int iterations = argc == 5 ? atoi(argv[4]) : 50;
+  CHECK_GT(iterations, 0) << "Need at least one iteration.";
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter float_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &float_param);
+  float_param.mutable_state()->set_phase(TEST);
+  for (int i = 0; i < float_param.layer_size(); ++i) {
+    float_param.mutable_layer(i)->clear_quantization_param();
+  }
+  NetParameter quantized_param;
+  {
+    Net<float> net(float_param);
+    net.CopyTrainedLayersFrom(string(argv[2]));
+    const int num_calibrated = CalibrateQuantization(float_param, &net,
+        iterations, &quantized_param);
+    LOG(INFO) << "Calibrated " << num_calibrated << " layers.";
+  }
+  WriteProtoToTextFile(quantized_param, argv[3]);
+  LOG(INFO) << "Wrote quantized network to " << argv[3];
+
+  // Run both networks over the same batches.
+  Net<float> float_net(float_param);
+  float_net.CopyTrainedLayersFrom(string(argv[2]));
+  Net<float> quantized_net(quantized_param);
+  quantized_net.CopyTrainedLayersFrom(string(argv[2]));
+  const vector<Blob<float>*>& float_outputs = float_net.output_blobs();
+  const vector<Blob<float>*>& quantized_outputs =
+      quantized_net.output_blobs();
+  vector<double> float_scores(float_outputs.size(), 0);
+  vector<double> quantized_scores(float_outputs.size(), 0);
+  vector<double> max_differences(float_outputs.size(), 0);
+  Timer timer;
+  double float_time = 0;
+  double quantized_time = 0;
+  for (int iter = 0; iter < iterations; ++iter) {
+    timer.Start();
+    float_net.Forward();
+    float_time += timer.MilliSeconds();
+    timer.Start();
+    quantized_net.Forward();
+    quantized_time += timer.MilliSeconds();
+    for (int j = 0; j < float_outputs.size(); ++j) {
+      const float* float_data = float_outputs[j]->cpu_data();
+      const float* quantized_data = quantized_outputs[j]->cpu_data();
+      for (int k = 0; k < float_outputs[j]->count(); ++k) {
+        float_scores[j] += float_data[k];
+        quantized_scores[j] += quantized_data[k];
+        max_differences[j] = std::max<double>(max_differences[j],
+            std::fabs(float_data[k] - quantized_data[k]));
+      }
+    }
+  }
+  for (int j = 0; j < float_outputs.size(); ++j) {
+    const string& output_name =
+        float_net.blob_names()[float_net.output_blob_indices()[j]];
+    const int count = float_outputs[j]->count();
+    LOG(INFO) << output_name << ": float " << float_scores[j] / iterations
+        / count << ", int8 " << quantized_scores[j] / iterations / count
+        << " (largest difference " << max_differences[j] << ")";
+  }
+  LOG(INFO) << "Average Forward pass: float " << float_time / iterations
+      << " ms, int8 " << quantized_time / iterations << " ms.";
+  return 0;
+}
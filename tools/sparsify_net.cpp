@@ -0,0 +1,72 @@
+// This is a script to prune the weights of the Convolution and InnerProduct
+// layers of a trained network by magnitude, and to save them compactly.
+// Usage:
+//    sparsify_net net_proto_file weights_file_in threshold weights_file_out
+// Weights of magnitude at most threshold become zeros; 0 keeps the weights as
+// they are. The output stores the blobs that are mostly zeros as their
+// nonzeros only. Run the network with NetParameter.sparse_weights to
+// multiply with the sparse weights.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/sparse.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: sparsify_net net_proto_file weights_file_in "
+               << "threshold weights_file_out";
+    return 1;
+  }
+  const float threshold = atof(argv[3]);
+  CHECK_GE(threshold, 0) << "The threshold is a magnitude.";
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &param);
+  param.mutable_state()->set_phase(TEST);
+  Net<float> net(param);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+  int64_t total = 0, total_zeros = 0;
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const string type = net.layers()[i]->type();
+    if (type != "Convolution" && type != "InnerProduct") {
+      continue;
+    }
+    Blob<float>* weights = net.layers()[i]->blobs()[0].get();
+    float* data = weights->mutable_cpu_data();
+    int zeros = 0;
+    for (int j = 0; j < weights->count(); ++j) {
+      if (std::abs(data[j]) <= threshold) {
+        data[j] = 0;
+        ++zeros;
+      }
+    }
+    LOG(INFO) << net.layer_names()[i] << ": " << 100. * zeros /
+        weights->count() << "% zeros";
+    total += weights->count();
+    total_zeros += zeros;
+  }
+  LOG(INFO) << "Total: " << 100. * total_zeros / std::max<int64_t>(total, 1)
+      << "% zeros";
+  NetParameter weights_param;
+  net.ToProto(&weights_param, false);
+  const int dense_size = weights_param.ByteSize();
+  SparsifyNetBlobs(&weights_param);
+  WriteProtoToBinaryFile(weights_param, argv[4]);
+  LOG(INFO) << "Wrote " << weights_param.ByteSize() << " bytes of weights ("
+      << dense_size << " dense) to " << argv[4];
+  return 0;
+}